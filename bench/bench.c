@@ -0,0 +1,214 @@
+/**
+ * bench.c
+ * Jannis Lämmle
+ * Benchmark harness for the device (cycle counter) and the host (clock_gettime)
+ *
+ * Device ticks are processor cycles: the DWT cycle counter on the Cortex-M33 (RP2350), SysTick on the
+ * Cortex-M0+ (RP2040), which has no DWT cycle counter. SysTick is only 24 bit and is extended by counting
+ * its wraps in its interrupt, the 32 bit DWT counter is extended in bench_ticks(), which therefore has to
+ * be called at least every 2^32 cycles (28 s at 150 MHz). Host ticks are nanoseconds.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#if PICO_RP2040
+#include "hardware/exception.h"
+#include "hardware/structs/systick.h"
+#elif !defined(__riscv)
+#include "hardware/structs/m33.h"
+#endif
+#else
+#include <time.h>
+#endif
+
+#include "bench.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#if !PICO_ON_DEVICE
+#define BENCH_TARGET "host"
+#elif PICO_RP2040
+#define BENCH_TARGET "rp2040"
+#elif defined(__riscv)
+#define BENCH_TARGET "rp2350-riscv"
+#else
+#define BENCH_TARGET "rp2350"
+#endif
+
+#define SYSTICK_RELOAD 0x00FFFFFFu
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+#if PICO_ON_DEVICE
+static uint32_t g_clock_hz;
+#if PICO_RP2040
+static volatile uint32_t g_systick_wraps;
+#elif !defined(__riscv)
+static uint32_t g_cyccnt_last;
+static uint32_t g_cyccnt_high;
+#endif
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Clock
+ * ----------------------------------------------------------------------------------------------------
+ */
+#if PICO_ON_DEVICE && PICO_RP2040
+static void bench_systick_handler(void)
+{
+    g_systick_wraps++;
+}
+#endif
+
+void bench_init(void)
+{
+#if PICO_ON_DEVICE
+    g_clock_hz = clock_get_hz(clk_sys);
+#if PICO_RP2040
+    exception_set_exclusive_handler(SYSTICK_EXCEPTION, bench_systick_handler);
+    systick_hw->rvr = SYSTICK_RELOAD;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_TICKINT_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+#elif !defined(__riscv)
+    m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+    m33_hw->dwt_cyccnt = 0;
+    m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+#endif
+#endif
+
+    printf("bench_start target=%s rev=%s", BENCH_TARGET, BENCH_REV);
+#if PICO_ON_DEVICE
+    printf(" clk_hz=%lu", (unsigned long)g_clock_hz);
+#endif
+    printf("\n");
+}
+
+uint64_t bench_ticks(void)
+{
+#if !PICO_ON_DEVICE
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#elif PICO_RP2040
+    uint32_t wraps, value;
+    // A wrap between the two reads changes g_systick_wraps, read again then
+    do
+    {
+        wraps = g_systick_wraps;
+        value = systick_hw->cvr;
+    } while(wraps != g_systick_wraps);
+    return ((uint64_t)wraps << 24) + (SYSTICK_RELOAD - value);
+#elif !defined(__riscv)
+    uint32_t value = m33_hw->dwt_cyccnt;
+    if(value < g_cyccnt_last) g_cyccnt_high++;
+    g_cyccnt_last = value;
+    return (uint64_t)g_cyccnt_high << 32 | value;
+#else
+    return time_us_64() * (g_clock_hz / 1000000);
+#endif
+}
+
+static uint64_t bench_ticks_to_ns(uint64_t ticks)
+{
+#if PICO_ON_DEVICE
+    return ticks * 1000 / (g_clock_hz / 1000000);
+#else
+    return ticks;
+#endif
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void bench_begin(bench_t * bench, const char * name, uint32_t ops_per_sample, uint32_t bytes_per_op)
+{
+    memset(bench, 0, sizeof(*bench));
+    bench->name = name;
+    bench->ops_per_sample = ops_per_sample ? ops_per_sample : 1;
+    bench->bytes_per_op = bytes_per_op;
+    bench->ticks_min = UINT64_MAX;
+}
+
+void bench_sample(bench_t * bench, uint64_t start)
+{
+    uint64_t ticks = bench_ticks() - start;
+
+    bench->samples++;
+    bench->ticks_total += ticks;
+    if(ticks < bench->ticks_min) bench->ticks_min = ticks;
+    if(ticks > bench->ticks_max) bench->ticks_max = ticks;
+}
+
+void bench_report(const bench_t * bench)
+{
+    uint64_t ops = (uint64_t)bench->samples * bench->ops_per_sample;
+
+    if(ops == 0)
+    {
+        bench_skip(bench->name, "no_samples");
+        return;
+    }
+
+    uint64_t ns_total = bench_ticks_to_ns(bench->ticks_total);
+
+    printf("bench case=%s target=%s rev=%s ops=%llu ns_avg=%llu ns_min=%llu ns_max=%llu", bench->name, BENCH_TARGET,
+           BENCH_REV, (unsigned long long)ops, (unsigned long long)(ns_total / ops),
+           (unsigned long long)(bench_ticks_to_ns(bench->ticks_min) / bench->ops_per_sample),
+           (unsigned long long)(bench_ticks_to_ns(bench->ticks_max) / bench->ops_per_sample));
+#if PICO_ON_DEVICE
+    printf(" cycles_avg=%llu", (unsigned long long)(bench->ticks_total / ops));
+#endif
+    if(ns_total)
+    {
+        printf(" ops_per_s=%llu", (unsigned long long)(ops * 1000000000u / ns_total));
+    }
+    if(bench->bytes_per_op && ns_total)
+    {
+        printf(" bytes_per_s=%llu", (unsigned long long)(ops * bench->bytes_per_op * 1000000000u / ns_total));
+    }
+    printf("\n");
+}
+
+void bench_metric(const char * name, const char * unit, uint64_t value)
+{
+    printf("bench case=%s target=%s rev=%s value=%llu unit=%s\n", name, BENCH_TARGET, BENCH_REV,
+           (unsigned long long)value, unit);
+}
+
+void bench_skip(const char * name, const char * reason)
+{
+    printf("bench case=%s target=%s rev=%s skipped=%s\n", name, BENCH_TARGET, BENCH_REV, reason);
+}
+
+int main(void)
+{
+    stdio_init_all();
+    bench_init();
+
+#if PICO_ON_DEVICE
+    bench_net_cases();
+#endif
+    bench_app_cases();
+#if !PICO_ON_DEVICE
+    bench_can_cases();
+#endif
+
+    printf("bench_end\n");
+#if PICO_ON_DEVICE
+    while(true) tight_loop_contents();
+#endif
+    return 0;
+}
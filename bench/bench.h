@@ -0,0 +1,55 @@
+/**
+ * bench.h
+ * Jannis Lämmle
+ * Benchmark harness for the device (cycle counter) and the host (clock_gettime)
+ *
+ * Every case prints one line of key=value pairs:
+ *   bench case=<name> target=<host|rp2040|rp2350> rev=<git revision> ops=<n> ns_avg=.. ns_min=.. ns_max=..
+ *         cycles_avg=.. ops_per_s=.. bytes_per_s=..
+ * Times are per operation. Cases that measure something else than time print value=.. unit=.. instead.
+ * scripts/bench_compare.py compares the lines of two runs.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Git revision the benchmark was built from, set by CMake
+#ifndef BENCH_REV
+#define BENCH_REV "unknown"
+#endif
+
+typedef struct bench {
+    const char * name;
+    uint32_t ops_per_sample;    // operations timed together per sample, for operations close to the timer overhead
+    uint32_t bytes_per_op;      // 0 if throughput does not apply
+    uint32_t samples;
+    uint64_t ticks_total;
+    uint64_t ticks_min;
+    uint64_t ticks_max;
+} bench_t;
+
+/*********************************************
+* Harness Functions
+*********************************************/
+void bench_init(void);
+uint64_t bench_ticks(void); // cycles on device, ns on host
+void bench_begin(bench_t * bench, const char * name, uint32_t ops_per_sample, uint32_t bytes_per_op);
+void bench_sample(bench_t * bench, uint64_t start); // Add the ticks since start (from bench_ticks()) as one sample
+void bench_report(const bench_t * bench);
+void bench_metric(const char * name, const char * unit, uint64_t value); // a result that is not a time, lower is better
+void bench_skip(const char * name, const char * reason);
+
+/*********************************************
+* Cases
+*********************************************/
+void bench_app_cases(void); // bench_app.c: parsing, display, history, control (device and host)
+#if PICO_ON_DEVICE
+void bench_net_cases(void); // bench_net.c: SPI, sockets, signing, poll latency (device only)
+#else
+void bench_can_cases(void); // bench_can.c: can2040 on the register stand-ins of bench/can_shim (host only)
+#endif
+
+#endif /* BENCH_H_ */
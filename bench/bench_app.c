@@ -0,0 +1,247 @@
+/**
+ * bench_app.c
+ * Jannis Lämmle
+ * Benchmarks of the application code running on device and host: parsing of the api response, display
+ * rendering, history decimation and the control rules
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "bench.h"
+#include "control.h"
+#include "display.h"
+#include "font.h"
+#include "font_data.h"
+#include "history.h"
+#include "powerData.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Response as received from getLastPowerData, header included
+static const char g_response[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Mon, 19 Oct 2026 10:00:00 GMT\r\n"
+    "Content-Type: application/json;charset=UTF-8\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: keep-alive\r\n"
+    "Vary: Origin\r\n"
+    "\r\n"
+    "{\"code\":200,\"msg\":\"Success\",\"expMsg\":null,\"data\":{\"ppv\":3480.0,\"ppvDetail\":{\"ppv1\":1740.0,"
+    "\"ppv2\":1740.0,\"ppv3\":0.0,\"ppv4\":0.0,\"pmeterDc\":0.0},\"soc\":55.27,\"pev\":0.0,\"pevDetail\":"
+    "{\"ev1Power\":0.0,\"ev2Power\":0.0,\"ev3Power\":0.0,\"ev4Power\":0.0},\"prealL1\":660.0,\"prealL2\":660.0,"
+    "\"prealL3\":660.0,\"pbat\":-1380.0,\"pgrid\":-120.0,\"pload\":1980.0,\"pgridDetail\":{\"pmeterL1\":-40.0,"
+    "\"pmeterL2\":-40.0,\"pmeterL3\":-40.0,\"pmeterDc\":0.0}}}";
+
+// Sample the response has to parse into
+static const power_data_t g_response_data = {3480, 1980, -120, -1380, 553, 0};
+
+static history_t g_history;
+static decimator_t g_decimator;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Display backend
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Drops the tiles, so only the rendering is measured
+static void null_init(void) {}
+static void null_frame(void) {}
+
+static uint32_t null_tile_write(const display_rect_t * rect, const uint16_t * pixels)
+{
+    return (uint32_t)rect->w * rect->h * 2;
+}
+
+static const display_backend_t g_null_backend = {
+    .init = null_init,
+    .frame_start = null_frame,
+    .tile_write = null_tile_write,
+    .tile_wait = null_frame,
+    .frame_end = null_frame,
+};
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Cases
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Fields of g_response that do not come out as g_response_data, 5 if it does not parse at all
+static uint32_t bench_json_parse_mismatch(void)
+{
+    power_data_t data = {0};
+
+    if(!power_data_parse((const uint8_t *)g_response, sizeof(g_response) - 1, &data)) return 5;
+    return (data.ppv != g_response_data.ppv) + (data.pload != g_response_data.pload)
+           + (data.pgrid != g_response_data.pgrid) + (data.pbat != g_response_data.pbat)
+           + (data.soc != g_response_data.soc);
+}
+
+// Only timed on a response that parses into the sample, the early failure paths are much shorter
+static void bench_json_parse(void)
+{
+    bench_t bench;
+    power_data_t data;
+
+    if(bench_json_parse_mismatch())
+    {
+        bench_skip("json_parse", "parse_failed");
+        return;
+    }
+
+    bench_begin(&bench, "json_parse", 10, sizeof(g_response) - 1);
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t j = 0; j < 10; j++) power_data_parse((const uint8_t *)g_response, sizeof(g_response) - 1, &data);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+// Has to be 0, also when json_parse is skipped
+static void bench_json_parse_check(void)
+{
+    bench_metric("json_parse_mismatch", "fields", bench_json_parse_mismatch());
+}
+
+static void bench_display(void)
+{
+    bench_t bench;
+    power_data_t data = g_response_data;
+
+    display_init(&g_null_backend);
+    display_set_power_data(&data);
+    if(!display_update())
+    {
+        bench_skip("display_full", "nothing_rendered");
+        return;
+    }
+
+    bench_begin(&bench, "display_full", 1, DISPLAY_WIDTH * DISPLAY_HEIGHT * 2);
+    for(uint32_t i = 0; i < 20; i++)
+    {
+        uint64_t start = bench_ticks();
+        display_invalidate(NULL);
+        display_update();
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+
+    // One value changing, as on most polls
+    bench_begin(&bench, "display_value", 1, 0);
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        data.ppv = 3000 + (i & 1) * 111;
+        uint64_t start = bench_ticks();
+        display_set_power_data(&data);
+        display_update();
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+static void bench_font(void)
+{
+    static uint16_t pixels[DISPLAY_WIDTH * 64];
+    display_tile_t tile = {{0, 0, DISPLAY_WIDTH, 64}, pixels};
+    bench_t bench;
+
+    if(font_draw_string(&tile, &font_value, 0, 0, "-1234567", DISPLAY_WHITE) <= 0)
+    {
+        bench_skip("font_glyph", "no_glyphs");
+        return;
+    }
+
+    bench_begin(&bench, "font_glyph", 8 * 10, 0);
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t j = 0; j < 10; j++) font_draw_string(&tile, &font_value, 0, 0, "-1234567", DISPLAY_WHITE);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+static void bench_history(void)
+{
+    bench_t bench;
+
+    history_init(&g_history);
+    decimator_init(&g_decimator, &g_history, DISPLAY_WIDTH, 32);
+
+    history_push(&g_history, 1000);
+    if(!decimator_update(&g_decimator))
+    {
+        bench_skip("history_sample", "no_column");
+        return;
+    }
+
+    bench_begin(&bench, "history_sample", 100, 0);
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t j = 0; j < 100; j++)
+        {
+            history_push(&g_history, (int16_t)((i * 100 + j) * 37 % 4000));
+            decimator_update(&g_decimator);
+        }
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+
+    // Full rebuild after falling behind by more than the graph shows
+    bench_begin(&bench, "history_rebuild", 1, 0);
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        for(uint32_t j = 0; j < HISTORY_LENGTH; j++) history_push(&g_history, (int16_t)(j * 37 % 4000));
+        uint64_t start = bench_ticks();
+        decimator_update(&g_decimator);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+// Drives CONTROL_PIN_PUMP on device, the relay toggles during this case
+static void bench_control(void)
+{
+    bench_t bench;
+    power_data_t data = {3480, 1980, -120, -1380, 553, 1790000000};
+
+    control_init();
+
+    control_decision_t decision = control_sample(&data);
+    if(decision.rule > CONTROL_RULE_DEFAULT || decision.output > CONTROL_ON)
+    {
+        bench_skip("control_sample", "no_decision");
+        return;
+    }
+
+    bench_begin(&bench, "control_sample", 10, 0);
+    for(uint32_t i = 0; i < 100; i++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t j = 0; j < 10; j++)
+        {
+            data.pgrid = (int32_t)((i * 10 + j) * 97 % 1000) - 500;
+            data.timestamp += 10;
+            control_sample(&data);
+        }
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+void bench_app_cases(void)
+{
+    bench_json_parse();
+    bench_json_parse_check();
+    bench_display();
+    bench_font();
+    bench_history();
+    bench_control();
+}
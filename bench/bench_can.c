@@ -0,0 +1,1057 @@
+/**
+ * bench_can.c
+ * Jannis Lämmle
+ * Host benchmarks of the can2040 driver (port/board/can), built against the register stand-ins of
+ * bench/can_shim. can.c is included, so the cases can also run the transmit scheduling of the irq
+ * handler without a PIO. Build with -DCAN2040_TX_QUEUE_SIZE=4 to compare with the former queue depth.
+ * The receive cases feed bit streams of bench/can_sim.c through the parser (process_rx()), word by word
+ * as the irq handler reads them from the rx FIFO.
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "can.c"
+
+#include "bench.h"
+#include "can_sim.h"
+#include "isotp.h"
+#include "can_cyclic.h"
+#include "can_bus.h"
+#include "canData.h"
+#include "can_signals.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define BENCH_CAN_ROUNDS 2000
+
+/* Queue full model, in bus slots of one frame (~250 us for 8 data bytes at 500 kbit/s) */
+#define BENCH_CAN_SLOTS 100000
+#define BENCH_CAN_BURST_MAX 16      // frames the application queues at once, 1 to this many
+#define BENCH_CAN_GAP_MIN 6         // slots between bursts, 6 to 22: ~60 % bus load
+#define BENCH_CAN_GAP_SPREAD 17
+
+/* Receive at full bus load: back to back frames without data at 1 Mbit/s (47 bits each, unstuffed),
+   drained every millisecond by the application loop */
+#define BENCH_CAN_RX_FRAMES 100000
+#define BENCH_CAN_RX_PER_DRAIN (1000000 / 47 / 1000 + 1)
+
+/* Parser on simulated bit streams */
+#define BENCH_CAN_SIM_FRAMES 200
+#define BENCH_CAN_SIM_ROUNDS 200
+#define BENCH_CAN_SIM_ERROR_EVERY 4 // every 4th frame of the error cases is corrupted
+#define BENCH_CAN_SIM_CHECK_RUNS 50
+#define BENCH_CAN_LOAD_FRAMES 100   // frames with idle gaps of 0 to 2 frame lengths: ~50 % bus load
+#define BENCH_CAN_LOAD_PERIODS 20   // bus load periods, until the rolling average settled
+#define BENCH_CAN_TIME_START 0xfffff000u    // us, the timer crosses 2^32 during the timestamp check
+
+/* ISO-TP: concurrent transfers of the longest message between two nodes at 500 kbit/s */
+#define BENCH_ISOTP_SESSIONS 3
+#define BENCH_ISOTP_ROUNDS 20
+#define BENCH_ISOTP_BIT_NS 2000
+#define BENCH_ISOTP_BLOCK_SIZE 8
+#define BENCH_ISOTP_TIMEOUT_US 10000000
+
+/* Mailboxes: newest frame of each of 16 ids, in a table with 4 slots per id */
+#define BENCH_CAN_MAILBOX_IDS 16
+#define BENCH_CAN_MAILBOX_SLOTS 64
+
+/* Cyclic transmit table: 1 ms heartbeat and three slower entries over 10 s, alarms 0-50 us late and once
+   3.5 ms late, which misses 3 periods of the heartbeat */
+#define BENCH_CAN_CYCLIC_ENTRIES 4
+#define BENCH_CAN_CYCLIC_TIME_US 10000000
+#define BENCH_CAN_CYCLIC_LATENCY_US 50
+#define BENCH_CAN_CYCLIC_STALL_AT_US 500000
+#define BENCH_CAN_CYCLIC_STALL_US 3500
+#define BENCH_CAN_CYCLIC_STALL_MISSED 3
+
+/* Two buses (inverter and battery) at 500 kbit/s and ~50 % bus load each, the parsers of both fed in turn by
+   FIFO fills (8 words), as the irq handlers of the two PIO blocks would run */
+#define BENCH_CAN_BUS_FRAMES 120
+#define BENCH_CAN_BUS_BIT_NS 2000
+#define BENCH_CAN_BUS_FIFO_WORDS 8
+#define BENCH_CAN_BUS_ROUNDS 50
+#define BENCH_CAN_BUS_SPI_LENGTH 6  // wiznet_spi_write_read
+
+/* CRC kernels, on the fields the parser hands to crc_bytes() for a standard frame with 8 data bytes */
+#define BENCH_CAN_CRC_FRAMES 64
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static struct can2040 g_can;
+static uint32_t g_can_random = 1;
+static volatile uint32_t g_can_sink;  // keeps results of timed code from being optimized out
+
+static struct can2040 g_can_rx;
+static can_sim_t g_can_sim;
+static struct can2040_msg g_can_sim_sent[BENCH_CAN_SIM_FRAMES];     // frames that have to arrive
+static uint32_t g_can_sim_sent_count;
+static uint32_t g_can_sim_sof[BENCH_CAN_SIM_FRAMES];               // sampled bits before each sent frame
+static uint64_t g_can_sim_stamps[BENCH_CAN_SIM_FRAMES];            // timestamps of the received frames
+
+/* ISO-TP nodes: 0 sends, 1 receives, each with the transmit queue of a can2040 */
+typedef struct bench_isotp_node {
+    isotp_t tp;
+    isotp_session_t sessions[BENCH_ISOTP_SESSIONS];
+    struct can2040_msg queue[CAN2040_TX_QUEUE_SIZE];
+    uint32_t pull;
+    uint32_t push;
+} bench_isotp_node_t;
+
+static struct can2040_mailbox g_can_mailboxes[BENCH_CAN_MAILBOX_SLOTS];
+static uint32_t g_can_mailbox_ids[BENCH_CAN_MAILBOX_IDS];
+
+static can_cyclic_entry_t g_can_cyclic[BENCH_CAN_CYCLIC_ENTRIES];
+
+static bench_isotp_node_t g_isotp_nodes[2];
+static uint8_t g_isotp_tx_data[ISOTP_MAX_LENGTH];
+static uint8_t g_isotp_rx_data[BENCH_ISOTP_SESSIONS][ISOTP_MAX_LENGTH];
+static uint64_t g_isotp_now_us;
+static uint32_t g_isotp_done;
+static uint32_t g_isotp_errors;
+static uint32_t g_can_sim_received;
+static uint32_t g_can_sim_mismatch;
+static can_bus_t g_can_buses[2];
+static can_sim_t g_can_bus_sims[2];
+static uint32_t g_can_bus_received[2];
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void bench_can_callback(struct can2040 * cd, uint32_t notify, struct can2040_msg * msg)
+{
+}
+
+static uint32_t bench_can_random(void)
+{
+    g_can_random = g_can_random * 1103515245u + 12345u;
+    return g_can_random >> 8;
+}
+
+static void bench_can_msg(struct can2040_msg * msg, bool extended)
+{
+    msg->id = extended ? (bench_can_random() & 0x1fffffff) | CAN2040_ID_EFF : bench_can_random() & 0x7ff;
+    msg->dlc = 8;
+    msg->data32[0] = bench_can_random();
+    msg->data32[1] = bench_can_random();
+}
+
+// Compares every received frame with the next one sent without error
+static void bench_can_sim_callback(struct can2040 * cd, uint32_t notify, struct can2040_msg * msg)
+{
+    if(notify != CAN2040_NOTIFY_RX) return;
+
+    if(g_can_sim_received >= g_can_sim_sent_count)
+    {
+        g_can_sim_mismatch++;
+        return;
+    }
+    g_can_sim_stamps[g_can_sim_received] = msg->timestamp;
+    const struct can2040_msg * sent = &g_can_sim_sent[g_can_sim_received++];
+    if(msg->id != sent->id || msg->dlc != sent->dlc || msg->data32[0] != sent->data32[0] || msg->data32[1] != sent->data32[1])
+    {
+        g_can_sim_mismatch++;
+    }
+}
+
+static void bench_can_setup(void)
+{
+    can2040_setup(&g_can, 0);
+    can2040_callback_config(&g_can, bench_can_callback);
+
+    // Parser only, the stand-in registers of the state machines are never read back
+    can2040_setup(&g_can_rx, 1);
+    can2040_callback_config(&g_can_rx, bench_can_sim_callback);
+    data_state_clear_bits(&g_can_rx);
+    data_state_go_discard(&g_can_rx);
+    g_can_rx.bitrate = 1000000;
+    g_can_rx.bit_ns = 1000;
+}
+
+// Encodes frames of random ids and lengths (extended ids as chosen), every error_every-th corrupted
+static void bench_can_sim_build(uint32_t frames, int extended, uint32_t error_every)
+{
+    can_sim_reset(&g_can_sim);
+    g_can_sim_sent_count = 0;
+    g_can_sim_received = 0;
+
+    can_sim_idle(&g_can_sim, 11);
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        struct can2040_msg msg;
+        bool ext = extended < 0 ? bench_can_random() & 1 : extended > 0;
+
+        bench_can_msg(&msg, ext);
+        msg.dlc = extended < 0 ? bench_can_random() % 9 : 8;
+        if(extended < 0 && !(bench_can_random() % 16)) msg.id |= CAN2040_ID_RTR;
+        uint32_t len = msg.id & CAN2040_ID_RTR ? 0 : msg.dlc;
+        for(uint32_t j = len; j < 8; j++) msg.data[j] = 0;
+
+        if(error_every && i % error_every == error_every - 1)
+        {
+            can_sim_error_t error = (i / error_every) & 1 ? CAN_SIM_ERROR_FRAME : CAN_SIM_ERROR_FLIP;
+            can_sim_frame(&g_can_sim, &msg, error, bench_can_random() % 160);
+        }
+        else
+        {
+            can_sim_frame(&g_can_sim, &msg, CAN_SIM_ERROR_NONE, 0);
+            g_can_sim_sof[g_can_sim_sent_count] = g_can_sim.sof;
+            g_can_sim_sent[g_can_sim_sent_count++] = msg;
+        }
+    }
+    can_sim_flush(&g_can_sim);
+}
+
+static void bench_can_sim_feed(struct can2040 * cd)
+{
+    g_can_sim_received = 0;
+    for(uint32_t i = 0; i < g_can_sim.count; i++) process_rx(cd, g_can_sim.words[i]);
+}
+
+// What the irq handler does for a frame that went out: schedule the queue head, then confirm it
+static bool bench_can_complete(struct can2040 * cd)
+{
+    if(cd->tx_push_pos == cd->tx_pull_pos) return false;
+
+    tx_schedule_transmit(cd);
+    cd->tx_state = TS_CONFIRM_TX;
+    report_callback_tx_msg(cd);
+    return true;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Cases
+ * ----------------------------------------------------------------------------------------------------
+ */
+// can2040_transmit() into an empty queue until it is full, crc and bit stuffing included
+static void bench_can_enqueue(const char * name, bool extended)
+{
+    struct can2040_msg msgs[CAN2040_TX_QUEUE_SIZE];
+    bench_t bench;
+
+    bench_begin(&bench, name, CAN2040_TX_QUEUE_SIZE, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        for(uint32_t i = 0; i < CAN2040_TX_QUEUE_SIZE; i++) bench_can_msg(&msgs[i], extended);
+
+        uint64_t start = bench_ticks();
+        for(uint32_t i = 0; i < CAN2040_TX_QUEUE_SIZE; i++) can2040_transmit(&g_can, &msgs[i]);
+        bench_sample(&bench, start);
+
+        while(bench_can_complete(&g_can));
+    }
+    bench_report(&bench);
+}
+
+static void bench_can_enqueue_batch(void)
+{
+    struct can2040_msg msgs[CAN2040_TX_QUEUE_SIZE];
+    bench_t bench;
+
+    bench_begin(&bench, "can_tx_batch_std", CAN2040_TX_QUEUE_SIZE, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        for(uint32_t i = 0; i < CAN2040_TX_QUEUE_SIZE; i++) bench_can_msg(&msgs[i], false);
+
+        uint64_t start = bench_ticks();
+        can2040_transmit_batch(&g_can, msgs, CAN2040_TX_QUEUE_SIZE);
+        bench_sample(&bench, start);
+
+        while(bench_can_complete(&g_can));
+    }
+    bench_report(&bench);
+}
+
+// Irq side: picking the next frame out of a full queue
+static void bench_can_schedule(void)
+{
+    struct can2040_msg msg;
+    bench_t bench;
+
+    bench_begin(&bench, "can_tx_schedule_full", 1, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        while(can2040_check_transmit(&g_can))
+        {
+            bench_can_msg(&msg, false);
+            can2040_transmit(&g_can, &msg);
+        }
+
+        uint64_t start = bench_ticks();
+        tx_schedule_transmit(&g_can);
+        bench_sample(&bench, start);
+
+        g_can.tx_state = TS_CONFIRM_TX;
+        report_callback_tx_msg(&g_can);
+    }
+    while(bench_can_complete(&g_can));
+    bench_report(&bench);
+}
+
+// Random bursts of frames against a bus sending one frame per slot, a refused frame is dropped
+static void bench_can_queue_full(void)
+{
+    struct can2040_msg msg;
+    uint32_t attempts = 0;
+    uint32_t refused = 0;
+    uint32_t next_burst = 0;
+
+    for(uint32_t slot = 0; slot < BENCH_CAN_SLOTS; slot++)
+    {
+        if(slot == next_burst)
+        {
+            uint32_t burst = 1 + bench_can_random() % BENCH_CAN_BURST_MAX;
+
+            next_burst += BENCH_CAN_GAP_MIN + bench_can_random() % BENCH_CAN_GAP_SPREAD;
+            for(uint32_t i = 0; i < burst; i++)
+            {
+                bench_can_msg(&msg, false);
+                attempts++;
+                if(can2040_transmit(&g_can, &msg) < 0) refused++;
+            }
+        }
+        bench_can_complete(&g_can);
+    }
+    while(bench_can_complete(&g_can));
+
+    bench_metric("can_tx_queue_full", "per_mille", (uint64_t)refused * 1000 / attempts);
+}
+
+// What the irq handler does for a received frame after its EOF
+static void bench_can_receive(struct can2040 * cd, uint32_t seq)
+{
+    cd->parse_msg.id = seq & 0x7ff;
+    cd->parse_msg.dlc = 4;
+    cd->parse_msg.data32[0] = seq;
+    cd->parse_msg.data32[1] = 0;
+    report_callback_rx_msg(cd);
+}
+
+static void bench_can_rx_drain(void)
+{
+    struct can2040_msg msgs[CAN2040_RX_QUEUE_SIZE];
+    bench_t bench;
+
+    can2040_rx_queue_enable(&g_can, 1);
+    bench_begin(&bench, "can_rx_drain", CAN2040_RX_QUEUE_SIZE, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        for(uint32_t i = 0; i < CAN2040_RX_QUEUE_SIZE; i++) bench_can_receive(&g_can, i);
+
+        uint64_t start = bench_ticks();
+        can2040_rx_drain(&g_can, msgs, CAN2040_RX_QUEUE_SIZE);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+    can2040_rx_queue_enable(&g_can, 0);
+}
+
+// Frames missing or out of order after the drain, has to be 0
+static void bench_can_rx_full_load(void)
+{
+    struct can2040_msg msgs[CAN2040_RX_QUEUE_SIZE];
+    uint32_t expected = 0;
+    uint32_t lost = 0;
+    int count;
+
+    can2040_rx_queue_enable(&g_can, 1);
+    for(uint32_t seq = 0; seq < BENCH_CAN_RX_FRAMES; seq++)
+    {
+        bench_can_receive(&g_can, seq);
+        if(seq % BENCH_CAN_RX_PER_DRAIN != BENCH_CAN_RX_PER_DRAIN - 1 && seq != BENCH_CAN_RX_FRAMES - 1) continue;
+
+        while((count = can2040_rx_drain(&g_can, msgs, count_of(msgs))) > 0)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                if(msgs[i].data32[0] != expected) lost++;
+                expected = msgs[i].data32[0] + 1;
+            }
+        }
+    }
+    can2040_rx_queue_enable(&g_can, 0);
+    if(expected != BENCH_CAN_RX_FRAMES) lost++;
+
+    bench_metric("can_rx_full_load_lost", "frames", lost);
+}
+
+// Acceptance check of one header against a full filter: id bitmap, then all mask/value pairs
+static void bench_can_rx_filter(void)
+{
+    uint32_t ids[64];
+    uint32_t accepted = 0;
+    bench_t bench;
+
+    for(uint32_t i = 0; i < 16; i++) can2040_filter_add_std(&g_can, 0x100 + i);
+    for(uint32_t i = 0; i < CAN2040_FILTER_MAX; i++) can2040_filter_add_mask(&g_can, CAN2040_ID_EFF | 0x1ffffff0, CAN2040_ID_EFF | (0x18ff5000 + i * 16));
+
+    bench_begin(&bench, "can_rx_filter", count_of(ids), 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        for(uint32_t i = 0; i < count_of(ids); i++)
+        {
+            struct can2040_msg msg;
+            bench_can_msg(&msg, i & 1);
+            ids[i] = msg.id;
+        }
+
+        uint64_t start = bench_ticks();
+        for(uint32_t i = 0; i < count_of(ids); i++) accepted += rx_filter_accept(&g_can, ids[i]);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+    can2040_filter_clear(&g_can);
+    g_can_sink = accepted;
+}
+
+// Parser time per frame and per rx FIFO word (of CAN_SIM_WORD_BITS bits)
+static void bench_can_rx_parse(const char * name, const char * name_word, int extended, uint32_t error_every)
+{
+    bench_t bench_frame;
+    bench_t bench_word;
+
+    bench_can_sim_build(BENCH_CAN_SIM_FRAMES, extended, error_every);
+    bench_begin(&bench_frame, name, g_can_sim.frames, 0);
+    bench_begin(&bench_word, name_word, g_can_sim.count, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_SIM_ROUNDS; round++)
+    {
+        uint64_t start = bench_ticks();
+        bench_can_sim_feed(&g_can_rx);
+        bench_sample(round & 1 ? &bench_word : &bench_frame, start);
+    }
+    bench_report(&bench_frame);
+    bench_report(&bench_word);
+}
+
+// Frames received wrong, twice or not at all from mixed streams with errors injected, has to be 0.
+// Parse errors not counted in one of the error classes, has to be 0 as well.
+static void bench_can_rx_sim_check(void)
+{
+    struct can2040_stats stats;
+
+    g_can_sim_mismatch = 0;
+    memset(&g_can_rx.stats, 0, sizeof(g_can_rx.stats));
+    for(uint32_t run = 0; run < BENCH_CAN_SIM_CHECK_RUNS; run++)
+    {
+        bench_can_sim_build(BENCH_CAN_SIM_FRAMES, -1, BENCH_CAN_SIM_ERROR_EVERY);
+        bench_can_sim_feed(&g_can_rx);
+        g_can_sim_mismatch += g_can_sim_sent_count - g_can_sim_received;
+    }
+    can2040_get_statistics(&g_can_rx, &stats);
+
+    bench_metric("can_rx_sim_mismatch", "frames", g_can_sim_mismatch);
+    bench_metric("can_rx_error_unclassified", "errors", stats.parse_error - stats.stuff_error - stats.crc_error
+                 - stats.form_error - stats.ack_error - stats.line_error - stats.rx_stall);
+}
+
+// Difference of can2040_bus_load() to the share of line bits taken by frames
+static void bench_can_bus_load(void)
+{
+    uint32_t busy = 0;
+    uint32_t load = 0;
+
+    can_sim_reset(&g_can_sim);
+    can_sim_idle(&g_can_sim, 11);
+    uint32_t idle = g_can_sim.bits;
+    for(uint32_t i = 0; i < BENCH_CAN_LOAD_FRAMES; i++)
+    {
+        struct can2040_msg msg;
+        bench_can_msg(&msg, false);
+
+        uint32_t bits = g_can_sim.bits;
+        can_sim_frame(&g_can_sim, &msg, CAN_SIM_ERROR_NONE, 0);
+        busy += g_can_sim.bits - bits;
+        can_sim_idle(&g_can_sim, bench_can_random() % (2 * (g_can_sim.bits - bits)));
+    }
+    can_sim_flush(&g_can_sim);
+
+    // One period per pass over the stream, a bit takes 1 us at 1 Mbit/s
+    can2040_bus_load(&g_can_rx, 1000);
+    for(uint32_t i = 0; i < BENCH_CAN_LOAD_PERIODS; i++)
+    {
+        bench_can_sim_feed(&g_can_rx);
+        load = can2040_bus_load(&g_can_rx, g_can_sim.bits - idle);
+    }
+    uint32_t expected = busy * 1000 / (g_can_sim.bits - idle);
+
+    bench_metric("can_bus_load_error", "per_mille", load > expected ? load - expected : expected - load);
+}
+
+typedef uint32_t (* bench_can_crc_t)(uint32_t crc, uint32_t data, uint32_t num);
+
+static uint32_t bench_can_crc_frame(bench_can_crc_t kernel, const uint32_t * fields)
+{
+    uint32_t crc = kernel(0, fields[0], 3);
+    crc = kernel(crc, fields[1], 4);
+    return kernel(crc, fields[2], 4) & 0x7fff;
+}
+
+static void bench_can_crc(const char * name, bench_can_crc_t kernel)
+{
+    uint32_t fields[BENCH_CAN_CRC_FRAMES][3];
+    uint32_t crc = 0;
+    bench_t bench;
+
+    bench_begin(&bench, name, BENCH_CAN_CRC_FRAMES, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        for(uint32_t i = 0; i < BENCH_CAN_CRC_FRAMES; i++)
+        {
+            fields[i][0] = ((bench_can_random() & 0x7ff) << 7) | 8;
+            fields[i][1] = bench_can_random() ^ (bench_can_random() << 24);
+            fields[i][2] = bench_can_random() ^ (bench_can_random() << 24);
+        }
+
+        uint64_t start = bench_ticks();
+        for(uint32_t i = 0; i < BENCH_CAN_CRC_FRAMES; i++) crc ^= bench_can_crc_frame(kernel, fields[i]);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+    g_can_sink = crc;
+}
+
+// Values where the kernels disagree with the byte table, has to be 0
+static void bench_can_crc_check(void)
+{
+    uint32_t mismatch = 0;
+
+    for(uint32_t i = 0; i < 100000; i++)
+    {
+        uint32_t crc = bench_can_random() ^ (bench_can_random() << 24);
+        uint32_t data = bench_can_random() ^ (bench_can_random() << 24);
+        uint32_t num = 1 + i % 4;
+        uint32_t expected = crc_bytes_table(crc, data, num) & 0x7fff;
+
+        if((crc_bytes_nibble(crc, data, num) & 0x7fff) != expected) mismatch++;
+        if((crc_bytes_slice4(crc, data, num) & 0x7fff) != expected) mismatch++;
+    }
+    bench_metric("can_crc_mismatch", "values", mismatch);
+}
+
+// Back to back frames with the timer at the end of each rx word: timestamps that do not increase (has to
+// be 0) and the largest difference to the start of frame on the line
+static void bench_can_rx_timestamps(void)
+{
+    uint32_t nonmonotonic = 0;
+    uint32_t error_max = 0;
+
+    bench_can_sim_build(BENCH_CAN_SIM_FRAMES, -1, 0);
+    g_can_sim_received = 0;
+    for(uint32_t i = 0; i < g_can_sim.count; i++)
+    {
+        uint64_t now = BENCH_CAN_TIME_START + (uint64_t)(i + 1) * CAN_SIM_WORD_BITS;
+        can_shim_timer.timerawh = (uint32_t)(now >> 32);
+        can_shim_timer.timerawl = (uint32_t)now;
+        process_rx(&g_can_rx, g_can_sim.words[i]);
+    }
+
+    for(uint32_t i = 0; i < g_can_sim_received; i++)
+    {
+        uint64_t sof = BENCH_CAN_TIME_START + g_can_sim_sof[i];
+        uint64_t error = g_can_sim_stamps[i] > sof ? g_can_sim_stamps[i] - sof : sof - g_can_sim_stamps[i];
+
+        if(i && g_can_sim_stamps[i] <= g_can_sim_stamps[i - 1]) nonmonotonic++;
+        if(error > error_max) error_max = (uint32_t)error;
+    }
+    nonmonotonic += g_can_sim_sent_count - g_can_sim_received;
+
+    bench_metric("can_rx_timestamp_nonmonotonic", "frames", nonmonotonic);
+    bench_metric("can_rx_timestamp_error_max", "us", error_max);
+}
+
+static int bench_isotp_send(void * ctx, struct can2040_msg * msg)
+{
+    bench_isotp_node_t * node = ctx;
+
+    if(node->push - node->pull >= CAN2040_TX_QUEUE_SIZE) return -1;
+    node->queue[node->push++ % CAN2040_TX_QUEUE_SIZE] = *msg;
+    return 0;
+}
+
+static void bench_isotp_event(isotp_session_t * session, isotp_event_t event, uint32_t len)
+{
+    if(event == ISOTP_EVENT_TX_DONE) return;
+    if(event == ISOTP_EVENT_RX_DONE && len == ISOTP_MAX_LENGTH && !memcmp(session->config.rx_buffer, g_isotp_tx_data, len))
+    {
+        g_isotp_done++;
+        return;
+    }
+    g_isotp_errors++;
+}
+
+// Every frame on the bus is seen by both nodes
+static void bench_isotp_rx_callback(struct can2040 * cd, uint32_t notify, struct can2040_msg * msg)
+{
+    if(notify != CAN2040_NOTIFY_RX) return;
+    isotp_receive(&g_isotp_nodes[0].tp, msg, g_isotp_now_us);
+    isotp_receive(&g_isotp_nodes[1].tp, msg, g_isotp_now_us);
+}
+
+static void bench_isotp_setup(void)
+{
+    for(uint32_t i = 0; i < ISOTP_MAX_LENGTH; i++) g_isotp_tx_data[i] = (uint8_t)(i * 7 + (i >> 8));
+
+    for(uint32_t n = 0; n < 2; n++)
+    {
+        bench_isotp_node_t * node = &g_isotp_nodes[n];
+        isotp_init(&node->tp, bench_isotp_send, node);
+        node->pull = node->push = 0;
+
+        for(uint32_t i = 0; i < BENCH_ISOTP_SESSIONS; i++)
+        {
+            // Diagnostic ids: 0x7E0 + i requests, 0x7E8 + i responses, the last one with 29 bit ids
+            uint32_t request = i < BENCH_ISOTP_SESSIONS - 1 ? 0x7E0u + i : CAN2040_ID_EFF | 0x18DA10F1u;
+            uint32_t response = i < BENCH_ISOTP_SESSIONS - 1 ? 0x7E8u + i : CAN2040_ID_EFF | 0x18DAF110u;
+            isotp_session_config_t config = {
+                .tx_id = n ? response : request,
+                .rx_id = n ? request : response,
+                .block_size = BENCH_ISOTP_BLOCK_SIZE,
+                .st_min = 0,
+                .padding = true,
+                .rx_buffer = g_isotp_rx_data[i],
+                .rx_size = ISOTP_MAX_LENGTH,
+                .event_cb = bench_isotp_event,
+            };
+            isotp_add_session(&node->tp, &node->sessions[i], &config);
+        }
+    }
+}
+
+// Sends the frame of the node that wins arbitration through the parser, after the idle bits it needs to
+// sync, returns false if none is queued
+static bool bench_isotp_bus(void)
+{
+    bench_isotp_node_t * winner = NULL;
+
+    for(uint32_t n = 0; n < 2; n++)
+    {
+        bench_isotp_node_t * node = &g_isotp_nodes[n];
+        if(node->pull == node->push) continue;
+        if(!winner || tx_arbitration(node->queue[node->pull % CAN2040_TX_QUEUE_SIZE].id)
+                      < tx_arbitration(winner->queue[winner->pull % CAN2040_TX_QUEUE_SIZE].id))
+        {
+            winner = node;
+        }
+    }
+    if(!winner) return false;
+
+    can_sim_reset(&g_can_sim);
+    can_sim_idle(&g_can_sim, 11);
+    can_sim_frame(&g_can_sim, &winner->queue[winner->pull++ % CAN2040_TX_QUEUE_SIZE], CAN_SIM_ERROR_NONE, 0);
+    can_sim_flush(&g_can_sim);
+    g_isotp_now_us += (uint64_t)g_can_sim.bits * BENCH_ISOTP_BIT_NS / 1000;
+    for(uint32_t i = 0; i < g_can_sim.count; i++) process_rx(&g_can_rx, g_can_sim.words[i]);
+    return true;
+}
+
+// All sessions send the longest message at once, returns the bus time it took in us
+static uint64_t bench_isotp_transfer(void)
+{
+    uint64_t start = g_isotp_now_us;
+
+    g_isotp_done = 0;
+    for(uint32_t i = 0; i < BENCH_ISOTP_SESSIONS; i++)
+    {
+        if(isotp_send(&g_isotp_nodes[0].sessions[i], g_isotp_tx_data, ISOTP_MAX_LENGTH, g_isotp_now_us) < 0) g_isotp_errors++;
+    }
+    while(g_isotp_done + g_isotp_errors < BENCH_ISOTP_SESSIONS && g_isotp_now_us - start < BENCH_ISOTP_TIMEOUT_US)
+    {
+        isotp_poll(&g_isotp_nodes[0].tp, g_isotp_now_us);
+        isotp_poll(&g_isotp_nodes[1].tp, g_isotp_now_us);
+        if(!bench_isotp_bus()) g_isotp_now_us += 10;
+    }
+    if(g_isotp_done < BENCH_ISOTP_SESSIONS) g_isotp_errors++;
+    return g_isotp_now_us - start;
+}
+
+// Host time per transfer (parser and ISO-TP), payload per second of bus time, transfers that failed (has
+// to be 0)
+static void bench_isotp(void)
+{
+    uint64_t bus_us = 0;
+    bench_t bench;
+
+    bench_isotp_setup();
+    can2040_callback_config(&g_can_rx, bench_isotp_rx_callback);
+    g_isotp_errors = 0;
+
+    bench_begin(&bench, "can_isotp_transfer", BENCH_ISOTP_SESSIONS, ISOTP_MAX_LENGTH);
+    for(uint32_t round = 0; round < BENCH_ISOTP_ROUNDS; round++)
+    {
+        uint64_t start = bench_ticks();
+        bus_us += bench_isotp_transfer();
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+    can2040_callback_config(&g_can_rx, bench_can_sim_callback);
+
+    bench_metric("can_isotp_bus_throughput", "bytes_per_s",
+                 (uint64_t)BENCH_ISOTP_ROUNDS * BENCH_ISOTP_SESSIONS * ISOTP_MAX_LENGTH * 1000000 / bus_us);
+    bench_metric("can_isotp_errors", "transfers", g_isotp_errors);
+}
+
+// Update from the rx path and lock-free read of a mailbox, per frame
+static void bench_can_mailbox(void)
+{
+    struct can2040_msg msgs[BENCH_CAN_MAILBOX_IDS];
+    struct can2040_msg msg;
+    uint32_t found = 0;
+    bench_t bench_update, bench_read;
+
+    for(uint32_t i = 0; i < BENCH_CAN_MAILBOX_IDS; i++)
+    {
+        bench_can_msg(&msgs[i], i & 1);
+        g_can_mailbox_ids[i] = msgs[i].id;
+    }
+    if(can2040_mailbox_setup(&g_can, g_can_mailboxes, BENCH_CAN_MAILBOX_SLOTS, g_can_mailbox_ids, BENCH_CAN_MAILBOX_IDS) < 0)
+    {
+        bench_metric("can_mailbox_setup_failed", "tables", 1);
+        return;
+    }
+
+    bench_begin(&bench_update, "can_mailbox_update", BENCH_CAN_MAILBOX_IDS, 0);
+    bench_begin(&bench_read, "can_mailbox_read", BENCH_CAN_MAILBOX_IDS, 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t i = 0; i < BENCH_CAN_MAILBOX_IDS; i++)
+        {
+            g_can.parse_msg = msgs[i];
+            report_mailbox_rx_msg(&g_can);
+        }
+        bench_sample(&bench_update, start);
+
+        start = bench_ticks();
+        for(uint32_t i = 0; i < BENCH_CAN_MAILBOX_IDS; i++) found += can2040_mailbox_read(&g_can, g_can_mailbox_ids[i], &msg);
+        bench_sample(&bench_read, start);
+    }
+    bench_report(&bench_update);
+    bench_report(&bench_read);
+    can2040_mailbox_setup(&g_can, NULL, 0, NULL, 0);
+    g_can_sink = found;
+}
+
+// Mailboxes that do not hold the last frame sent with their id, after a simulated stream through the parser
+// with 16 ids repeating, has to be 0
+static void bench_can_mailbox_check(void)
+{
+    struct can2040_msg msg;
+    uint32_t mismatch = 0;
+
+    can2040_mailbox_setup(&g_can_rx, g_can_mailboxes, BENCH_CAN_MAILBOX_SLOTS, g_can_mailbox_ids, BENCH_CAN_MAILBOX_IDS);
+
+    can_sim_reset(&g_can_sim);
+    g_can_sim_sent_count = 0;
+    can_sim_idle(&g_can_sim, 11);
+    for(uint32_t i = 0; i < BENCH_CAN_SIM_FRAMES; i++)
+    {
+        bench_can_msg(&msg, false);
+        msg.id = g_can_mailbox_ids[bench_can_random() % BENCH_CAN_MAILBOX_IDS];
+        can_sim_frame(&g_can_sim, &msg, CAN_SIM_ERROR_NONE, 0);
+        g_can_sim_sent[g_can_sim_sent_count++] = msg;
+    }
+    can_sim_flush(&g_can_sim);
+    bench_can_sim_feed(&g_can_rx);
+
+    for(uint32_t i = 0; i < BENCH_CAN_MAILBOX_IDS; i++)
+    {
+        const struct can2040_msg * last = NULL;
+        for(uint32_t j = 0; j < g_can_sim_sent_count; j++)
+        {
+            if(g_can_sim_sent[j].id == g_can_mailbox_ids[i]) last = &g_can_sim_sent[j];
+        }
+
+        int ret = can2040_mailbox_read(&g_can_rx, g_can_mailbox_ids[i], &msg);
+        if(ret != (last != NULL)) mismatch++;
+        else if(last && (msg.dlc != last->dlc || msg.data32[0] != last->data32[0] || msg.data32[1] != last->data32[1])) mismatch++;
+    }
+    can2040_mailbox_setup(&g_can_rx, NULL, 0, NULL, 0);
+
+    bench_metric("can_mailbox_mismatch", "ids", mismatch);
+}
+
+// Counter in the first data byte, as an emulated sensor would update its reading
+static bool bench_can_cyclic_update(can_cyclic_entry_t * entry, struct can2040_msg * msg)
+{
+    msg->data[0]++;
+    return true;
+}
+
+// Release time per alarm with a simulated timer, release jitter and missed periods. Released plus missed
+// periods that differ from the due times up to the last alarm, a stall that does not miss exactly
+// BENCH_CAN_CYCLIC_STALL_MISSED heartbeats and frames of can_cyclic_transmit() not forwarded, also with an
+// empty table where no alarm comes, count as errors (has to be 0).
+static void bench_can_cyclic(void)
+{
+    static const uint32_t periods[BENCH_CAN_CYCLIC_ENTRIES] = {1000, 10000, 20000, 100000};
+    static const uint32_t phases[BENCH_CAN_CYCLIC_ENTRIES] = {0, 2000, 5000, 7000};
+    can_cyclic_stats_t stats;
+    uint64_t now = 0, last = 0;
+    uint32_t errors = 0, forwarded = 0;
+    bool stalled = false;
+    bench_t bench;
+
+    can_cyclic_init(&g_can);
+    for(uint32_t i = 0; i < BENCH_CAN_CYCLIC_ENTRIES; i++)
+    {
+        can_cyclic_entry_t * entry = &g_can_cyclic[i];
+        memset(entry, 0, sizeof(*entry));
+        bench_can_msg(&entry->msg, false);
+        entry->period_us = periods[i];
+        entry->phase_us = phases[i];
+        entry->update = i ? NULL : bench_can_cyclic_update;
+        can_cyclic_add(entry);
+    }
+    can_cyclic_start(now);
+
+    bench_begin(&bench, "can_cyclic_run", 1, 0);
+    while(now < BENCH_CAN_CYCLIC_TIME_US)
+    {
+        // A frame from thread context before every 16th alarm, which forwards it
+        if(!(bench_can_random() % 16))
+        {
+            struct can2040_msg msg;
+            bench_can_msg(&msg, false);
+            if(can_cyclic_transmit(&msg) == 0) forwarded++;
+        }
+
+        uint64_t start = bench_ticks();
+        uint64_t next = can_cyclic_run(now);
+        bench_sample(&bench, start);
+        last = now;
+
+        // The bus sends everything before the next alarm
+        while(bench_can_complete(&g_can));
+
+        now = next + bench_can_random() % (BENCH_CAN_CYCLIC_LATENCY_US + 1);
+        if(!stalled && next >= BENCH_CAN_CYCLIC_STALL_AT_US)
+        {
+            now = next + BENCH_CAN_CYCLIC_STALL_US;
+            stalled = true;
+        }
+    }
+    bench_report(&bench);
+    can_cyclic_get_stats(&stats);
+
+    for(uint32_t i = 0; i < BENCH_CAN_CYCLIC_ENTRIES; i++)
+    {
+        const can_cyclic_entry_t * entry = &g_can_cyclic[i];
+        uint32_t due = last >= entry->phase_us ? (last - entry->phase_us) / entry->period_us + 1 : 0;
+        if(entry->released + entry->missed != due) errors++;
+    }
+    if(g_can_cyclic[0].missed != BENCH_CAN_CYCLIC_STALL_MISSED || stats.missed != BENCH_CAN_CYCLIC_STALL_MISSED) errors++;
+    if(stats.queue_full) errors++;
+    if(stats.forwarded != forwarded) errors++;
+
+    // Running without entries, more frames than CAN_CYCLIC_PENDING have to go out without can_cyclic_run()
+    can_cyclic_init(&g_can);
+    can_cyclic_start(now);
+    for(uint32_t i = 0; i < CAN_CYCLIC_PENDING * 2; i++)
+    {
+        struct can2040_msg msg;
+        bench_can_msg(&msg, false);
+        if(can_cyclic_transmit(&msg) < 0) errors++;
+        while(bench_can_complete(&g_can));
+    }
+    can_cyclic_get_stats(&stats);
+    if(stats.forwarded != CAN_CYCLIC_PENDING * 2) errors++;
+    can_cyclic_stop();
+
+    bench_metric("can_cyclic_jitter_max", "us", stats.jitter_us_max);
+    bench_metric("can_cyclic_jitter_avg", "us", stats.released ? stats.jitter_us_total / stats.released : 0);
+    bench_metric("can_cyclic_errors", "entries", errors);
+}
+
+// Decoding of the local data source per frame, frames of the generated tables and one unknown id in turn
+static void bench_can_data_decode(void)
+{
+    struct can2040_msg msgs[16];
+    can_data_t data;
+    bench_t bench;
+
+    can_data_init(&data, &can_signals);
+    for(uint32_t i = 0; i < count_of(msgs); i++)
+    {
+        bench_can_msg(&msgs[i], false);
+        if(i % (can_signals.message_count + 1) < can_signals.message_count)
+        {
+            msgs[i].id = can_signals.messages[i % (can_signals.message_count + 1)].id;
+        }
+    }
+
+    // The first frame carries signals of the tables, so it has to update the sample
+    if(!can_data_decode(&data, &msgs[0]))
+    {
+        bench_skip("can_data_decode", "no_signals");
+        return;
+    }
+
+    bench_begin(&bench, "can_data_decode", count_of(msgs), 0);
+    for(uint32_t round = 0; round < BENCH_CAN_ROUNDS; round++)
+    {
+        uint64_t start = bench_ticks();
+        for(uint32_t i = 0; i < count_of(msgs); i++) can_data_decode(&data, &msgs[i]);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+    g_can_sink = data.data.ppv + data.frames;
+}
+
+typedef struct bench_can_bus_plan {
+    uint32_t pio_count;
+    can_bus_pio_state_t pios[CAN_BUS_PIO_MAX];
+    uint32_t dma_free;
+    uint32_t bus_count;
+    uint32_t spi_length;
+    int expected;
+    uint8_t bus_pio[CAN_BUS_MAX];   // expected plan
+} bench_can_bus_plan_t;
+
+// Plans of can_bus_plan() for the RP2040 and RP2350 with and without the W5x00 SPI program, a plan that
+// differs from the expected one counts as an error (has to be 0)
+static void bench_can_bus_plan(void)
+{
+    static const bench_can_bus_plan_t plans[] = {
+        // RP2040, nothing loaded yet
+        { 2, {{0, 0}, {0, 0}}, 12, 2, 0, CAN_BUS_OK, {0, 1} },
+        // RP2040, the SPI program still to be loaded: only one bus, the SPI driver gets pio1
+        { 2, {{0, 0}, {0, 0}}, 12, 2, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_SPI_NO_PIO, {0} },
+        { 2, {{0, 0}, {0, 0}}, 12, 1, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_OK, {0} },
+        // RP2040, SPI already loaded in pio1 (one state machine, 6 slots at the end)
+        { 2, {{0, 0}, {0x1, 0xfc000000}}, 11, 2, 0, CAN_BUS_NO_PIO, {0} },
+        { 2, {{0, 0}, {0x1, 0xfc000000}}, 11, 1, 0, CAN_BUS_OK, {0} },
+        // RP2350, the SPI program still to be loaded: two buses, pio2 is never tried by the SPI driver
+        { 3, {{0, 0}, {0, 0}, {0, 0}}, 16, 2, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_OK, {0, 2} },
+        { 3, {{0, 0}, {0, 0}, {0, 0}}, 16, 3, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_SPI_NO_PIO, {0} },
+        // RP2350, another program in pio1 leaves room for SPI there
+        { 3, {{0, 0}, {0x3, 0x0000ffff}, {0, 0}}, 16, 2, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_OK, {0, 2} },
+        // A single block (pio1 is out of range): the SPI program goes there, no room for a bus
+        { 1, {{0, 0}}, 12, 1, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_SPI_NO_PIO, {0} },
+        { 1, {{0, 0}}, 12, 1, 0, CAN_BUS_OK, {0} },
+        // No DMA channel left for the SPI program
+        { 3, {{0, 0}, {0, 0}, {0, 0}}, 0, 1, BENCH_CAN_BUS_SPI_LENGTH, CAN_BUS_SPI_NO_DMA, {0} },
+    };
+    uint32_t errors = 0;
+
+    for(uint32_t i = 0; i < count_of(plans); i++)
+    {
+        const bench_can_bus_plan_t * plan = &plans[i];
+        uint8_t bus_pio[CAN_BUS_MAX] = {0};
+
+        int ret = can_bus_plan(plan->pios, plan->pio_count, plan->dma_free, plan->bus_count, plan->spi_length, bus_pio);
+        if(ret != plan->expected) errors++;
+        else if(ret == CAN_BUS_OK && memcmp(bus_pio, plan->bus_pio, plan->bus_count)) errors++;
+    }
+    bench_metric("can_bus_plan_errors", "plans", errors);
+}
+
+static void bench_can_bus_callback(struct can2040 * cd, uint32_t notify, struct can2040_msg * msg)
+{
+    if(notify == CAN2040_NOTIFY_RX) g_can_bus_received[cd == &g_can_buses[1].cd]++;
+}
+
+// Per bus irq load with both buses receiving: host ns spent in the parser of a bus over the line time of the
+// streams, in ppm (the device reports per mille of its cycles, see can_bus_irq_load()). Frames not received
+// count as lost.
+static void bench_can_bus_irq_load(void)
+{
+    uint32_t lost = 0;
+    uint32_t line_bits = 0;
+
+    for(uint32_t b = 0; b < 2; b++)
+    {
+        can_bus_t * bus = &g_can_buses[b];
+        can_sim_t * sim = &g_can_bus_sims[b];
+
+        // Parser only, on the stand-ins of pio1 and pio2
+        memset(bus, 0, sizeof(*bus));
+        bus->pio = b + 1;
+        can2040_setup(&bus->cd, bus->pio);
+        can2040_callback_config(&bus->cd, bench_can_bus_callback);
+        data_state_clear_bits(&bus->cd);
+        data_state_go_discard(&bus->cd);
+        bus->cd.bitrate = 1000000000 / BENCH_CAN_BUS_BIT_NS;
+        bus->cd.bit_ns = BENCH_CAN_BUS_BIT_NS;
+
+        can_sim_reset(sim);
+        can_sim_idle(sim, 11);
+        for(uint32_t i = 0; i < BENCH_CAN_BUS_FRAMES; i++)
+        {
+            struct can2040_msg msg;
+            bench_can_msg(&msg, b);
+
+            uint32_t bits = sim->bits;
+            can_sim_frame(sim, &msg, CAN_SIM_ERROR_NONE, 0);
+            can_sim_idle(sim, bench_can_random() % (2 * (sim->bits - bits)));
+        }
+        can_sim_flush(sim);
+        if(sim->bits > line_bits) line_bits = sim->bits;
+    }
+
+    for(uint32_t round = 0; round < BENCH_CAN_BUS_ROUNDS; round++)
+    {
+        uint32_t pos[2] = {0, 0};
+
+        g_can_bus_received[0] = g_can_bus_received[1] = 0;
+        while(pos[0] < g_can_bus_sims[0].count || pos[1] < g_can_bus_sims[1].count)
+        {
+            for(uint32_t b = 0; b < 2; b++)
+            {
+                can_bus_t * bus = &g_can_buses[b];
+                can_sim_t * sim = &g_can_bus_sims[b];
+                uint32_t end = pos[b] + BENCH_CAN_BUS_FIFO_WORDS < sim->count ? pos[b] + BENCH_CAN_BUS_FIFO_WORDS : sim->count;
+
+                uint64_t start = bench_ticks();
+                for(; pos[b] < end; pos[b]++) process_rx(&bus->cd, sim->words[pos[b]]);
+                bus->cd.stats.irq_cycles_total += bench_ticks() - start;
+            }
+        }
+        for(uint32_t b = 0; b < 2; b++) lost += BENCH_CAN_BUS_FRAMES - g_can_bus_received[b];
+    }
+
+    uint64_t line_ns = (uint64_t)line_bits * BENCH_CAN_BUS_BIT_NS * BENCH_CAN_BUS_ROUNDS;
+    bench_metric("can_bus_irq_load_inverter", "ppm", g_can_buses[0].cd.stats.irq_cycles_total * 1000000 / line_ns);
+    bench_metric("can_bus_irq_load_bms", "ppm", g_can_buses[1].cd.stats.irq_cycles_total * 1000000 / line_ns);
+    bench_metric("can_bus_rx_lost", "frames", lost);
+}
+
+void bench_can_cases(void)
+{
+    bench_can_setup();
+
+    bench_can_enqueue("can_tx_enqueue_std", false);
+    bench_can_enqueue("can_tx_enqueue_ext", true);
+    bench_can_enqueue_batch();
+    bench_can_schedule();
+    bench_can_queue_full();
+    bench_can_rx_drain();
+    bench_can_rx_full_load();
+    bench_can_rx_filter();
+    bench_can_mailbox();
+    bench_can_mailbox_check();
+    bench_can_rx_parse("can_rx_parse_std", "can_rx_parse_std_word", 0, 0);
+    bench_can_rx_parse("can_rx_parse_ext", "can_rx_parse_ext_word", 1, 0);
+    bench_can_rx_parse("can_rx_parse_errors", "can_rx_parse_errors_word", -1, BENCH_CAN_SIM_ERROR_EVERY);
+    bench_can_rx_sim_check();
+    bench_can_bus_load();
+    bench_can_rx_timestamps();
+    bench_isotp();
+    bench_can_cyclic();
+    bench_can_data_decode();
+    bench_can_bus_plan();
+    bench_can_bus_irq_load();
+    bench_can_crc("can_crc_table", crc_bytes_table);
+    bench_can_crc("can_crc_nibble", crc_bytes_nibble);
+    bench_can_crc("can_crc_slice4", crc_bytes_slice4);
+    bench_can_crc_check();
+}
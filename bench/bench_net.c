@@ -0,0 +1,282 @@
+/**
+ * bench_net.c
+ * Jannis Lämmle
+ * Device benchmarks of the network path: SPI transfers to the W5x00, socket sends, request signing and
+ * the latency of a complete poll of the cloud api. The interrupt latency is measured with the chip idle and
+ * with back to back 2 KB bursts, configure with -DWIZCHIP_LOCK_MASKS_IRQ=ON to compare with interrupts disabled
+ * during frames
+ *
+ * The SPI transport is the one the build uses (w5x00_spi.h), build with USE_SPI_DMA or for the W55RP20
+ * (PIO) to compare them. A round trip through a UDP echo server is measured if BENCH_ECHO_IP is set,
+ * e.g. -DBENCH_ECHO_IP=192,168,11,10
+ */
+
+#include <stdio.h>
+
+#include "hardware/clocks.h"
+
+#include "alphaESS.h"
+#include "irq_latency.h"
+#include "bench.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#if defined(USE_SPI_PIO)
+#define BENCH_SPI_TRANSPORT "pio"
+#elif defined(USE_SPI_DMA)
+#define BENCH_SPI_TRANSPORT "dma"
+#else
+#define BENCH_SPI_TRANSPORT "blocking"
+#endif
+
+// Socket not used by the application
+#define SOCKET_BENCH 4
+#define BENCH_UDP_PORT 5000
+#define BENCH_DISCARD_PORT 9
+#define BENCH_ECHO_PORT 7
+#define BENCH_ECHO_TIMEOUT_US 100000
+
+#define BENCH_POLLS 5
+
+#define BENCH_IRQ_PERIOD_US 250
+#define BENCH_IRQ_DURATION_US 500000
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static uint8_t g_buf[2048];
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Cases
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void bench_spi(void)
+{
+    // Register access, the largest read copied by the cpu (PIO) and a full buffer
+    static const uint16_t sizes[] = {1, 16, 2048};
+    // TX buffer of the bench socket, reading and writing it has no side effects
+    uint32_t addr = WIZCHIP_TXBUF_BLOCK(SOCKET_BENCH) << 3;
+    char name[40];
+    bench_t bench;
+
+    // A pattern written has to read back, otherwise the chip is not there
+    for(uint32_t j = 0; j < 16; j++) g_buf[j] = (uint8_t)(j * 37 + 1);
+    WIZCHIP_WRITE_BUF(addr, g_buf, 16);
+    memset(g_buf, 0, 16);
+    WIZCHIP_READ_BUF(addr, g_buf, 16);
+    for(uint32_t j = 0; j < 16; j++)
+    {
+        if(g_buf[j] != (uint8_t)(j * 37 + 1))
+        {
+            bench_skip("spi_" BENCH_SPI_TRANSPORT, "readback_failed");
+            return;
+        }
+    }
+
+    for(uint8_t i = 0; i < count_of(sizes); i++)
+    {
+        snprintf(name, sizeof(name), "spi_%s_read_%u", BENCH_SPI_TRANSPORT, sizes[i]);
+        bench_begin(&bench, name, 1, sizes[i]);
+        for(uint32_t j = 0; j < 200; j++)
+        {
+            uint64_t start = bench_ticks();
+            WIZCHIP_READ_BUF(addr, g_buf, sizes[i]);
+            bench_sample(&bench, start);
+        }
+        bench_report(&bench);
+
+        snprintf(name, sizeof(name), "spi_%s_write_%u", BENCH_SPI_TRANSPORT, sizes[i]);
+        bench_begin(&bench, name, 1, sizes[i]);
+        for(uint32_t j = 0; j < 200; j++)
+        {
+            uint64_t start = bench_ticks();
+            WIZCHIP_WRITE_BUF(addr, g_buf, sizes[i]);
+            bench_sample(&bench, start);
+        }
+        bench_report(&bench);
+    }
+}
+
+#ifdef USE_SPI_PIO
+static void bench_spi_async_done(wiznet_spi_handle_t handle, int result, void * user_data)
+{
+    *(volatile int *)user_data = result;
+}
+
+// A 2 KB write ended by the DMA interrupt, the header is sent with the data
+static void bench_spi_async(void)
+{
+    uint16_t addr = WIZCHIP_TXBUF_BLOCK(SOCKET_BENCH) << 3;
+    bench_t bench;
+
+    g_buf[0] = 0;
+    g_buf[1] = 0;
+    g_buf[2] = (uint8_t)(addr | _W5500_SPI_WRITE_);
+
+    bench_begin(&bench, "spi_pio_async_write_2048", 1, sizeof(g_buf) - 3);
+    for(uint32_t j = 0; j < 200; j++)
+    {
+        volatile int result = WIZNET_SPI_PIO_BUSY;
+        uint64_t start = bench_ticks();
+
+        (*spi_handle)->frame_start();
+        if(wiznet_spi_pio_transfer_async(spi_handle, g_buf, sizeof(g_buf), NULL, 0, bench_spi_async_done, (void *)&result) == PICO_OK)
+        {
+            while(result == WIZNET_SPI_PIO_BUSY) tight_loop_contents();
+        }
+        (*spi_handle)->frame_end();
+        if(result == PICO_OK) bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+#endif
+
+// The probe only keeps min, max and total, they are handed to the harness in cycles
+static void bench_irq_report(const char * name)
+{
+    irq_latency_stats_t stats;
+    uint64_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    bench_t bench;
+
+    irq_latency_get_stats(&stats);
+    bench_begin(&bench, name, 1, 0);
+    bench.samples = stats.samples;
+    bench.ticks_total = stats.us_total * cycles_per_us;
+    bench.ticks_min = (uint64_t)stats.us_min * cycles_per_us;
+    bench.ticks_max = (uint64_t)stats.us_max * cycles_per_us;
+    bench_report(&bench);
+}
+
+static void bench_irq_latency(void)
+{
+    uint32_t addr = WIZCHIP_TXBUF_BLOCK(SOCKET_BENCH) << 3;
+    absolute_time_t end;
+
+    irq_latency_start(BENCH_IRQ_PERIOD_US);
+    sleep_us(BENCH_IRQ_DURATION_US);
+    bench_irq_report("irq_latency_idle");
+
+    irq_latency_reset_stats();
+    end = make_timeout_time_us(BENCH_IRQ_DURATION_US);
+    while(!time_reached(end))
+    {
+        WIZCHIP_READ_BUF(addr, g_buf, sizeof(g_buf));
+        WIZCHIP_WRITE_BUF(addr, g_buf, sizeof(g_buf));
+    }
+    bench_irq_report("irq_latency_spi_2048");
+    irq_latency_stop();
+}
+
+static void bench_socket(void)
+{
+    static const uint16_t sizes[] = {64, 1472};
+    char name[40];
+    bench_t bench;
+    wiz_NetInfo net_info;
+
+    // The gateway as assigned by DHCP, g_net_info of alphaESS.h is a copy per translation unit
+    wizchip_getnetinfo(&net_info);
+
+    if(socket(SOCKET_BENCH, Sn_MR_UDP, BENCH_UDP_PORT, 0) != SOCKET_BENCH)
+    {
+        bench_skip("socket_udp_send", "socket_failed");
+        return;
+    }
+
+    // sendto() returns once the chip reports SEND_OK, the first one includes the ARP request
+    sendto(SOCKET_BENCH, g_buf, 1, net_info.gw, BENCH_DISCARD_PORT);
+
+    for(uint8_t i = 0; i < count_of(sizes); i++)
+    {
+        snprintf(name, sizeof(name), "socket_udp_send_%u", sizes[i]);
+        bench_begin(&bench, name, 1, sizes[i]);
+        for(uint32_t j = 0; j < 100; j++)
+        {
+            uint64_t start = bench_ticks();
+            if(sendto(SOCKET_BENCH, g_buf, sizes[i], net_info.gw, BENCH_DISCARD_PORT) == sizes[i]) bench_sample(&bench, start);
+        }
+        bench_report(&bench);
+    }
+
+#ifdef BENCH_ECHO_IP
+    uint8_t echo_ip[4] = {BENCH_ECHO_IP};
+    uint8_t from_ip[4];
+    uint16_t from_port;
+
+    bench_begin(&bench, "socket_udp_echo_64", 1, 64);
+    for(uint32_t j = 0; j < 100; j++)
+    {
+        uint64_t start = bench_ticks();
+        absolute_time_t timeout = make_timeout_time_us(BENCH_ECHO_TIMEOUT_US);
+
+        sendto(SOCKET_BENCH, g_buf, 64, echo_ip, BENCH_ECHO_PORT);
+        while(getSn_RX_RSR(SOCKET_BENCH) == 0 && !time_reached(timeout)) tight_loop_contents();
+        if(getSn_RX_RSR(SOCKET_BENCH) == 0) continue;
+
+        recvfrom(SOCKET_BENCH, g_buf, sizeof(g_buf), from_ip, &from_port);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+#else
+    bench_skip("socket_udp_echo_64", "BENCH_ECHO_IP_not_set");
+#endif
+
+    close(SOCKET_BENCH);
+}
+
+static void bench_sign(void)
+{
+    uint8_t sign[129] = {0};
+    bench_t bench;
+
+    alphaESS_sign((const uint8_t *)"1790000000", sign);
+    if(strlen((const char *)sign) != 128)
+    {
+        bench_skip("sha512_sign", "no_signature");
+        return;
+    }
+
+    bench_begin(&bench, "sha512_sign", 1, 0);
+    for(uint32_t j = 0; j < 100; j++)
+    {
+        uint64_t start = bench_ticks();
+        alphaESS_sign((const uint8_t *)"1790000000", sign);
+        bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+// DHCP check, DNS, SNTP, http request and parsing, only successful polls are counted
+static void bench_poll(void)
+{
+    bench_t bench;
+
+    bench_begin(&bench, "poll", 1, 0);
+    for(uint32_t j = 0; j < BENCH_POLLS; j++)
+    {
+        uint64_t start = bench_ticks();
+        if(alphaESS_run()) bench_sample(&bench, start);
+    }
+    bench_report(&bench);
+}
+
+void bench_net_cases(void)
+{
+    log_init();
+    alphaESS_setup();
+
+    bench_spi();
+#ifdef USE_SPI_PIO
+    bench_spi_async();
+#endif
+    bench_irq_latency();
+    bench_socket();
+    bench_sign();
+    bench_poll();
+}
@@ -0,0 +1,12 @@
+/**
+ * cmsis_gcc.h
+ * Jannis Lämmle
+ * Host stand-in for the CMSIS barrier used by can2040, see bench/can_shim/hardware/structs/pio.h
+ */
+
+#ifndef CAN_SHIM_CMSIS_GCC_H_
+#define CAN_SHIM_CMSIS_GCC_H_
+
+#define __DMB() __sync_synchronize()
+
+#endif /* CAN_SHIM_CMSIS_GCC_H_ */
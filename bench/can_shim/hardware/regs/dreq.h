@@ -0,0 +1,12 @@
+/**
+ * dreq.h
+ * Jannis Lämmle
+ * Host stand-in, see bench/can_shim/hardware/structs/pio.h
+ */
+
+#ifndef CAN_SHIM_DREQ_H_
+#define CAN_SHIM_DREQ_H_
+
+#define DREQ_PIO0_RX1 5
+
+#endif /* CAN_SHIM_DREQ_H_ */
@@ -0,0 +1,10 @@
+/**
+ * dma.h
+ * Jannis Lämmle
+ * Host stand-in, see bench/can_shim/hardware/structs/pio.h
+ */
+
+#ifndef CAN_SHIM_DMA_H_
+#define CAN_SHIM_DMA_H_
+
+#endif /* CAN_SHIM_DMA_H_ */
@@ -0,0 +1,24 @@
+/**
+ * iobank0.h
+ * Jannis Lämmle
+ * Host stand-in, see bench/can_shim/hardware/structs/pio.h
+ */
+
+#ifndef CAN_SHIM_IOBANK0_H_
+#define CAN_SHIM_IOBANK0_H_
+
+#include <stdint.h>
+
+#define IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB 0
+
+typedef struct {
+    struct {
+        volatile uint32_t status;
+        volatile uint32_t ctrl;
+    } io[48];
+} iobank0_hw_t;
+
+static iobank0_hw_t can_shim_iobank0;
+#define iobank0_hw (&can_shim_iobank0)
+
+#endif /* CAN_SHIM_IOBANK0_H_ */
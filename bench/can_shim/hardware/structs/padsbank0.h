@@ -0,0 +1,26 @@
+/**
+ * padsbank0.h
+ * Jannis Lämmle
+ * Host stand-in, see bench/can_shim/hardware/structs/pio.h
+ */
+
+#ifndef CAN_SHIM_PADSBANK0_H_
+#define CAN_SHIM_PADSBANK0_H_
+
+#include <stdint.h>
+
+#define PADS_BANK0_GPIO0_IE_BITS 0x40u
+#define PADS_BANK0_GPIO0_DRIVE_MSB 5
+#define PADS_BANK0_GPIO0_DRIVE_VALUE_4MA 1
+#define PADS_BANK0_GPIO0_PUE_BITS 0x08u
+#define PADS_BANK0_GPIO0_PDE_BITS 0x04u
+
+typedef struct {
+    volatile uint32_t voltage_select;
+    volatile uint32_t io[48];
+} padsbank0_hw_t;
+
+static padsbank0_hw_t can_shim_padsbank0;
+#define padsbank0_hw (&can_shim_padsbank0)
+
+#endif /* CAN_SHIM_PADSBANK0_H_ */
@@ -0,0 +1,84 @@
+/**
+ * pio.h
+ * Jannis Lämmle
+ * Host stand-in for the PIO registers, so port/board/can/can.c builds on the host (bench/bench_can.c)
+ *
+ * The registers are plain memory: writes of the driver land there and the bench sets what the driver
+ * reads (interrupt flags, FIFO levels). Bit positions follow the RP2040 datasheet.
+ */
+
+#ifndef CAN_SHIM_PIO_H_
+#define CAN_SHIM_PIO_H_
+
+#include <stdint.h>
+
+#define PIO_CTRL_SM_ENABLE_LSB 0
+#define PIO_CTRL_SM_RESTART_LSB 4
+#define PIO_CTRL_SM_RESTART_BITS 0x000000f0u
+#define PIO_CTRL_CLKDIV_RESTART_BITS 0x00000f00u
+
+#define PIO_FDEBUG_RXSTALL_LSB 0
+#define PIO_FLEVEL_RX1_LSB 12
+#define PIO_FLEVEL_TX3_BITS 0x0f000000u
+
+#define PIO_IRQ0_INTE_SM1_RXNEMPTY_BITS 0x00000002u
+#define PIO_IRQ0_INTE_SM0_BITS 0x00000100u
+#define PIO_IRQ0_INTE_SM1_BITS 0x00000200u
+#define PIO_IRQ0_INTE_SM2_BITS 0x00000400u
+#define PIO_IRQ0_INTE_SM3_BITS 0x00000800u
+
+#define PIO_SM0_CLKDIV_FRAC_LSB 8
+#define PIO_SM0_EXECCTRL_JMP_PIN_LSB 24
+#define PIO_SM0_EXECCTRL_WRAP_TOP_LSB 12
+#define PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB 7
+#define PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS 0x80000000u
+#define PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS 0x40000000u
+#define PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB 20
+#define PIO_SM0_SHIFTCTRL_AUTOPULL_BITS 0x00020000u
+#define PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS 0x00010000u
+#define PIO_SM0_PINCTRL_SET_COUNT_LSB 26
+#define PIO_SM0_PINCTRL_OUT_COUNT_LSB 20
+#define PIO_SM0_PINCTRL_IN_BASE_LSB 15
+#define PIO_SM0_PINCTRL_SET_BASE_LSB 5
+#define PIO_SM0_PINCTRL_OUT_BASE_LSB 0
+
+typedef struct {
+    volatile uint32_t clkdiv;
+    volatile uint32_t execctrl;
+    volatile uint32_t shiftctrl;
+    volatile uint32_t addr;
+    volatile uint32_t instr;
+    volatile uint32_t pinctrl;
+} pio_sm_hw_t;
+
+typedef struct {
+    volatile uint32_t ctrl;
+    volatile uint32_t fstat;
+    volatile uint32_t fdebug;
+    volatile uint32_t flevel;
+    volatile uint32_t txf[4];
+    volatile uint32_t rxf[4];
+    volatile uint32_t irq;
+    volatile uint32_t irq_force;
+    volatile uint32_t input_sync_bypass;
+    volatile uint32_t dbg_padout;
+    volatile uint32_t dbg_padoe;
+    volatile uint32_t dbg_cfginfo;
+    volatile uint32_t instr_mem[32];
+    pio_sm_hw_t sm[4];
+    volatile uint32_t intr;
+    volatile uint32_t inte0;
+    volatile uint32_t intf0;
+    volatile uint32_t ints0;
+    volatile uint32_t inte1;
+    volatile uint32_t intf1;
+    volatile uint32_t ints1;
+    volatile uint32_t gpiobase;
+} pio_hw_t;
+
+static pio_hw_t can_shim_pio[3];
+#define pio0_hw (&can_shim_pio[0])
+#define pio1_hw (&can_shim_pio[1])
+#define pio2_hw (&can_shim_pio[2])
+
+#endif /* CAN_SHIM_PIO_H_ */
@@ -0,0 +1,30 @@
+/**
+ * resets.h
+ * Jannis Lämmle
+ * Host stand-in, see bench/can_shim/hardware/structs/pio.h. The blocks are never held in reset
+ */
+
+#ifndef CAN_SHIM_RESETS_H_
+#define CAN_SHIM_RESETS_H_
+
+#include <stdint.h>
+
+#define RESETS_RESET_PIO0_BITS (1u << 10)
+#define RESETS_RESET_PIO1_BITS (1u << 11)
+#define RESETS_RESET_PIO2_BITS (1u << 12)
+
+typedef struct {
+    volatile uint32_t reset;
+    volatile uint32_t wdsel;
+    volatile uint32_t reset_done;
+} resets_hw_t;
+
+static resets_hw_t can_shim_resets = {.reset_done = 0xffffffffu};
+#define resets_hw (&can_shim_resets)
+
+static inline void hw_clear_bits(volatile uint32_t * addr, uint32_t mask)
+{
+    *addr &= ~mask;
+}
+
+#endif /* CAN_SHIM_RESETS_H_ */
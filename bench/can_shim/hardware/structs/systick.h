@@ -0,0 +1,27 @@
+/**
+ * systick.h
+ * Jannis Lämmle
+ * Host stand-in for the SysTick registers, see bench/can_shim/hardware/structs/pio.h
+ *
+ * The counter does not run, the irq handler statistics of can2040 read 0 cycles on the host.
+ */
+
+#ifndef CAN_SHIM_SYSTICK_H_
+#define CAN_SHIM_SYSTICK_H_
+
+#include <stdint.h>
+
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x00000001u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x00000004u
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+} systick_hw_t;
+
+static systick_hw_t can_shim_systick;
+#define systick_hw (&can_shim_systick)
+
+#endif /* CAN_SHIM_SYSTICK_H_ */
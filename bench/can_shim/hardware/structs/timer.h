@@ -0,0 +1,28 @@
+/**
+ * timer.h
+ * Jannis Lämmle
+ * Host stand-in for the microsecond timer, see bench/can_shim/hardware/structs/pio.h
+ *
+ * The timer does not run, bench/bench_can.c sets it to the line time of the simulated bits.
+ */
+
+#ifndef CAN_SHIM_TIMER_H_
+#define CAN_SHIM_TIMER_H_
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t timehw;
+    volatile uint32_t timelw;
+    volatile uint32_t timehr;
+    volatile uint32_t timelr;
+    volatile uint32_t alarm[4];
+    volatile uint32_t armed;
+    volatile uint32_t timerawh;
+    volatile uint32_t timerawl;
+} timer_hw_t;
+
+static timer_hw_t can_shim_timer;
+#define timer_hw (&can_shim_timer)
+
+#endif /* CAN_SHIM_TIMER_H_ */
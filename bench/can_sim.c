@@ -0,0 +1,152 @@
+/**
+ * can_sim.c
+ * Jannis Lämmle
+ * Bit level CAN line simulator, see can_sim.h
+ */
+
+#include <string.h>
+
+#include "can_sim.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define CAN_SIM_CRC_POLY 0x4599
+#define CAN_SIM_FRAME_BITS 160      // stuffed start of frame to crc of an extended frame with 8 bytes: 154
+#define CAN_SIM_SYNC_BITS 10        // recessive bits the PIO samples before it waits for the next edge
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void can_sim_push(can_sim_t * sim, uint32_t level)
+{
+    sim->word = (sim->word << 1) | (level & 1);
+    if(++sim->word_bits < CAN_SIM_WORD_BITS) return;
+
+    if(sim->count < CAN_SIM_MAX_WORDS) sim->words[sim->count++] = sim->word;
+    sim->word = 0;
+    sim->word_bits = 0;
+}
+
+// The sync state machine stops clocking the rx state machine after CAN_SIM_SYNC_BITS recessive bits and
+// restarts it at the falling edge of the next start of frame, so the intermission and an idle bus are
+// only partially sampled
+static void can_sim_put(can_sim_t * sim, uint32_t level)
+{
+    sim->bits++;
+    if(!level) sim->recessive = 0;
+    else if(++sim->recessive > CAN_SIM_SYNC_BITS) return;
+
+    can_sim_push(sim, level);
+}
+
+static void can_sim_put_level(can_sim_t * sim, uint32_t level, uint32_t bits)
+{
+    while(bits--) can_sim_put(sim, level);
+}
+
+// Appends the upper bits of value, most significant first
+static uint32_t can_sim_field(uint8_t * bits, uint32_t pos, uint32_t value, uint32_t count)
+{
+    while(count--) bits[pos++] = (value >> count) & 1;
+    return pos;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void can_sim_reset(can_sim_t * sim)
+{
+    memset(sim, 0, sizeof(*sim));
+}
+
+void can_sim_idle(can_sim_t * sim, uint32_t bits)
+{
+    can_sim_put_level(sim, 1, bits);
+}
+
+void can_sim_frame(can_sim_t * sim, const struct can2040_msg * msg, can_sim_error_t error, uint32_t bit)
+{
+    uint8_t raw[CAN_SIM_FRAME_BITS];
+    uint8_t stuffed[CAN_SIM_FRAME_BITS];
+    uint32_t rtr = !!(msg->id & CAN2040_ID_RTR);
+    uint32_t dlc = msg->dlc & 0x0f;
+    uint32_t len = rtr ? 0 : (dlc > 8 ? 8 : dlc);
+    uint32_t pos = 0;
+
+    // Start of frame, arbitration and control field
+    raw[pos++] = 0;
+    if(msg->id & CAN2040_ID_EFF)
+    {
+        pos = can_sim_field(raw, pos, (msg->id >> 18) & 0x7ff, 11);
+        pos = can_sim_field(raw, pos, 0x3, 2);                      // srr, ide
+        pos = can_sim_field(raw, pos, msg->id & 0x3ffff, 18);
+        pos = can_sim_field(raw, pos, rtr << 2, 3);                 // rtr, r1, r0
+    }
+    else
+    {
+        pos = can_sim_field(raw, pos, msg->id & 0x7ff, 11);
+        pos = can_sim_field(raw, pos, rtr << 2, 3);                 // rtr, ide, r0
+    }
+    pos = can_sim_field(raw, pos, dlc, 4);
+    for(uint32_t i = 0; i < len; i++) pos = can_sim_field(raw, pos, msg->data[i], 8);
+
+    uint32_t crc = 0;
+    for(uint32_t i = 0; i < pos; i++)
+    {
+        uint32_t next = raw[i] ^ ((crc >> 14) & 1);
+        crc = (crc << 1) & 0x7fff;
+        if(next) crc ^= CAN_SIM_CRC_POLY;
+    }
+    pos = can_sim_field(raw, pos, crc, 15);
+
+    // A bit of opposite level after five equal ones
+    uint32_t count = 0;
+    uint32_t run = 0;
+    for(uint32_t i = 0; i < pos; i++)
+    {
+        if(i && raw[i] == stuffed[count - 1]) run++;
+        else run = 1;
+        stuffed[count++] = raw[i];
+        if(run == 5)
+        {
+            stuffed[count] = !stuffed[count - 1];
+            count++;
+            run = 1;
+        }
+    }
+
+    if(bit < 1) bit = 1;
+    if(bit >= count) bit = count - 1;
+    if(error == CAN_SIM_ERROR_FLIP) stuffed[bit] ^= 1;
+
+    sim->sof = sim->count * CAN_SIM_WORD_BITS + sim->word_bits;
+    uint32_t end = error == CAN_SIM_ERROR_FRAME ? bit : count;
+    for(uint32_t i = 0; i < end; i++) can_sim_put(sim, stuffed[i]);
+
+    if(error == CAN_SIM_ERROR_FRAME)
+    {
+        can_sim_put_level(sim, 0, 6);           // error flag
+        can_sim_put_level(sim, 1, 8);           // error delimiter
+    }
+    else
+    {
+        can_sim_put(sim, 1);                    // crc delimiter
+        can_sim_put(sim, 0);                    // ack slot
+        can_sim_put(sim, 1);                    // ack delimiter
+        can_sim_put_level(sim, 1, 7);           // end of frame
+    }
+    can_sim_put_level(sim, 1, 3);               // intermission
+    sim->frames++;
+}
+
+void can_sim_flush(can_sim_t * sim)
+{
+    while(sim->word_bits) can_sim_push(sim, 1);
+}
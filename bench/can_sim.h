@@ -0,0 +1,66 @@
+/**
+ * can_sim.h
+ * Jannis Lämmle
+ * Bit level CAN line simulator for the host benchmarks of can2040 (bench/bench_can.c)
+ *
+ * Frames are encoded bit by bit, independent of the encoder in can.c: header, data and a CRC-15 computed
+ * per bit, bit stuffing from the start of frame to the end of the crc, then crc delimiter, a dominant ack
+ * slot (acked by some node), ack delimiter, end of frame and intermission. The line level (1 = recessive)
+ * is packed into words as the PIO rx state machine pushes them: CAN_SIM_WORD_BITS bits per word, the
+ * oldest bit highest. Like the PIO, the simulator stops sampling after 10 recessive bits until the next
+ * dominant bit. The words are fed to process_rx() the way the irq handler reads them from the FIFO.
+ *
+ * Errors are injected per frame: a flipped bit between start of frame and the end of the crc, or an
+ * error frame (6 dominant bits, 8 recessive delimiter bits) that cuts the frame off at the given bit.
+ */
+
+#ifndef CAN_SIM_H_
+#define CAN_SIM_H_
+
+#include <stdint.h>
+
+#include "can.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define CAN_SIM_WORD_BITS 10        // PIO_RX_WAKE_BITS of can.c
+#define CAN_SIM_MAX_WORDS 4096      // ~250 frames with 8 data bytes
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum can_sim_error {
+    CAN_SIM_ERROR_NONE,
+    CAN_SIM_ERROR_FLIP,             // invert one stuffed bit
+    CAN_SIM_ERROR_FRAME,            // a node sends an error frame instead of the rest of the frame
+} can_sim_error_t;
+
+typedef struct can_sim {
+    uint32_t words[CAN_SIM_MAX_WORDS];
+    uint32_t count;                 // complete words
+    uint32_t word;                  // word being filled
+    uint32_t word_bits;
+    uint32_t recessive;             // recessive bits in a row, sampling stops after 10
+    uint32_t frames;
+    uint32_t sof;                   // sampled bits before the start of the last frame
+    uint32_t bits;                  // line bits in total
+} can_sim_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void can_sim_reset(can_sim_t * sim);
+void can_sim_idle(can_sim_t * sim, uint32_t bits);  // recessive bits on an idle bus
+// Encodes msg (id with the CAN2040_ID_EFF and CAN2040_ID_RTR flags), followed by the intermission.
+// bit counts the stuffed bits from the start of frame, it is clamped to the stuffed part of the frame.
+void can_sim_frame(can_sim_t * sim, const struct can2040_msg * msg, can_sim_error_t error, uint32_t bit);
+void can_sim_flush(can_sim_t * sim);                // pads the last word with recessive bits, so it is pushed
+
+#endif /* CAN_SIM_H_ */
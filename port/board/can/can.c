@@ -8,12 +8,19 @@
 #include <string.h> // memset
 #include "can.h" // can2040_setup
 #include "cmsis_gcc.h" // __DMB
+#include "trace.h" // TRACE_BEGIN
 #include "hardware/regs/dreq.h" // DREQ_PIO0_RX1
 #include "hardware/structs/dma.h" // dma_hw
 #include "hardware/structs/iobank0.h" // iobank0_hw
 #include "hardware/structs/padsbank0.h" // padsbank0_hw
 #include "hardware/structs/pio.h" // pio0_hw
 #include "hardware/structs/resets.h" // RESETS_RESET_PIO0_BITS
+#include "hardware/structs/timer.h" // timer_hw
+#ifdef PICO_RP2350
+#include "hardware/structs/m33.h" // m33_hw
+#else
+#include "hardware/structs/systick.h" // systick_hw
+#endif
 
 
 /****************************************************************
@@ -56,6 +63,65 @@ rp2040_clear_reset(uint32_t reset_bit)
     }
 }
 
+// Start the cycle counter used for the irq handler statistics
+static void
+cycle_counter_setup(void)
+{
+#if IS_RP2350
+    m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+    m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+#else
+    // Free running SysTick - left alone if already started (it is then
+    // expected to use the full 24-bit reload)
+    if (!(systick_hw->csr & M0PLUS_SYST_CSR_ENABLE_BITS)) {
+        systick_hw->rvr = 0x00ffffff;
+        systick_hw->cvr = 0;
+        systick_hw->csr = (M0PLUS_SYST_CSR_CLKSOURCE_BITS
+                           | M0PLUS_SYST_CSR_ENABLE_BITS);
+    }
+#endif
+}
+
+// Read the cycle counter
+static inline uint32_t
+cycle_counter_read(void)
+{
+#if IS_RP2350
+    return m33_hw->dwt_cyccnt;
+#else
+    return systick_hw->cvr;
+#endif
+}
+
+// Return the cycles from 'start' to 'end' (two cycle_counter_read() values)
+static inline uint32_t
+cycle_counter_elapsed(uint32_t start, uint32_t end)
+{
+    if (IS_RP2350)
+        return end - start;
+    // SysTick counts down
+    return (start - end) & 0x00ffffff;
+}
+
+// Read the 64-bit microsecond timer (without the latching registers,
+// which are not safe to use from irq and thread context at once)
+static uint64_t
+timer_read_us(void)
+{
+#if IS_RP2350
+    timer_hw_t *hw = timer0_hw;
+#else
+    timer_hw_t *hw = timer_hw;
+#endif
+    uint32_t hi = hw->timerawh;
+    for (;;) {
+        uint32_t lo = hw->timerawl, next_hi = hw->timerawh;
+        if (likely(next_hi == hi))
+            return ((uint64_t)hi << 32) | lo;
+        hi = next_hi;
+    }
+}
+
 // Helper to set the mode and extended function of a pin
 static void
 rp2040_gpio_peripheral(uint32_t gpio, int func, int pull_up)
@@ -435,6 +501,22 @@ pio_setup(struct can2040 *cd, uint32_t sys_clock, uint32_t bitrate)
  * CRC calculation
  ****************************************************************/
 
+// Kernels of crc_bytes(), chosen with CAN2040_CRC_KERNEL=<n>: the
+// 256 entry byte table, a 16 entry nibble table (32 bytes, in ram), or
+// slice-by-4 (1.5KiB more tables, 32 data bits in four independent
+// lookups).  Defaults to slice-by-4 on the rp2350 and the byte table
+// otherwise.
+#define CRC_KERNEL_TABLE 1
+#define CRC_KERNEL_NIBBLE 2
+#define CRC_KERNEL_SLICE4 3
+#ifndef CAN2040_CRC_KERNEL
+  #if IS_RP2350
+    #define CAN2040_CRC_KERNEL CRC_KERNEL_SLICE4
+  #else
+    #define CAN2040_CRC_KERNEL CRC_KERNEL_TABLE
+  #endif
+#endif
+
 // Calculated 8-bit crc table (see scripts/crc.py)
 static const uint16_t crc_table[256] = {
     0x0000,0x4599,0x4eab,0x0b32,0x58cf,0x1d56,0x1664,0x53fd,0x7407,0x319e,
@@ -465,6 +547,102 @@ static const uint16_t crc_table[256] = {
     0x1dc3,0x585a,0x0ba7,0x4e3e,0x450c,0x0095
 };
 
+// crc_table[] advanced by 1, 2 and 3 more zero bytes - the crc of a
+// byte followed by that many bytes, for crc_bytes_slice4()
+static const uint16_t crc_slice_table[3][256] = {
+    {
+        0x0000,0x4426,0x4dd5,0x09f3,0x5e33,0x1a15,0x13e6,0x57c0,0x79ff,0x3dd9,
+        0x342a,0x700c,0x27cc,0x63ea,0x6a19,0x2e3f,0x3667,0x7241,0x7bb2,0x3f94,
+        0x6854,0x2c72,0x2581,0x61a7,0x4f98,0x0bbe,0x024d,0x466b,0x11ab,0x558d,
+        0x5c7e,0x1858,0x6cce,0x28e8,0x211b,0x653d,0x32fd,0x76db,0x7f28,0x3b0e,
+        0x1531,0x5117,0x58e4,0x1cc2,0x4b02,0x0f24,0x06d7,0x42f1,0x5aa9,0x1e8f,
+        0x177c,0x535a,0x049a,0x40bc,0x494f,0x0d69,0x2356,0x6770,0x6e83,0x2aa5,
+        0x7d65,0x3943,0x30b0,0x7496,0x1c05,0x5823,0x51d0,0x15f6,0x4236,0x0610,
+        0x0fe3,0x4bc5,0x65fa,0x21dc,0x282f,0x6c09,0x3bc9,0x7fef,0x761c,0x323a,
+        0x2a62,0x6e44,0x67b7,0x2391,0x7451,0x3077,0x3984,0x7da2,0x539d,0x17bb,
+        0x1e48,0x5a6e,0x0dae,0x4988,0x407b,0x045d,0x70cb,0x34ed,0x3d1e,0x7938,
+        0x2ef8,0x6ade,0x632d,0x270b,0x0934,0x4d12,0x44e1,0x00c7,0x5707,0x1321,
+        0x1ad2,0x5ef4,0x46ac,0x028a,0x0b79,0x4f5f,0x189f,0x5cb9,0x554a,0x116c,
+        0x3f53,0x7b75,0x7286,0x36a0,0x6160,0x2546,0x2cb5,0x6893,0x380a,0x7c2c,
+        0x75df,0x31f9,0x6639,0x221f,0x2bec,0x6fca,0x41f5,0x05d3,0x0c20,0x4806,
+        0x1fc6,0x5be0,0x5213,0x1635,0x0e6d,0x4a4b,0x43b8,0x079e,0x505e,0x1478,
+        0x1d8b,0x59ad,0x7792,0x33b4,0x3a47,0x7e61,0x29a1,0x6d87,0x6474,0x2052,
+        0x54c4,0x10e2,0x1911,0x5d37,0x0af7,0x4ed1,0x4722,0x0304,0x2d3b,0x691d,
+        0x60ee,0x24c8,0x7308,0x372e,0x3edd,0x7afb,0x62a3,0x2685,0x2f76,0x6b50,
+        0x3c90,0x78b6,0x7145,0x3563,0x1b5c,0x5f7a,0x5689,0x12af,0x456f,0x0149,
+        0x08ba,0x4c9c,0x240f,0x6029,0x69da,0x2dfc,0x7a3c,0x3e1a,0x37e9,0x73cf,
+        0x5df0,0x19d6,0x1025,0x5403,0x03c3,0x47e5,0x4e16,0x0a30,0x1268,0x564e,
+        0x5fbd,0x1b9b,0x4c5b,0x087d,0x018e,0x45a8,0x6b97,0x2fb1,0x2642,0x6264,
+        0x35a4,0x7182,0x7871,0x3c57,0x48c1,0x0ce7,0x0514,0x4132,0x16f2,0x52d4,
+        0x5b27,0x1f01,0x313e,0x7518,0x7ceb,0x38cd,0x6f0d,0x2b2b,0x22d8,0x66fe,
+        0x7ea6,0x3a80,0x3373,0x7755,0x2095,0x64b3,0x6d40,0x2966,0x0759,0x437f,
+        0x4a8c,0x0eaa,0x596a,0x1d4c,0x14bf,0x5099
+    },
+    {
+        0x0000,0x7014,0x25b1,0x55a5,0x4b62,0x3b76,0x6ed3,0x1ec7,0x535d,0x2349,
+        0x76ec,0x06f8,0x183f,0x682b,0x3d8e,0x4d9a,0x6323,0x1337,0x4692,0x3686,
+        0x2841,0x5855,0x0df0,0x7de4,0x307e,0x406a,0x15cf,0x65db,0x7b1c,0x0b08,
+        0x5ead,0x2eb9,0x03df,0x73cb,0x266e,0x567a,0x48bd,0x38a9,0x6d0c,0x1d18,
+        0x5082,0x2096,0x7533,0x0527,0x1be0,0x6bf4,0x3e51,0x4e45,0x60fc,0x10e8,
+        0x454d,0x3559,0x2b9e,0x5b8a,0x0e2f,0x7e3b,0x33a1,0x43b5,0x1610,0x6604,
+        0x78c3,0x08d7,0x5d72,0x2d66,0x07be,0x77aa,0x220f,0x521b,0x4cdc,0x3cc8,
+        0x696d,0x1979,0x54e3,0x24f7,0x7152,0x0146,0x1f81,0x6f95,0x3a30,0x4a24,
+        0x649d,0x1489,0x412c,0x3138,0x2fff,0x5feb,0x0a4e,0x7a5a,0x37c0,0x47d4,
+        0x1271,0x6265,0x7ca2,0x0cb6,0x5913,0x2907,0x0461,0x7475,0x21d0,0x51c4,
+        0x4f03,0x3f17,0x6ab2,0x1aa6,0x573c,0x2728,0x728d,0x0299,0x1c5e,0x6c4a,
+        0x39ef,0x49fb,0x6742,0x1756,0x42f3,0x32e7,0x2c20,0x5c34,0x0991,0x7985,
+        0x341f,0x440b,0x11ae,0x61ba,0x7f7d,0x0f69,0x5acc,0x2ad8,0x0f7c,0x7f68,
+        0x2acd,0x5ad9,0x441e,0x340a,0x61af,0x11bb,0x5c21,0x2c35,0x7990,0x0984,
+        0x1743,0x6757,0x32f2,0x42e6,0x6c5f,0x1c4b,0x49ee,0x39fa,0x273d,0x5729,
+        0x028c,0x7298,0x3f02,0x4f16,0x1ab3,0x6aa7,0x7460,0x0474,0x51d1,0x21c5,
+        0x0ca3,0x7cb7,0x2912,0x5906,0x47c1,0x37d5,0x6270,0x1264,0x5ffe,0x2fea,
+        0x7a4f,0x0a5b,0x149c,0x6488,0x312d,0x4139,0x6f80,0x1f94,0x4a31,0x3a25,
+        0x24e2,0x54f6,0x0153,0x7147,0x3cdd,0x4cc9,0x196c,0x6978,0x77bf,0x07ab,
+        0x520e,0x221a,0x08c2,0x78d6,0x2d73,0x5d67,0x43a0,0x33b4,0x6611,0x1605,
+        0x5b9f,0x2b8b,0x7e2e,0x0e3a,0x10fd,0x60e9,0x354c,0x4558,0x6be1,0x1bf5,
+        0x4e50,0x3e44,0x2083,0x5097,0x0532,0x7526,0x38bc,0x48a8,0x1d0d,0x6d19,
+        0x73de,0x03ca,0x566f,0x267b,0x0b1d,0x7b09,0x2eac,0x5eb8,0x407f,0x306b,
+        0x65ce,0x15da,0x5840,0x2854,0x7df1,0x0de5,0x1322,0x6336,0x3693,0x4687,
+        0x683e,0x182a,0x4d8f,0x3d9b,0x235c,0x5348,0x06ed,0x76f9,0x3b63,0x4b77,
+        0x1ed2,0x6ec6,0x7001,0x0015,0x55b0,0x25a4
+    },
+    {
+        0x0000,0x1ef8,0x3df0,0x2308,0x7be0,0x6518,0x4610,0x58e8,0x3259,0x2ca1,
+        0x0fa9,0x1151,0x49b9,0x5741,0x7449,0x6ab1,0x64b2,0x7a4a,0x5942,0x47ba,
+        0x1f52,0x01aa,0x22a2,0x3c5a,0x56eb,0x4813,0x6b1b,0x75e3,0x2d0b,0x33f3,
+        0x10fb,0x0e03,0x0cfd,0x1205,0x310d,0x2ff5,0x771d,0x69e5,0x4aed,0x5415,
+        0x3ea4,0x205c,0x0354,0x1dac,0x4544,0x5bbc,0x78b4,0x664c,0x684f,0x76b7,
+        0x55bf,0x4b47,0x13af,0x0d57,0x2e5f,0x30a7,0x5a16,0x44ee,0x67e6,0x791e,
+        0x21f6,0x3f0e,0x1c06,0x02fe,0x19fa,0x0702,0x240a,0x3af2,0x621a,0x7ce2,
+        0x5fea,0x4112,0x2ba3,0x355b,0x1653,0x08ab,0x5043,0x4ebb,0x6db3,0x734b,
+        0x7d48,0x63b0,0x40b8,0x5e40,0x06a8,0x1850,0x3b58,0x25a0,0x4f11,0x51e9,
+        0x72e1,0x6c19,0x34f1,0x2a09,0x0901,0x17f9,0x1507,0x0bff,0x28f7,0x360f,
+        0x6ee7,0x701f,0x5317,0x4def,0x275e,0x39a6,0x1aae,0x0456,0x5cbe,0x4246,
+        0x614e,0x7fb6,0x71b5,0x6f4d,0x4c45,0x52bd,0x0a55,0x14ad,0x37a5,0x295d,
+        0x43ec,0x5d14,0x7e1c,0x60e4,0x380c,0x26f4,0x05fc,0x1b04,0x33f4,0x2d0c,
+        0x0e04,0x10fc,0x4814,0x56ec,0x75e4,0x6b1c,0x01ad,0x1f55,0x3c5d,0x22a5,
+        0x7a4d,0x64b5,0x47bd,0x5945,0x5746,0x49be,0x6ab6,0x744e,0x2ca6,0x325e,
+        0x1156,0x0fae,0x651f,0x7be7,0x58ef,0x4617,0x1eff,0x0007,0x230f,0x3df7,
+        0x3f09,0x21f1,0x02f9,0x1c01,0x44e9,0x5a11,0x7919,0x67e1,0x0d50,0x13a8,
+        0x30a0,0x2e58,0x76b0,0x6848,0x4b40,0x55b8,0x5bbb,0x4543,0x664b,0x78b3,
+        0x205b,0x3ea3,0x1dab,0x0353,0x69e2,0x771a,0x5412,0x4aea,0x1202,0x0cfa,
+        0x2ff2,0x310a,0x2a0e,0x34f6,0x17fe,0x0906,0x51ee,0x4f16,0x6c1e,0x72e6,
+        0x1857,0x06af,0x25a7,0x3b5f,0x63b7,0x7d4f,0x5e47,0x40bf,0x4ebc,0x5044,
+        0x734c,0x6db4,0x355c,0x2ba4,0x08ac,0x1654,0x7ce5,0x621d,0x4115,0x5fed,
+        0x0705,0x19fd,0x3af5,0x240d,0x26f3,0x380b,0x1b03,0x05fb,0x5d13,0x43eb,
+        0x60e3,0x7e1b,0x14aa,0x0a52,0x295a,0x37a2,0x6f4a,0x71b2,0x52ba,0x4c42,
+        0x4241,0x5cb9,0x7fb1,0x6149,0x39a1,0x2759,0x0451,0x1aa9,0x7018,0x6ee0,
+        0x4de8,0x5310,0x0bf8,0x1500,0x3608,0x28f0
+    }
+};
+
+// Calculated 4-bit crc table, in ram (no flash access from the irq
+// handler on the rp2040)
+static uint16_t crc_nibble_table[16] = {
+    0x0000,0x4599,0x4eab,0x0b32,0x58cf,0x1d56,0x1664,0x53fd,0x7407,0x319e,
+    0x3aac,0x7f35,0x2cc8,0x6951,0x6263,0x27fa
+};
+
 // Update a crc with 8 bits of data
 static uint32_t
 crc_byte(uint32_t crc, uint32_t data)
@@ -472,9 +650,9 @@ crc_byte(uint32_t crc, uint32_t data)
     return (crc << 8) ^ crc_table[((crc >> 7) ^ data) & 0xff];
 }
 
-// Update a crc with 8, 16, 24, or 32 bits of data
+// Update a crc with 8, 16, 24, or 32 bits of data (byte table)
 static inline uint32_t
-crc_bytes(uint32_t crc, uint32_t data, uint32_t num)
+crc_bytes_table(uint32_t crc, uint32_t data, uint32_t num)
 {
     switch (num) {
     default: crc = crc_byte(crc, data >> 24); /* FALLTHRU */
@@ -485,6 +663,67 @@ crc_bytes(uint32_t crc, uint32_t data, uint32_t num)
     return crc;
 }
 
+// Update a crc with 8 bits of data (nibble table)
+static inline uint32_t
+crc_byte_nibble(uint32_t crc, uint32_t data)
+{
+    crc = (crc << 4) ^ crc_nibble_table[((crc >> 11) ^ (data >> 4)) & 0x0f];
+    return (crc << 4) ^ crc_nibble_table[((crc >> 11) ^ data) & 0x0f];
+}
+
+// Update a crc with 8, 16, 24, or 32 bits of data (nibble table)
+static inline uint32_t
+crc_bytes_nibble(uint32_t crc, uint32_t data, uint32_t num)
+{
+    switch (num) {
+    default: crc = crc_byte_nibble(crc, data >> 24); /* FALLTHRU */
+    case 3:  crc = crc_byte_nibble(crc, data >> 16); /* FALLTHRU */
+    case 2:  crc = crc_byte_nibble(crc, data >> 8);  /* FALLTHRU */
+    case 1:  crc = crc_byte_nibble(crc, data);
+    }
+    return crc;
+}
+
+// Update a crc with 8, 16, 24, or 32 bits of data (slice-by-4)
+//
+// The crc is xor'ed into the leading 15 data bits, then every byte is
+// looked up in the table of its distance to the end - independent
+// lookups instead of a chain of dependent ones.
+static inline uint32_t
+crc_bytes_slice4(uint32_t crc, uint32_t data, uint32_t num)
+{
+    if (num == 1)
+        // Fewer data bits than crc bits
+        return crc_byte(crc, data);
+    uint32_t x;
+    switch (num) {
+    default:
+        x = data ^ (crc << 17);
+        return (crc_slice_table[2][x >> 24]
+                ^ crc_slice_table[1][(x >> 16) & 0xff]
+                ^ crc_slice_table[0][(x >> 8) & 0xff] ^ crc_table[x & 0xff]);
+    case 3:
+        x = (data << 8) ^ (crc << 17);
+        return (crc_slice_table[1][x >> 24]
+                ^ crc_slice_table[0][(x >> 16) & 0xff]
+                ^ crc_table[(x >> 8) & 0xff]);
+    case 2:
+        x = (data << 16) ^ (crc << 17);
+        return crc_slice_table[0][x >> 24] ^ crc_table[(x >> 16) & 0xff];
+    }
+}
+
+// Update a crc with 8, 16, 24, or 32 bits of data
+static inline uint32_t
+crc_bytes(uint32_t crc, uint32_t data, uint32_t num)
+{
+    if (CAN2040_CRC_KERNEL == CRC_KERNEL_SLICE4)
+        return crc_bytes_slice4(crc, data, num);
+    if (CAN2040_CRC_KERNEL == CRC_KERNEL_NIBBLE)
+        return crc_bytes_nibble(crc, data, num);
+    return crc_bytes_table(crc, data, num);
+}
+
 
 /****************************************************************
  * Bit unstuffing
@@ -745,11 +984,51 @@ enum {
     TS_IDLE = 0, TS_QUEUED = 1, TS_ACKING_RX = 2, TS_CONFIRM_TX = 3
 };
 
+_Static_assert((CAN2040_TX_QUEUE_SIZE & (CAN2040_TX_QUEUE_SIZE - 1)) == 0
+               && CAN2040_TX_QUEUE_SIZE <= 256
+               , "CAN2040_TX_QUEUE_SIZE must be a power of two up to 256");
+
 // Calculate queue array position from a transmit index
 static uint32_t
 tx_qpos(struct can2040 *cd, uint32_t pos)
 {
-    return pos % ARRAY_SIZE(cd->tx_queue);
+    return pos % ARRAY_SIZE(cd->tx_order);
+}
+
+// Return the queue entry at a transmit index
+//
+// Entries are reached through tx_order[], a permutation of the
+// tx_queue[] slots.  Positions from tx_pull_pos to tx_push_pos are owned
+// by the irq handler, which may reorder them.  The remaining positions
+// hold the free slots - can2040_transmit() fills the slot at
+// tx_push_pos, so neither side ever writes what the other one reads.
+static struct can2040_transmit *
+tx_entry(struct can2040 *cd, uint32_t pos)
+{
+    return &cd->tx_queue[cd->tx_order[tx_qpos(cd, pos)]];
+}
+
+// Move the pending message that wins bus arbitration to the queue head
+static void
+tx_select_next(struct can2040 *cd, uint32_t tx_pull_pos, uint32_t tx_push_pos)
+{
+    uint32_t best_pos = tx_pull_pos;
+    uint32_t best = tx_entry(cd, tx_pull_pos)->arbitration;
+    uint32_t pos;
+    for (pos = tx_pull_pos + 1; pos != tx_push_pos; pos++) {
+        uint32_t arbitration = tx_entry(cd, pos)->arbitration;
+        if (arbitration < best) {
+            best_pos = pos;
+            best = arbitration;
+        }
+    }
+    if (best_pos == tx_pull_pos)
+        return;
+    // Rotate (instead of swap) to keep messages of equal id in fifo order
+    uint8_t slot = cd->tx_order[tx_qpos(cd, best_pos)];
+    for (pos = best_pos; pos != tx_pull_pos; pos--)
+        cd->tx_order[tx_qpos(cd, pos)] = cd->tx_order[tx_qpos(cd, pos - 1)];
+    cd->tx_order[tx_qpos(cd, tx_pull_pos)] = slot;
 }
 
 // Queue the next message for transmission in the PIO
@@ -760,19 +1039,24 @@ tx_schedule_transmit(struct can2040 *cd)
         // Already queued or actively transmitting
         return 0;
     uint32_t tx_pull_pos = cd->tx_pull_pos;
-    if (readl(&cd->tx_push_pos) == tx_pull_pos) {
+    uint32_t tx_push_pos = readl(&cd->tx_push_pos);
+    if (tx_push_pos == tx_pull_pos) {
         // No new messages to transmit
         cd->tx_state = TS_IDLE;
         pio_signal_clear_txpending(cd);
         __DMB();
-        if (likely(readl(&cd->tx_push_pos) == tx_pull_pos))
+        tx_push_pos = readl(&cd->tx_push_pos);
+        if (likely(tx_push_pos == tx_pull_pos))
             return SI_TXPENDING;
         // Raced with can2040_transmit() - msg is now available for transmit
         pio_signal_set_txpending(cd);
     }
+    if (cd->tx_state != TS_QUEUED)
+        // New head (a retry after a failed attempt keeps its message)
+        tx_select_next(cd, tx_pull_pos, tx_push_pos);
     cd->tx_state = TS_QUEUED;
     cd->stats.tx_attempt++;
-    struct can2040_transmit *qt = &cd->tx_queue[tx_qpos(cd, tx_pull_pos)];
+    struct can2040_transmit *qt = tx_entry(cd, tx_pull_pos);
     pio_tx_send(cd, qt->stuffed_data, qt->stuffed_words);
     return 0;
 }
@@ -791,7 +1075,7 @@ tx_check_local_message(struct can2040 *cd)
 {
     if (cd->tx_state != TS_QUEUED)
         return 0;
-    struct can2040_transmit *qt = &cd->tx_queue[tx_qpos(cd, cd->tx_pull_pos)];
+    struct can2040_transmit *qt = tx_entry(cd, cd->tx_pull_pos);
     struct can2040_msg *pm = &cd->parse_msg, *tm = &qt->msg;
     if (tm->id == pm->id) {
         if (qt->crc != cd->parse_crc || tm->dlc != pm->dlc
@@ -806,6 +1090,49 @@ tx_check_local_message(struct can2040 *cd)
 }
 
 
+/****************************************************************
+ * Mailboxes
+ ****************************************************************/
+
+// No message id has bit 29 set
+#define MAILBOX_ID_EMPTY 0xffffffff
+
+// Slot of an id in the mailbox table (a perfect hash of the ids)
+static inline uint32_t
+mailbox_slot(uint32_t id, uint32_t mult, uint32_t shift)
+{
+    return (id * mult) >> shift;
+}
+
+// Read and publish the table pointer (like readl/writel)
+static inline struct can2040_mailbox *
+mailbox_table(struct can2040 *cd)
+{
+    struct can2040_mailbox *boxes;
+    boxes = *(struct can2040_mailbox * volatile *)&cd->mailbox;
+    barrier();
+    return boxes;
+}
+static inline void
+mailbox_publish(struct can2040 *cd, struct can2040_mailbox *boxes)
+{
+    barrier();
+    *(struct can2040_mailbox * volatile *)&cd->mailbox = boxes;
+}
+
+// Find the mailbox of a message id - NULL if it has none
+static struct can2040_mailbox *
+mailbox_lookup(struct can2040 *cd, uint32_t id)
+{
+    struct can2040_mailbox *boxes = mailbox_table(cd);
+    if (!boxes)
+        return NULL;
+    struct can2040_mailbox *mb = &boxes[mailbox_slot(id, cd->mailbox_mult
+                                                     , cd->mailbox_shift)];
+    return mb->id == id ? mb : NULL;
+}
+
+
 /****************************************************************
  * Notification callbacks
  ****************************************************************/
@@ -819,20 +1146,67 @@ enum {
     RS_NEED_TX_EOF = RS_NEED_TX_ACK | RS_NEED_EOF_FLAG,
 };
 
+_Static_assert((CAN2040_RX_QUEUE_SIZE & (CAN2040_RX_QUEUE_SIZE - 1)) == 0
+               , "CAN2040_RX_QUEUE_SIZE must be a power of two");
+
 // Report error to calling code (via callback interface)
 static void
 report_callback_error(struct can2040 *cd, uint32_t error_code)
 {
     struct can2040_msg msg = {};
-    cd->rx_cb(cd, CAN2040_NOTIFY_ERROR | error_code, &msg);
+    if (cd->rx_cb)
+        cd->rx_cb(cd, CAN2040_NOTIFY_ERROR | error_code, &msg);
 }
 
-// Report a received message to calling code (via callback interface)
+// Add a received message to the receive queue (drained by can2040_rx_drain)
+static void
+report_queue_rx_msg(struct can2040 *cd)
+{
+    uint32_t rx_push_pos = cd->rx_push_pos;
+    if (rx_push_pos - readl(&cd->rx_pull_pos) >= ARRAY_SIZE(cd->rx_queue)) {
+        // Queue full - drop the new message
+        cd->stats.rx_overflow++;
+        return;
+    }
+    uint32_t qpos = rx_push_pos % ARRAY_SIZE(cd->rx_queue);
+    memcpy(&cd->rx_queue[qpos], &cd->parse_msg, sizeof(cd->parse_msg));
+    __DMB();
+    writel(&cd->rx_push_pos, rx_push_pos + 1);
+    uint32_t pending = rx_push_pos + 1 - cd->rx_pull_pos;
+    if (pending > cd->stats.rx_queue_max)
+        cd->stats.rx_queue_max = pending;
+}
+
+// Store a received message in its mailbox (if it has one)
+static void
+report_mailbox_rx_msg(struct can2040 *cd)
+{
+    struct can2040_mailbox *mb = mailbox_lookup(cd, cd->parse_msg.id);
+    if (!mb)
+        return;
+    uint32_t seq = mb->seq;
+    writel(&mb->seq, seq + 1);
+    __DMB();
+    memcpy(&mb->msg, &cd->parse_msg, sizeof(mb->msg));
+    __DMB();
+    writel(&mb->seq, seq + 2);
+}
+
+// Report a received message to calling code (via callback or rx queue)
 static void
 report_callback_rx_msg(struct can2040 *cd)
 {
+    if (cd->parse_filtered) {
+        // Rejected by the acceptance filter - only acked
+        cd->stats.rx_filtered++;
+        return;
+    }
     cd->stats.rx_total++;
-    cd->rx_cb(cd, CAN2040_NOTIFY_RX, &cd->parse_msg);
+    report_mailbox_rx_msg(cd);
+    if (cd->rx_queue_enabled)
+        report_queue_rx_msg(cd);
+    else if (cd->rx_cb)
+        cd->rx_cb(cd, CAN2040_NOTIFY_RX, &cd->parse_msg);
 }
 
 // Report a message that was successfully transmited (via callback interface)
@@ -841,7 +1215,8 @@ report_callback_tx_msg(struct can2040 *cd)
 {
     writel(&cd->tx_pull_pos, cd->tx_pull_pos + 1);
     cd->stats.tx_total++;
-    cd->rx_cb(cd, CAN2040_NOTIFY_TX, &cd->parse_msg);
+    if (cd->rx_cb)
+        cd->rx_cb(cd, CAN2040_NOTIFY_TX, &cd->parse_msg);
 }
 
 // EOF phase complete - report message (rx or tx) to calling code
@@ -872,6 +1247,15 @@ static void
 report_note_message_start(struct can2040 *cd)
 {
     pio_irq_set(cd, SI_MAYTX);
+
+    // Timestamp the start-of-frame - go back by the bits sampled since
+    // then: the first id bit, the rest of the current rx word and any
+    // words still waiting in the rx fifo (not the bits the PIO has not
+    // pushed yet, so the stamp may be up to one rx word late)
+    pio_hw_t *pio_hw = cd->pio_hw;
+    uint32_t fifo_words = (pio_hw->flevel >> PIO_FLEVEL_RX1_LSB) & 0x0f;
+    uint32_t bits = 2 + cd->unstuf.count_stuff + fifo_words * PIO_RX_WAKE_BITS;
+    cd->parse_msg.timestamp = timer_read_us() - bits * cd->bit_ns / 1000;
 }
 
 // Setup for ack injection (if receiving) or ack confirmation (if transmit)
@@ -998,6 +1382,35 @@ report_line_txpending(struct can2040 *cd)
 }
 
 
+/****************************************************************
+ * Acceptance filter
+ ****************************************************************/
+
+// Check if a received message id passes the acceptance filter
+static int
+rx_filter_accept(struct can2040 *cd, uint32_t id)
+{
+    if (!cd->filter_enabled)
+        return 1;
+    if (!(id & CAN2040_ID_EFF)) {
+        uint32_t std = id & 0x7ff;
+        if (cd->filter_std[std / 32] & (1u << (std % 32)))
+            return 1;
+    }
+    uint32_t i;
+    for (i=0; i<cd->filter_count; i++) {
+        struct can2040_filter *f = &cd->filters[i];
+        if ((id & f->mask) == f->value)
+            return 1;
+    }
+    // The feedback of our own transmit is still needed in full
+    if (cd->tx_state == TS_QUEUED
+        && tx_entry(cd, cd->tx_pull_pos)->msg.id == id)
+        return 1;
+    return 0;
+}
+
+
 /****************************************************************
  * Input state tracking
  ****************************************************************/
@@ -1029,6 +1442,7 @@ data_state_go_discard(struct can2040 *cd)
 {
     if (pio_rx_check_stall(cd)) {
         // CPU couldn't keep up for some read data - must reset pio state
+        cd->stats.rx_stall++;
         data_state_clear_bits(cd);
         pio_sm_setup(cd);
         report_callback_error(cd, 0);
@@ -1052,10 +1466,12 @@ data_state_go_error(struct can2040 *cd)
 static void
 data_state_line_error(struct can2040 *cd)
 {
-    if (cd->parse_state == MS_DISCARD)
+    if (cd->parse_state == MS_DISCARD) {
         data_state_go_discard(cd);
-    else
-        data_state_go_error(cd);
+        return;
+    }
+    cd->stats.line_error++;
+    data_state_go_error(cd);
 }
 
 // Received six unexpected passive bits on the line
@@ -1064,6 +1480,7 @@ data_state_line_passive(struct can2040 *cd)
 {
     if (cd->parse_state != MS_DISCARD && cd->parse_state != MS_START) {
         // Bitstuff error
+        cd->stats.stuff_error++;
         data_state_go_error(cd);
         return;
     }
@@ -1125,6 +1542,9 @@ data_state_go_data(struct can2040 *cd, uint32_t id, uint32_t data)
         id |= CAN2040_ID_RTR;
     }
     cd->parse_msg.id = id;
+    // A filtered message is still parsed (and acked), but its data is
+    // not stored and it is not reported
+    cd->parse_filtered = !rx_filter_accept(cd, id);
     if (dlc)
         data_state_go_next(cd, MS_DATA0, dlc >= 4 ? 32 : dlc * 8);
     else
@@ -1173,7 +1593,8 @@ data_state_update_data0(struct can2040 *cd, uint32_t data)
 {
     uint32_t dlc = cd->parse_msg.dlc, bits = dlc >= 4 ? 32 : dlc * 8;
     cd->parse_crc = crc_bytes(cd->parse_crc, data, dlc);
-    cd->parse_msg.data32[0] = __builtin_bswap32(data << (32 - bits));
+    if (!cd->parse_filtered)
+        cd->parse_msg.data32[0] = __builtin_bswap32(data << (32 - bits));
     if (dlc > 4)
         data_state_go_next(cd, MS_DATA1, dlc >= 8 ? 32 : (dlc - 4) * 8);
     else
@@ -1186,7 +1607,8 @@ data_state_update_data1(struct can2040 *cd, uint32_t data)
 {
     uint32_t dlc = cd->parse_msg.dlc, bits = dlc >= 8 ? 32 : (dlc - 4) * 8;
     cd->parse_crc = crc_bytes(cd->parse_crc, data, dlc - 4);
-    cd->parse_msg.data32[1] = __builtin_bswap32(data << (32 - bits));
+    if (!cd->parse_filtered)
+        cd->parse_msg.data32[1] = __builtin_bswap32(data << (32 - bits));
     data_state_go_crc(cd);
 }
 
@@ -1195,6 +1617,7 @@ static void
 data_state_update_crc(struct can2040 *cd, uint32_t data)
 {
     if (((cd->parse_crc << 1) | 1) != data) {
+        cd->stats.crc_error++;
         data_state_go_error(cd);
         return;
     }
@@ -1213,6 +1636,7 @@ data_state_update_ack(struct can2040 *cd, uint32_t data)
         // data_state_line_passive()
         unstuf_restore_state(&cd->unstuf, (cd->parse_crc_bits << 2) | data);
 
+        cd->stats.ack_error++;
         data_state_go_error(cd);
         return;
     }
@@ -1225,6 +1649,8 @@ static void
 data_state_update_eof0(struct can2040 *cd, uint32_t data)
 {
     if (data != 0x0f || pio_rx_check_stall(cd)) {
+        if (data != 0x0f)
+            cd->stats.form_error++;
         data_state_go_error(cd);
         return;
     }
@@ -1245,6 +1671,7 @@ data_state_update_eof1(struct can2040 *cd, uint32_t data)
         report_note_eof_success(cd);
         data_state_go_discard(cd);
     } else {
+        cd->stats.form_error++;
         data_state_go_error(cd);
     }
 }
@@ -1285,6 +1712,7 @@ process_rx(struct can2040 *cd, uint32_t rx_data)
 {
     unstuf_add_bits(&cd->unstuf, rx_data, PIO_RX_WAKE_BITS);
     cd->raw_bit_count += PIO_RX_WAKE_BITS;
+    cd->stats.rx_bits += PIO_RX_WAKE_BITS;
 
     // undo bit stuffing
     for (;;) {
@@ -1306,9 +1734,9 @@ process_rx(struct can2040 *cd, uint32_t rx_data)
     }
 }
 
-// Main API irq notification function
-void
-can2040_pio_irq_handler(struct can2040 *cd)
+// Handle pending pio interrupts
+static void
+do_pio_irq(struct can2040 *cd)
 {
     pio_hw_t *pio_hw = cd->pio_hw;
     uint32_t ints = pio_hw->ints0;
@@ -1334,6 +1762,30 @@ can2040_pio_irq_handler(struct can2040 *cd)
         report_line_txpending(cd);
 }
 
+// Note the duration of an irq handler call
+static void
+irq_note_cycles(struct can2040 *cd, uint32_t cycles)
+{
+    struct can2040_stats *stats = &cd->stats;
+    if (!stats->irq_count || cycles < stats->irq_cycles_min)
+        stats->irq_cycles_min = cycles;
+    if (cycles > stats->irq_cycles_max)
+        stats->irq_cycles_max = cycles;
+    stats->irq_cycles_total += cycles;
+    stats->irq_count++;
+}
+
+// Main API irq notification function
+void
+can2040_pio_irq_handler(struct can2040 *cd)
+{
+    TRACE_BEGIN(CAN_IRQ, cd->pio_hw->ints0);
+    uint32_t start = cycle_counter_read();
+    do_pio_irq(cd);
+    irq_note_cycles(cd, cycle_counter_elapsed(start, cycle_counter_read()));
+    TRACE_END(CAN_IRQ, 0);
+}
+
 
 /****************************************************************
  * Transmit queuing
@@ -1349,19 +1801,23 @@ can2040_check_transmit(struct can2040 *cd)
     return pending < ARRAY_SIZE(cd->tx_queue);
 }
 
-// API function to transmit a message
-int
-can2040_transmit(struct can2040 *cd, struct can2040_msg *msg)
+// Arbitration field in bus order (base id, rtr/srr, ide, extended id, rtr)
+static uint32_t
+tx_arbitration(uint32_t id)
 {
-    uint32_t tx_pull_pos = readl(&cd->tx_pull_pos);
-    uint32_t tx_push_pos = cd->tx_push_pos;
-    uint32_t pending = tx_push_pos - tx_pull_pos;
-    if (pending >= ARRAY_SIZE(cd->tx_queue))
-        // Tx queue full
-        return -1;
+    uint32_t rtr = !!(id & CAN2040_ID_RTR);
+    if (id & CAN2040_ID_EFF)
+        return (((id & 0x1ffc0000) << 3) | (0x03 << 19) | ((id & 0x3ffff) << 1)
+                | rtr);
+    return ((id & 0x7ff) << 21) | (rtr << 20);
+}
 
+// Fill a queue entry - header, crc and bit stuffing are done here, so
+// the irq handler only has to copy the stuffed words to the PIO
+static void
+tx_prepare(struct can2040_transmit *qt, struct can2040_msg *msg)
+{
     // Copy msg into transmit queue
-    struct can2040_transmit *qt = &cd->tx_queue[tx_qpos(cd, tx_push_pos)];
     uint32_t id = msg->id;
     if (id & CAN2040_ID_EFF)
         qt->msg.id = id & ~0x20000000;
@@ -1373,6 +1829,7 @@ can2040_transmit(struct can2040 *cd, struct can2040_msg *msg)
         data_len = 0;
     qt->msg.data32[0] = qt->msg.data32[1] = 0;
     memcpy(qt->msg.data, msg->data, data_len);
+    qt->arbitration = tx_arbitration(qt->msg.id);
 
     // Calculate crc and stuff bits
     uint32_t crc = 0;
@@ -1404,18 +1861,223 @@ can2040_transmit(struct can2040 *cd, struct can2040_msg *msg)
     bs_push(&bs, qt->crc, 15);
     bs_pushraw(&bs, 1, 1);
     qt->stuffed_words = bs_finalize(&bs);
+}
 
-    // Submit
-    writel(&cd->tx_push_pos, tx_push_pos + 1);
+// Publish prepared entries up to 'tx_push_pos' to the irq handler
+static void
+tx_submit(struct can2040 *cd, uint32_t tx_push_pos)
+{
+    writel(&cd->tx_push_pos, tx_push_pos);
+    // Only written here (irq handler leaves it alone)
+    uint32_t pending = tx_push_pos - readl(&cd->tx_pull_pos);
+    if (pending > cd->stats.tx_queue_max)
+        cd->stats.tx_queue_max = pending;
 
     // Wakeup if in TS_IDLE state
     __DMB();
     pio_signal_set_txpending(cd);
+}
+
+// API function to transmit a message
+int
+can2040_transmit(struct can2040 *cd, struct can2040_msg *msg)
+{
+    uint32_t tx_pull_pos = readl(&cd->tx_pull_pos);
+    uint32_t tx_push_pos = cd->tx_push_pos;
+    uint32_t pending = tx_push_pos - tx_pull_pos;
+    if (pending >= ARRAY_SIZE(cd->tx_queue))
+        // Tx queue full
+        return -1;
+
+    tx_prepare(tx_entry(cd, tx_push_pos), msg);
+    tx_submit(cd, tx_push_pos + 1);
+    return 0;
+}
+
+// API function to transmit several messages - queues as many as fit and
+// returns their count, the irq handler is woken up once for all of them
+int
+can2040_transmit_batch(struct can2040 *cd, struct can2040_msg *msgs
+                       , uint32_t count)
+{
+    uint32_t tx_pull_pos = readl(&cd->tx_pull_pos);
+    uint32_t tx_push_pos = cd->tx_push_pos;
+    uint32_t space = ARRAY_SIZE(cd->tx_queue) - (tx_push_pos - tx_pull_pos);
+    if (count > space)
+        count = space;
+    if (!count)
+        return 0;
+
+    uint32_t i;
+    for (i=0; i<count; i++)
+        tx_prepare(tx_entry(cd, tx_push_pos + i), &msgs[i]);
+    tx_submit(cd, tx_push_pos + count);
+    return count;
+}
+
+
+/****************************************************************
+ * Receive queue
+ ****************************************************************/
 
+// API function to deliver received messages through the rx queue
+// instead of the callback (tx and error notifications still use the
+// callback, which may then be NULL)
+void
+can2040_rx_queue_enable(struct can2040 *cd, uint32_t enable)
+{
+    writel(&cd->rx_queue_enabled, !!enable);
+}
+
+// API function to copy up to 'count' queued messages to 'msgs' -
+// returns the number copied (from thread context, one reader only)
+int
+can2040_rx_drain(struct can2040 *cd, struct can2040_msg *msgs
+                 , uint32_t count)
+{
+    uint32_t rx_pull_pos = cd->rx_pull_pos;
+    uint32_t pending = readl(&cd->rx_push_pos) - rx_pull_pos;
+    if (count > pending)
+        count = pending;
+    __DMB();
+    uint32_t i;
+    for (i=0; i<count; i++) {
+        uint32_t qpos = (rx_pull_pos + i) % ARRAY_SIZE(cd->rx_queue);
+        memcpy(&msgs[i], &cd->rx_queue[qpos], sizeof(msgs[i]));
+    }
+    __DMB();
+    writel(&cd->rx_pull_pos, rx_pull_pos + count);
+    return count;
+}
+
+
+/****************************************************************
+ * Acceptance filter setup
+ ****************************************************************/
+
+// The filter tables are read by the irq handler - change them before
+// can2040_start() (or accept that a message in flight may see a
+// partially updated filter).
+
+// API function to remove all filters - all messages are accepted again
+void
+can2040_filter_clear(struct can2040 *cd)
+{
+    writel(&cd->filter_enabled, 0);
+    __DMB();
+    cd->filter_count = 0;
+    memset(cd->filter_std, 0, sizeof(cd->filter_std));
+}
+
+// API function to accept a standard (11-bit) id, data and rtr messages
+void
+can2040_filter_add_std(struct can2040 *cd, uint32_t id)
+{
+    id &= 0x7ff;
+    cd->filter_std[id / 32] |= 1u << (id % 32);
+    __DMB();
+    writel(&cd->filter_enabled, 1);
+}
+
+// API function to accept messages with (msg->id & mask) == value - the
+// id includes the CAN2040_ID_EFF and CAN2040_ID_RTR flags, so a mask
+// with CAN2040_ID_EFF selects standard or extended ids.  Returns -1 if
+// all CAN2040_FILTER_MAX pairs are in use.
+int
+can2040_filter_add_mask(struct can2040 *cd, uint32_t mask, uint32_t value)
+{
+    uint32_t filter_count = cd->filter_count;
+    if (filter_count >= ARRAY_SIZE(cd->filters))
+        return -1;
+    cd->filters[filter_count].mask = mask;
+    cd->filters[filter_count].value = value & mask;
+    __DMB();
+    writel(&cd->filter_count, filter_count + 1);
+    writel(&cd->filter_enabled, 1);
     return 0;
 }
 
 
+/****************************************************************
+ * Mailbox setup
+ ****************************************************************/
+
+// Place every id in the table with the given multiplier - returns -1
+// on a collision
+static int
+mailbox_place(struct can2040_mailbox *boxes, uint32_t size, uint32_t mult
+              , uint32_t shift, const uint32_t *ids, uint32_t count)
+{
+    uint32_t i;
+    for (i=0; i<size; i++)
+        boxes[i].id = MAILBOX_ID_EMPTY;
+    for (i=0; i<count; i++) {
+        struct can2040_mailbox *mb = &boxes[mailbox_slot(ids[i], mult, shift)];
+        if (mb->id == ids[i])
+            continue;
+        if (mb->id != MAILBOX_ID_EMPTY)
+            return -1;
+        mb->id = ids[i];
+        mb->seq = 0;
+        memset(&mb->msg, 0, sizeof(mb->msg));
+    }
+    return 0;
+}
+
+// API function to keep the newest message of each of 'count' ids in
+// 'boxes' (in addition to the callback or rx queue), read with
+// can2040_mailbox_read().  'size' is a power of two - about four
+// slots per id let the search for a collision free hash succeed
+// quickly.  Call before can2040_start().  Returns -1 if no hash was
+// found (pass a larger table), NULL boxes disable the mailboxes.
+int
+can2040_mailbox_setup(struct can2040 *cd, struct can2040_mailbox *boxes
+                      , uint32_t size, const uint32_t *ids, uint32_t count)
+{
+    mailbox_publish(cd, NULL);
+    __DMB();
+    if (!boxes)
+        return 0;
+    if (size < 2 || (size & (size - 1)) || count > size)
+        return -1;
+    uint32_t shift = 32 - __builtin_ctz(size);
+    uint32_t mult = 0x9e3779b1, tries;
+    for (tries=0; tries<1024; tries++) {
+        if (mailbox_place(boxes, size, mult, shift, ids, count) == 0) {
+            cd->mailbox_mult = mult;
+            cd->mailbox_shift = shift;
+            __DMB();
+            mailbox_publish(cd, boxes);
+            return 0;
+        }
+        mult = (mult * 1664525 + 1013904223) | 1;
+    }
+    return -1;
+}
+
+// API function to copy the newest message of 'id' to 'msg' without
+// locking (retries while the irq handler updates it) - returns 1 if
+// copied, 0 if none was received yet, -1 if 'id' has no mailbox
+int
+can2040_mailbox_read(struct can2040 *cd, uint32_t id
+                     , struct can2040_msg *msg)
+{
+    struct can2040_mailbox *mb = mailbox_lookup(cd, id);
+    if (!mb)
+        return -1;
+    for (;;) {
+        uint32_t seq = readl(&mb->seq);
+        if (seq & 1)
+            continue;
+        __DMB();
+        memcpy(msg, &mb->msg, sizeof(*msg));
+        __DMB();
+        if (readl(&mb->seq) == seq)
+            return seq ? 1 : 0;
+    }
+}
+
+
 /****************************************************************
  * Setup
  ****************************************************************/
@@ -1424,6 +2086,9 @@ void
 can2040_setup(struct can2040 *cd, uint32_t pio_num)
 {
     memset(cd, 0, sizeof(*cd));
+    uint32_t i;
+    for (i=0; i<ARRAY_SIZE(cd->tx_order); i++)
+        cd->tx_order[i] = i;
     cd->pio_num = !!pio_num;
     cd->pio_hw = cd->pio_num ? pio1_hw : pio0_hw;
 #if IS_RP2350
@@ -1448,6 +2113,9 @@ can2040_start(struct can2040 *cd, uint32_t sys_clock, uint32_t bitrate
 {
     cd->gpio_rx = gpio_rx;
     cd->gpio_tx = gpio_tx;
+    cd->bitrate = bitrate;
+    cd->bit_ns = 1000000000 / bitrate;
+    cycle_counter_setup();
     data_state_clear_bits(cd);
     pio_setup(cd, sys_clock, bitrate);
     data_state_go_discard(cd);
@@ -1473,3 +2141,24 @@ can2040_get_statistics(struct can2040 *cd, struct can2040_stats *stats)
         // Raced with irq handler update - retry copy
     }
 }
+
+// API function to estimate the bus load in 1/10 percent - to be called
+// periodically with the time since the previous call, returns a
+// rolling average (3/4 of the previous estimate, 1/4 of this period).
+// Counts the bits the PIO sampled, which stops 10 recessive bits after a
+// message, so idle time is not counted.
+uint32_t
+can2040_bus_load(struct can2040 *cd, uint32_t elapsed_us)
+{
+    uint32_t rx_bits = readl(&cd->stats.rx_bits);
+    uint32_t bits = rx_bits - cd->load_bits;
+    cd->load_bits = rx_bits;
+    uint64_t capacity = (uint64_t)cd->bitrate * elapsed_us / 1000000;
+    if (!capacity)
+        return cd->bus_load;
+    uint64_t load = (uint64_t)bits * 1000 / capacity;
+    if (load > 1000)
+        load = 1000;
+    cd->bus_load = (cd->bus_load * 3 + (uint32_t)load) / 4;
+    return cd->bus_load;
+}
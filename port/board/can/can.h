@@ -3,6 +3,21 @@
 
 #include <stdint.h> // uint32_t
 
+// Depth of the transmit queue (a power of two, at most 256)
+#ifndef CAN2040_TX_QUEUE_SIZE
+#define CAN2040_TX_QUEUE_SIZE 16
+#endif
+
+// Depth of the receive queue (a power of two), see can2040_rx_queue_enable()
+#ifndef CAN2040_RX_QUEUE_SIZE
+#define CAN2040_RX_QUEUE_SIZE 32
+#endif
+
+// Mask/value pairs of the acceptance filter, see can2040_filter_add_mask()
+#ifndef CAN2040_FILTER_MAX
+#define CAN2040_FILTER_MAX 8
+#endif
+
 struct can2040_msg {
     uint32_t id;
     uint32_t dlc;
@@ -10,6 +25,7 @@ struct can2040_msg {
         uint8_t data[8];
         uint32_t data32[2];
     };
+    uint64_t timestamp; // us (timer) at start-of-frame, set on rx and tx
 };
 
 enum {
@@ -22,6 +38,13 @@ enum {
     CAN2040_NOTIFY_TX = 1<<21,
     CAN2040_NOTIFY_ERROR = 1<<23,
 };
+// Newest frame of one id, see can2040_mailbox_setup()
+struct can2040_mailbox {
+    uint32_t seq; // odd while the irq handler updates msg
+    uint32_t id;
+    struct can2040_msg msg;
+};
+
 struct can2040;
 typedef void (*can2040_rx_cb)(struct can2040 *cd, uint32_t notify
                               , struct can2040_msg *msg);
@@ -30,6 +53,18 @@ struct can2040_stats {
     uint32_t rx_total, tx_total;
     uint32_t tx_attempt;
     uint32_t parse_error;
+    uint32_t rx_overflow; // frames dropped because the receive queue was full
+    uint32_t rx_filtered; // frames rejected by the acceptance filter
+    // Parse errors by class (parse_error counts them all)
+    uint32_t stuff_error, crc_error, form_error, ack_error;
+    uint32_t line_error; // six dominant bits in a message (an error frame)
+    uint32_t rx_stall; // rx fifo overflowed - irq handler was held off
+    uint32_t rx_bits; // bits sampled from the line, see can2040_bus_load()
+    // Queue high-water marks
+    uint32_t tx_queue_max, rx_queue_max;
+    // Irq handler duration in cpu cycles (min is valid once irq_count > 0)
+    uint32_t irq_count, irq_cycles_min, irq_cycles_max;
+    uint64_t irq_cycles_total;
 };
 
 void can2040_setup(struct can2040 *cd, uint32_t pio_num);
@@ -38,9 +73,23 @@ void can2040_start(struct can2040 *cd, uint32_t sys_clock, uint32_t bitrate
                    , uint32_t gpio_rx, uint32_t gpio_tx);
 void can2040_stop(struct can2040 *cd);
 void can2040_get_statistics(struct can2040 *cd, struct can2040_stats *stats);
+uint32_t can2040_bus_load(struct can2040 *cd, uint32_t elapsed_us);
 void can2040_pio_irq_handler(struct can2040 *cd);
 int can2040_check_transmit(struct can2040 *cd);
 int can2040_transmit(struct can2040 *cd, struct can2040_msg *msg);
+int can2040_transmit_batch(struct can2040 *cd, struct can2040_msg *msgs
+                           , uint32_t count);
+void can2040_rx_queue_enable(struct can2040 *cd, uint32_t enable);
+int can2040_rx_drain(struct can2040 *cd, struct can2040_msg *msgs
+                     , uint32_t count);
+void can2040_filter_clear(struct can2040 *cd);
+void can2040_filter_add_std(struct can2040 *cd, uint32_t id);
+int can2040_filter_add_mask(struct can2040 *cd, uint32_t mask, uint32_t value);
+int can2040_mailbox_setup(struct can2040 *cd, struct can2040_mailbox *boxes
+                          , uint32_t size, const uint32_t *ids
+                          , uint32_t count);
+int can2040_mailbox_read(struct can2040 *cd, uint32_t id
+                         , struct can2040_msg *msg);
 
 
 /****************************************************************
@@ -55,6 +104,11 @@ struct can2040_bitunstuffer {
 struct can2040_transmit {
     struct can2040_msg msg;
     uint32_t crc, stuffed_words, stuffed_data[5];
+    uint32_t arbitration; // lower values win bus arbitration
+};
+
+struct can2040_filter {
+    uint32_t mask, value;
 };
 
 struct can2040 {
@@ -64,6 +118,8 @@ struct can2040 {
     uint32_t gpio_rx, gpio_tx;
     can2040_rx_cb rx_cb;
     struct can2040_stats stats;
+    uint32_t bitrate, bit_ns;
+    uint32_t load_bits, bus_load; // state of can2040_bus_load()
 
     // Bit unstuffing
     struct can2040_bitunstuffer unstuf;
@@ -73,6 +129,7 @@ struct can2040 {
     uint32_t parse_state;
     uint32_t parse_crc, parse_crc_bits, parse_crc_pos;
     struct can2040_msg parse_msg;
+    uint32_t parse_filtered;
 
     // Reporting
     uint32_t report_state;
@@ -80,7 +137,22 @@ struct can2040 {
     // Transmits
     uint32_t tx_state;
     uint32_t tx_pull_pos, tx_push_pos;
-    struct can2040_transmit tx_queue[4];
+    uint8_t tx_order[CAN2040_TX_QUEUE_SIZE];
+    struct can2040_transmit tx_queue[CAN2040_TX_QUEUE_SIZE];
+
+    // Receive queue
+    uint32_t rx_queue_enabled;
+    uint32_t rx_pull_pos, rx_push_pos;
+    struct can2040_msg rx_queue[CAN2040_RX_QUEUE_SIZE];
+
+    // Acceptance filter
+    uint32_t filter_enabled, filter_count;
+    struct can2040_filter filters[CAN2040_FILTER_MAX];
+    uint32_t filter_std[2048 / 32]; // bit per accepted 11-bit id
+
+    // Mailboxes (slot = id * mailbox_mult >> mailbox_shift)
+    struct can2040_mailbox *mailbox;
+    uint32_t mailbox_mult, mailbox_shift;
 };
 
 #endif // can.h
@@ -0,0 +1,252 @@
+/**
+ * can_bus.c
+ * Jannis Lämmle
+ * Several can2040 buses at once, see can_bus.h
+ *
+ * On the host only the planner and the load calculation are built, the benchmarks pass resource states.
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#endif
+
+#include "can_bus.h"
+#include "log.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+// wiznet_spi_pio.c only tries pio0 and pio1 (PIO_SPI_PREFERRED_PIO first)
+#define CAN_BUS_SPI_PIOS 2
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Blocks in the order the SPI driver tries them
+static const uint8_t g_spi_pios[CAN_BUS_SPI_PIOS] = {1, 0};
+
+#if PICO_ON_DEVICE
+static can_bus_t * g_buses;
+static uint32_t g_bus_count;
+static can_bus_t * g_pio_bus[CAN_BUS_PIO_MAX];    // bus per PIO block, for the irq handlers
+
+// Marks the whole instruction memory as used, can2040 writes its program itself
+static const uint16_t g_reserve_instructions[CAN_BUS_PIO_INSTRUCTIONS];
+static const pio_program_t g_reserve_program = {
+    .instructions = g_reserve_instructions,
+    .length = CAN_BUS_PIO_INSTRUCTIONS,
+    .origin = 0,
+};
+
+// Probes one instruction slot
+static const uint16_t g_probe_instruction[1];
+static const pio_program_t g_probe_program = {
+    .instructions = g_probe_instruction,
+    .length = 1,
+    .origin = -1,
+};
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static bool can_bus_pio_free(const can_bus_pio_state_t * pio)
+{
+    return pio->sm_claimed == 0 && pio->instr_used == 0;
+}
+
+// A free state machine and spi_length free slots in a row (the SPI program is relocatable)
+static bool can_bus_spi_fits(const can_bus_pio_state_t * pio, uint32_t spi_length)
+{
+    uint32_t run = 0;
+
+    if(pio->sm_claimed == (1u << CAN_BUS_PIO_SMS) - 1) return false;
+    for(uint32_t i = 0; i < CAN_BUS_PIO_INSTRUCTIONS; i++)
+    {
+        run = pio->instr_used & (1u << i) ? 0 : run + 1;
+        if(run >= spi_length) return true;
+    }
+    return false;
+}
+
+#if PICO_ON_DEVICE
+static void can_bus_irq(uint32_t pio)
+{
+    can_bus_t * bus = g_pio_bus[pio];
+    if(bus) can2040_pio_irq_handler(&bus->cd);
+}
+
+static void can_bus_irq_pio0(void)
+{
+    can_bus_irq(0);
+}
+
+static void can_bus_irq_pio1(void)
+{
+    can_bus_irq(1);
+}
+
+#if NUM_PIOS > 2
+static void can_bus_irq_pio2(void)
+{
+    can_bus_irq(2);
+}
+#endif
+
+static void can_bus_pio_state(PIO pio, can_bus_pio_state_t * state)
+{
+    state->sm_claimed = 0;
+    state->instr_used = 0;
+    for(uint sm = 0; sm < CAN_BUS_PIO_SMS; sm++)
+    {
+        if(pio_sm_is_claimed(pio, sm)) state->sm_claimed |= 1u << sm;
+    }
+    for(uint offset = 0; offset < CAN_BUS_PIO_INSTRUCTIONS; offset++)
+    {
+        if(!pio_can_add_program_at_offset(pio, &g_probe_program, offset)) state->instr_used |= 1u << offset;
+    }
+}
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+int can_bus_plan(const can_bus_pio_state_t * pios, uint32_t pio_count, uint32_t dma_free, uint32_t bus_count,
+                 uint32_t spi_length, uint8_t * bus_pio)
+{
+    int spi_pio = -1;
+    uint32_t free_count = 0;
+
+    for(uint32_t p = 0; p < pio_count; p++) free_count += can_bus_pio_free(&pios[p]);
+    if(free_count < bus_count) return CAN_BUS_NO_PIO;
+
+    if(spi_length)
+    {
+        if(dma_free == 0) return CAN_BUS_SPI_NO_DMA;
+
+        // Next to resources in use first, so a free block stays free for a bus, then the SPI driver's order
+        for(uint32_t i = 0; i < CAN_BUS_SPI_PIOS && spi_pio < 0; i++)
+        {
+            uint32_t p = g_spi_pios[i];
+            if(p < pio_count && !can_bus_pio_free(&pios[p]) && can_bus_spi_fits(&pios[p], spi_length)) spi_pio = p;
+        }
+        for(uint32_t i = 0; i < CAN_BUS_SPI_PIOS && spi_pio < 0; i++)
+        {
+            uint32_t p = g_spi_pios[i];
+            if(p < pio_count && can_bus_pio_free(&pios[p]) && free_count > bus_count) spi_pio = p;
+        }
+        if(spi_pio < 0) return CAN_BUS_SPI_NO_PIO;
+    }
+
+    uint32_t bus = 0;
+    for(uint32_t p = 0; p < pio_count && bus < bus_count; p++)
+    {
+        if(can_bus_pio_free(&pios[p]) && (int)p != spi_pio) bus_pio[bus++] = p;
+    }
+    return CAN_BUS_OK;
+}
+
+uint32_t can_bus_irq_load(can_bus_t * bus, uint32_t sys_clock, uint64_t now_us)
+{
+    struct can2040_stats stats;
+
+    can2040_get_statistics(&bus->cd, &stats);
+    uint64_t cycles = stats.irq_cycles_total - bus->load_cycles;
+    uint64_t available = (now_us - bus->load_us) * (sys_clock / 1000000);
+    bus->load_cycles = stats.irq_cycles_total;
+    bus->load_us = now_us;
+
+    return available ? (uint32_t)(cycles * 1000 / available) : 0;
+}
+
+#if PICO_ON_DEVICE
+int can_bus_setup(can_bus_t * buses, const can_bus_config_t * configs, uint32_t count, uint32_t spi_length)
+{
+    static void (* const handlers[])(void) = {
+        can_bus_irq_pio0,
+        can_bus_irq_pio1,
+#if NUM_PIOS > 2
+        can_bus_irq_pio2,
+#endif
+    };
+    can_bus_pio_state_t pios[CAN_BUS_PIO_MAX];
+    uint8_t bus_pio[CAN_BUS_MAX];
+    uint32_t dma_free = 0;
+
+    if(count > CAN_BUS_MAX) return CAN_BUS_NO_PIO;
+    for(uint32_t p = 0; p < NUM_PIOS; p++) can_bus_pio_state(pio_get_instance(p), &pios[p]);
+    for(uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) dma_free += !dma_channel_is_claimed(ch);
+
+    int ret = can_bus_plan(pios, NUM_PIOS, dma_free, count, spi_length, bus_pio);
+    if(ret != CAN_BUS_OK) return ret;
+
+    g_buses = buses;
+    g_bus_count = count;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        can_bus_t * bus = &buses[i];
+        PIO pio = pio_get_instance(bus_pio[i]);
+
+        // Taken from the sdk allocator, the SPI driver looks for room elsewhere then
+        pio_claim_sm_mask(pio, (1u << CAN_BUS_PIO_SMS) - 1);
+        pio_add_program_at_offset(pio, &g_reserve_program, 0);
+
+        bus->config = configs[i];
+        bus->pio = bus_pio[i];
+        bus->irq = pio_get_irq_num(pio, 0);
+        can2040_setup(&bus->cd, bus->pio);
+        can2040_callback_config(&bus->cd, bus->config.rx_cb);
+        g_pio_bus[bus->pio] = bus;
+        irq_set_exclusive_handler(bus->irq, handlers[bus->pio]);
+        irq_set_priority(bus->irq, PICO_HIGHEST_IRQ_PRIORITY);
+    }
+    return CAN_BUS_OK;
+}
+
+void can_bus_start(void)
+{
+    uint32_t sys_clock = clock_get_hz(clk_sys);
+
+    for(uint32_t i = 0; i < g_bus_count; i++)
+    {
+        can_bus_t * bus = &g_buses[i];
+
+        irq_set_enabled(bus->irq, true);
+        can2040_start(&bus->cd, sys_clock, bus->config.bitrate, bus->config.gpio_rx, bus->config.gpio_tx);
+        bus->load_cycles = 0;
+        bus->load_us = time_us_64();
+    }
+}
+
+void can_bus_report(void)
+{
+    uint32_t sys_clock = clock_get_hz(clk_sys);
+    uint64_t now = time_us_64();
+
+    for(uint32_t i = 0; i < g_bus_count; i++)
+    {
+        can_bus_t * bus = &g_buses[i];
+        uint32_t elapsed = (uint32_t)(now - bus->load_us);
+        struct can2040_stats stats;
+
+        uint32_t irq_load = can_bus_irq_load(bus, sys_clock, now);
+        can2040_get_statistics(&bus->cd, &stats);
+        LOG(CAN_BUS_LOAD, i, bus->pio, can2040_bus_load(&bus->cd, elapsed), irq_load, stats.irq_cycles_max);
+        LOG(CAN_BUS_ERRORS, i, stats.rx_total, stats.tx_total, stats.parse_error, stats.rx_stall);
+    }
+}
+#endif
@@ -0,0 +1,86 @@
+/**
+ * can_bus.h
+ * Jannis Lämmle
+ * Several can2040 buses at once (e.g. inverter and battery), each on a PIO block of its own with its own
+ * interrupt
+ *
+ * can2040 takes all four state machines and the whole instruction memory of a PIO block, the RP2040 has two
+ * blocks, the RP2350 three. The W55RP20 boards run the W5500 SPI on a PIO as well (one state machine, the
+ * wiznet_spi_write_read program and a DMA channel). can_bus_setup() reads which state machines, instruction
+ * slots and DMA channels are taken, plans a PIO for each bus, leaving room for the SPI program if it still
+ * has to be loaded, and reserves the planned blocks, so the SPI driver picks another one.
+ */
+
+#ifndef CAN_BUS_H_
+#define CAN_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define CAN_BUS_MAX 3
+#define CAN_BUS_PIO_MAX 3
+#define CAN_BUS_PIO_SMS 4
+#define CAN_BUS_PIO_INSTRUCTIONS 32
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum can_bus_error {
+    CAN_BUS_OK = 0,
+    CAN_BUS_NO_PIO = -1,        // fewer free PIO blocks than buses
+    CAN_BUS_SPI_NO_PIO = -2,    // the buses would leave no room for the SPI program
+    CAN_BUS_SPI_NO_DMA = -3,    // no DMA channel left for the SPI program
+} can_bus_error_t;
+
+// Resources of a PIO block that are already taken
+typedef struct can_bus_pio_state {
+    uint8_t sm_claimed;         // bit per state machine
+    uint32_t instr_used;        // bit per instruction slot
+} can_bus_pio_state_t;
+
+typedef struct can_bus_config {
+    uint32_t gpio_rx;
+    uint32_t gpio_tx;
+    uint32_t bitrate;
+    can2040_rx_cb rx_cb;        // NULL if frames are taken from the rx queue or mailboxes
+} can_bus_config_t;
+
+typedef struct can_bus {
+    struct can2040 cd;
+    can_bus_config_t config;
+    uint32_t pio;
+    uint32_t irq;
+    // State of can_bus_irq_load()
+    uint64_t load_cycles;
+    uint64_t load_us;
+} can_bus_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+// PIO block per bus from the taken resources, spi_length the length of the SPI program that still has to
+// be loaded (0 if none), or a can_bus_error_t
+int can_bus_plan(const can_bus_pio_state_t * pios, uint32_t pio_count, uint32_t dma_free, uint32_t bus_count,
+                 uint32_t spi_length, uint8_t * bus_pio);
+
+// Plans and reserves the PIO blocks and sets up the buses (call can2040_filter_*() and can2040_mailbox_setup() on bus->cd after
+// can_bus_setup() and before can_bus_start()), returns a can_bus_error_t
+int can_bus_setup(can_bus_t * buses, const can_bus_config_t * configs, uint32_t count, uint32_t spi_length);
+void can_bus_start(void);
+
+// Share of the cpu cycles spent in the irq handler of the bus since the last call, in per mille
+uint32_t can_bus_irq_load(can_bus_t * bus, uint32_t sys_clock, uint64_t now_us);
+void can_bus_report(void);  // Irq and bus load of every bus to the log
+
+#endif /* CAN_BUS_H_ */
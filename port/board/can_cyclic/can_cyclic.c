@@ -0,0 +1,220 @@
+/**
+ * can_cyclic.c
+ * Jannis Lämmle
+ * Cyclic CAN transmit table, see can_cyclic.h
+ *
+ * On the host only can_cyclic_run() drives the table, the benchmarks pass a simulated time.
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#endif
+
+#include "can_cyclic.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static struct can2040 * g_cd;
+static can_cyclic_entry_t * g_entries[CAN_CYCLIC_MAX_ENTRIES];
+static uint32_t g_entry_count;
+static can_cyclic_stats_t g_stats;
+static struct can2040_msg g_pending[CAN_CYCLIC_PENDING];
+static volatile uint32_t g_pending_push, g_pending_pull;
+static volatile bool g_running;
+static volatile bool g_armed;     // a release is due, so the alarm handler runs again
+#if PICO_ON_DEVICE
+static int g_alarm = -1;
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static uint32_t can_cyclic_irq_disable(void)
+{
+#if PICO_ON_DEVICE
+    return save_and_disable_interrupts();
+#else
+    return 0;
+#endif
+}
+
+static void can_cyclic_irq_restore(uint32_t status)
+{
+#if PICO_ON_DEVICE
+    restore_interrupts(status);
+#else
+    (void)status;
+#endif
+}
+
+static void can_cyclic_release(can_cyclic_entry_t * entry, uint32_t jitter_us)
+{
+    if(entry->update && !entry->update(entry, &entry->msg)) return;
+
+    if(can2040_transmit(g_cd, &entry->msg) < 0)
+    {
+        g_stats.queue_full++;
+        return;
+    }
+
+    entry->released++;
+    if(jitter_us > entry->jitter_us_max) entry->jitter_us_max = jitter_us;
+    g_stats.released++;
+    g_stats.jitter_us_total += jitter_us;
+    if(jitter_us > g_stats.jitter_us_max) g_stats.jitter_us_max = jitter_us;
+}
+
+// Frames of can_cyclic_transmit(), only called where no release can run at the same time
+static void can_cyclic_forward(void)
+{
+    while(g_pending_pull != g_pending_push)
+    {
+        if(can2040_transmit(g_cd, &g_pending[g_pending_pull % CAN_CYCLIC_PENDING]) < 0) g_stats.queue_full++;
+        else g_stats.forwarded++;
+        g_pending_pull++;
+    }
+}
+
+#if PICO_ON_DEVICE
+// A target that has already passed does not fire, the table runs again right away then
+static void can_cyclic_alarm(uint alarm_num)
+{
+    uint64_t next;
+
+    do
+    {
+        next = can_cyclic_run(time_us_64());
+    } while(next != UINT64_MAX && hardware_alarm_set_target(alarm_num, from_us_since_boot(next)));
+}
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void can_cyclic_init(struct can2040 * cd)
+{
+    can_cyclic_stop();
+    g_cd = cd;
+    g_entry_count = 0;
+    g_pending_push = g_pending_pull = 0;
+    can_cyclic_reset_stats();
+}
+
+int can_cyclic_add(can_cyclic_entry_t * entry)
+{
+    if(g_entry_count >= CAN_CYCLIC_MAX_ENTRIES || entry->period_us == 0) return -1;
+
+    entry->released = 0;
+    entry->missed = 0;
+    entry->jitter_us_max = 0;
+    g_entries[g_entry_count++] = entry;
+    return 0;
+}
+
+void can_cyclic_start(uint64_t now_us)
+{
+    for(uint32_t i = 0; i < g_entry_count; i++) g_entries[i]->due_us = now_us + g_entries[i]->phase_us;
+    g_running = true;
+
+#if PICO_ON_DEVICE
+    if(g_alarm < 0)
+    {
+        g_alarm = hardware_alarm_claim_unused(true);
+        hardware_alarm_set_callback((uint)g_alarm, can_cyclic_alarm);
+    }
+    can_cyclic_alarm((uint)g_alarm);
+#endif
+}
+
+// The alarm first, can_cyclic_transmit() forwards frames itself once g_running is cleared
+void can_cyclic_stop(void)
+{
+#if PICO_ON_DEVICE
+    if(g_alarm >= 0)
+    {
+        hardware_alarm_cancel((uint)g_alarm);
+        hardware_alarm_set_callback((uint)g_alarm, NULL);
+        hardware_alarm_unclaim((uint)g_alarm);
+        g_alarm = -1;
+    }
+#endif
+    g_running = false;
+    g_armed = false;
+}
+
+uint64_t can_cyclic_run(uint64_t now_us)
+{
+    uint64_t next = UINT64_MAX;
+
+    can_cyclic_forward();
+    for(uint32_t i = 0; i < g_entry_count; i++)
+    {
+        can_cyclic_entry_t * entry = g_entries[i];
+
+        if(now_us >= entry->due_us)
+        {
+            uint64_t late = now_us - entry->due_us;
+
+            // Only the newest period is sent, the ones before it are missed
+            if(late >= entry->period_us)
+            {
+                uint32_t skipped = late / entry->period_us;
+                entry->missed += skipped;
+                g_stats.missed += skipped;
+                entry->due_us += (uint64_t)skipped * entry->period_us;
+                late -= (uint64_t)skipped * entry->period_us;
+            }
+            can_cyclic_release(entry, (uint32_t)late);
+            entry->due_us += entry->period_us;
+        }
+        if(entry->due_us < next) next = entry->due_us;
+    }
+    g_armed = next != UINT64_MAX;
+    return next;
+}
+
+int can_cyclic_transmit(const struct can2040_msg * msg)
+{
+    uint32_t irq = can_cyclic_irq_disable();
+    if(g_pending_push - g_pending_pull >= CAN_CYCLIC_PENDING)
+    {
+        can_cyclic_irq_restore(irq);
+        return -1;
+    }
+    g_pending[g_pending_push % CAN_CYCLIC_PENDING] = *msg;
+    g_pending_push++;
+    can_cyclic_irq_restore(irq);
+
+    // Without a release due no alarm is pending, the sdk ignores a forced irq then. On the host the next
+    // can_cyclic_run() forwards it.
+    if(!g_running || !g_armed) can_cyclic_forward();
+#if PICO_ON_DEVICE
+    else hardware_alarm_force_irq((uint)g_alarm);
+#endif
+    return 0;
+}
+
+void can_cyclic_get_stats(can_cyclic_stats_t * stats)
+{
+    uint32_t irq = can_cyclic_irq_disable();
+    *stats = g_stats;
+    can_cyclic_irq_restore(irq);
+}
+
+void can_cyclic_reset_stats(void)
+{
+    uint32_t irq = can_cyclic_irq_disable();
+    memset(&g_stats, 0, sizeof(g_stats));
+    can_cyclic_irq_restore(irq);
+}
@@ -0,0 +1,86 @@
+/**
+ * can_cyclic.h
+ * Jannis Lämmle
+ * Cyclic CAN transmit table: frames released into the can2040 transmit queue at fixed periods, e.g. an emulated
+ * sensor towards the heating system or heartbeats
+ *
+ * Each entry has a period and a phase (its first release after can_cyclic_start()) and an optional callback
+ * that updates the payload right before the release. A hardware alarm is armed for the next release, so
+ * the release jitter is the interrupt latency plus the time spent on entries due at the same time. The
+ * release jitter (time after the due time) and missed deadlines (periods that were due before the frame of
+ * the previous period was released) are counted per entry and in total.
+ *
+ * The alarm handler calls can2040_transmit(), so further frames of the same can2040 instance have to go
+ * through can_cyclic_transmit() while the table runs. It only copies the frame into a small queue with
+ * interrupts disabled and forces the alarm, the handler passes it on to can2040_transmit() (crc and bit
+ * stuffing) with interrupts enabled, so the PIO interrupt of can2040 is not held off. While no release is
+ * due (empty table) no alarm is armed, can_cyclic_transmit() passes the frame on itself then.
+ */
+
+#ifndef CAN_CYCLIC_H_
+#define CAN_CYCLIC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define CAN_CYCLIC_MAX_ENTRIES 16
+#define CAN_CYCLIC_PENDING 4        // frames of can_cyclic_transmit() waiting for the alarm handler
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+struct can_cyclic_entry;
+
+// Updates msg for this release, returns false to leave this period out
+typedef bool (* can_cyclic_update_cb_t)(struct can_cyclic_entry * entry, struct can2040_msg * msg);
+
+typedef struct can_cyclic_entry {
+    // Configuration
+    struct can2040_msg msg;
+    uint32_t period_us;
+    uint32_t phase_us;
+    can_cyclic_update_cb_t update;  // NULL to send msg unchanged
+    void * user;
+
+    // State and statistics
+    uint64_t due_us;
+    uint32_t released;
+    uint32_t missed;
+    uint32_t jitter_us_max;
+} can_cyclic_entry_t;
+
+typedef struct can_cyclic_stats {
+    uint32_t released;          // frames queued
+    uint32_t missed;            // periods skipped because the release was a period or more late
+    uint32_t queue_full;        // releases and forwarded frames the transmit queue had no room for
+    uint32_t forwarded;         // frames of can_cyclic_transmit() queued
+    uint32_t jitter_us_max;
+    uint64_t jitter_us_total;   // over the released frames
+} can_cyclic_stats_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void can_cyclic_init(struct can2040 * cd);
+int can_cyclic_add(can_cyclic_entry_t * entry); // Before can_cyclic_start(), returns -1 if the table is full
+void can_cyclic_start(uint64_t now_us);         // Phases count from now_us (time_us_64())
+void can_cyclic_stop(void);
+uint64_t can_cyclic_run(uint64_t now_us);       // Forwards pending frames, releases the due entries, returns the next due time (alarm handler)
+// can2040_transmit() from thread context, the frame is sent by the alarm handler while a release is due.
+// Returns -1 if CAN_CYCLIC_PENDING frames are still waiting.
+int can_cyclic_transmit(const struct can2040_msg * msg);
+void can_cyclic_get_stats(can_cyclic_stats_t * stats);
+void can_cyclic_reset_stats(void);
+
+#endif /* CAN_CYCLIC_H_ */
@@ -0,0 +1,337 @@
+/**
+ * isotp.c
+ * Jannis Lämmle
+ * ISO-TP (ISO 15765-2) transport over 8 byte CAN frames, see isotp.h
+ */
+
+#include <string.h>
+
+#include "isotp.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Protocol control information, upper nibble of the first byte */
+#define ISOTP_PCI_SINGLE 0x00
+#define ISOTP_PCI_FIRST 0x10
+#define ISOTP_PCI_CONSECUTIVE 0x20
+#define ISOTP_PCI_FLOW 0x30
+
+/* Flow status of a flow control frame */
+#define ISOTP_FLOW_CTS 0
+#define ISOTP_FLOW_WAIT 1
+#define ISOTP_FLOW_OVERFLOW 2
+#define ISOTP_FLOW_NONE 0xff
+
+#define ISOTP_SINGLE_MAX 7
+#define ISOTP_FIRST_DATA 6
+#define ISOTP_CONSECUTIVE_DATA 7
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+enum {
+    ISOTP_TX_IDLE,
+    ISOTP_TX_FIRST,             // single or first frame waits for the bus
+    ISOTP_TX_WAIT_FLOW,
+    ISOTP_TX_CONSECUTIVE,
+};
+
+enum {
+    ISOTP_RX_IDLE,
+    ISOTP_RX_CONSECUTIVE,
+};
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Helpers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void isotp_event(isotp_session_t * session, isotp_event_t event, uint32_t len)
+{
+    if(session->config.event_cb) session->config.event_cb(session, event, len);
+}
+
+static int isotp_send_frame(isotp_session_t * session, const uint8_t * data, uint32_t len)
+{
+    struct can2040_msg msg;
+
+    msg.id = session->config.tx_id;
+    msg.dlc = session->config.padding ? 8 : len;
+    memset(msg.data, session->config.padding ? ISOTP_PADDING : 0, sizeof(msg.data));
+    memcpy(msg.data, data, len);
+    return session->tp->send(session->tp->send_ctx, &msg);
+}
+
+static int isotp_send_flow(isotp_session_t * session, uint8_t status)
+{
+    uint8_t frame[3] = {ISOTP_PCI_FLOW | status, session->config.block_size, session->config.st_min};
+    int ret = isotp_send_frame(session, frame, sizeof(frame));
+
+    session->rx_fc_pending = ret < 0 ? status : ISOTP_FLOW_NONE;
+    return ret;
+}
+
+// STmin as sent in a flow control frame, reserved values mean the maximum of 127 ms
+static uint32_t isotp_st_min_us(uint8_t st_min)
+{
+    if(st_min <= 0x7F) return st_min * 1000u;
+    if(st_min >= 0xF1 && st_min <= 0xF9) return (st_min - 0xF0) * 100u;
+    return 127000u;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Sending
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Sends what is due, until the bus is full or the block or the separation time ends
+static void isotp_tx_step(isotp_session_t * session, uint64_t now_us)
+{
+    uint8_t frame[8];
+
+    if(session->tx_state == ISOTP_TX_FIRST)
+    {
+        if(session->tx_len <= ISOTP_SINGLE_MAX)
+        {
+            frame[0] = ISOTP_PCI_SINGLE | session->tx_len;
+            memcpy(&frame[1], session->tx_data, session->tx_len);
+            if(isotp_send_frame(session, frame, 1 + session->tx_len) < 0) return;
+
+            session->tx_state = ISOTP_TX_IDLE;
+            isotp_event(session, ISOTP_EVENT_TX_DONE, session->tx_len);
+            return;
+        }
+
+        frame[0] = ISOTP_PCI_FIRST | (session->tx_len >> 8);
+        frame[1] = session->tx_len & 0xff;
+        memcpy(&frame[2], session->tx_data, ISOTP_FIRST_DATA);
+        if(isotp_send_frame(session, frame, 8) < 0) return;
+
+        session->tx_offset = ISOTP_FIRST_DATA;
+        session->tx_sn = 1;
+        session->tx_state = ISOTP_TX_WAIT_FLOW;
+        session->tx_deadline_us = now_us + ISOTP_TIMEOUT_US;
+        return;
+    }
+
+    if(session->tx_state == ISOTP_TX_WAIT_FLOW)
+    {
+        if(now_us < session->tx_deadline_us) return;
+
+        session->tx_state = ISOTP_TX_IDLE;
+        isotp_event(session, ISOTP_EVENT_TX_TIMEOUT, session->tx_offset);
+        return;
+    }
+
+    while(session->tx_state == ISOTP_TX_CONSECUTIVE && now_us >= session->tx_next_us)
+    {
+        uint32_t len = session->tx_len - session->tx_offset;
+        if(len > ISOTP_CONSECUTIVE_DATA) len = ISOTP_CONSECUTIVE_DATA;
+
+        frame[0] = ISOTP_PCI_CONSECUTIVE | session->tx_sn;
+        memcpy(&frame[1], session->tx_data + session->tx_offset, len);
+        if(isotp_send_frame(session, frame, 1 + len) < 0) return;
+
+        session->tx_offset += len;
+        session->tx_sn = (session->tx_sn + 1) & 0x0f;
+        if(session->tx_offset >= session->tx_len)
+        {
+            session->tx_state = ISOTP_TX_IDLE;
+            isotp_event(session, ISOTP_EVENT_TX_DONE, session->tx_len);
+            return;
+        }
+        if(session->tx_block_size && --session->tx_block_left == 0)
+        {
+            session->tx_state = ISOTP_TX_WAIT_FLOW;
+            session->tx_deadline_us = now_us + ISOTP_TIMEOUT_US;
+            return;
+        }
+        // Without a separation time, as many as the bus takes
+        if(session->tx_st_min_us) session->tx_next_us = now_us + session->tx_st_min_us;
+    }
+}
+
+static void isotp_rx_flow(isotp_session_t * session, const struct can2040_msg * msg, uint64_t now_us)
+{
+    if(session->tx_state != ISOTP_TX_WAIT_FLOW || msg->dlc < 3) return;
+
+    switch(msg->data[0] & 0x0f)
+    {
+        case ISOTP_FLOW_CTS:
+            session->tx_block_size = msg->data[1];
+            session->tx_block_left = msg->data[1];
+            session->tx_st_min_us = isotp_st_min_us(msg->data[2]);
+            session->tx_next_us = now_us;
+            session->tx_state = ISOTP_TX_CONSECUTIVE;
+            isotp_tx_step(session, now_us);
+            break;
+
+        case ISOTP_FLOW_WAIT:
+            session->tx_deadline_us = now_us + ISOTP_TIMEOUT_US;
+            break;
+
+        default:
+            session->tx_state = ISOTP_TX_IDLE;
+            isotp_event(session, ISOTP_EVENT_TX_OVERFLOW, session->tx_len);
+            break;
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Receiving
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void isotp_rx_abort(isotp_session_t * session, isotp_event_t event)
+{
+    session->rx_state = ISOTP_RX_IDLE;
+    session->rx_fc_pending = ISOTP_FLOW_NONE;
+    isotp_event(session, event, session->rx_offset);
+}
+
+static void isotp_rx_single(isotp_session_t * session, const struct can2040_msg * msg)
+{
+    uint32_t len = msg->data[0] & 0x0f;
+
+    if(len == 0 || len > ISOTP_SINGLE_MAX || len + 1 > msg->dlc) return;
+    // A new message ends one in progress
+    if(session->rx_state != ISOTP_RX_IDLE) isotp_rx_abort(session, ISOTP_EVENT_RX_SEQUENCE);
+    if(len > session->config.rx_size)
+    {
+        isotp_event(session, ISOTP_EVENT_RX_OVERFLOW, len);
+        return;
+    }
+
+    memcpy(session->config.rx_buffer, &msg->data[1], len);
+    isotp_event(session, ISOTP_EVENT_RX_DONE, len);
+}
+
+static void isotp_rx_first(isotp_session_t * session, const struct can2040_msg * msg, uint64_t now_us)
+{
+    uint32_t len = ((msg->data[0] & 0x0f) << 8) | msg->data[1];
+
+    if(len <= ISOTP_SINGLE_MAX || msg->dlc < 8) return;
+    if(session->rx_state != ISOTP_RX_IDLE) isotp_rx_abort(session, ISOTP_EVENT_RX_SEQUENCE);
+    if(len > session->config.rx_size)
+    {
+        isotp_send_flow(session, ISOTP_FLOW_OVERFLOW);
+        isotp_event(session, ISOTP_EVENT_RX_OVERFLOW, len);
+        return;
+    }
+
+    memcpy(session->config.rx_buffer, &msg->data[2], ISOTP_FIRST_DATA);
+    session->rx_len = len;
+    session->rx_offset = ISOTP_FIRST_DATA;
+    session->rx_sn = 1;
+    session->rx_block_left = session->config.block_size;
+    session->rx_deadline_us = now_us + ISOTP_TIMEOUT_US;
+    session->rx_state = ISOTP_RX_CONSECUTIVE;
+    isotp_send_flow(session, ISOTP_FLOW_CTS);
+}
+
+static void isotp_rx_consecutive(isotp_session_t * session, const struct can2040_msg * msg, uint64_t now_us)
+{
+    if(session->rx_state != ISOTP_RX_CONSECUTIVE) return;
+    if((msg->data[0] & 0x0f) != session->rx_sn)
+    {
+        isotp_rx_abort(session, ISOTP_EVENT_RX_SEQUENCE);
+        return;
+    }
+
+    uint32_t len = session->rx_len - session->rx_offset;
+    if(len > ISOTP_CONSECUTIVE_DATA) len = ISOTP_CONSECUTIVE_DATA;
+    if(len + 1 > msg->dlc) return;
+
+    memcpy(session->config.rx_buffer + session->rx_offset, &msg->data[1], len);
+    session->rx_offset += len;
+    session->rx_sn = (session->rx_sn + 1) & 0x0f;
+    session->rx_deadline_us = now_us + ISOTP_TIMEOUT_US;
+    if(session->rx_offset >= session->rx_len)
+    {
+        session->rx_state = ISOTP_RX_IDLE;
+        isotp_event(session, ISOTP_EVENT_RX_DONE, session->rx_len);
+        return;
+    }
+    if(session->config.block_size && --session->rx_block_left == 0)
+    {
+        session->rx_block_left = session->config.block_size;
+        isotp_send_flow(session, ISOTP_FLOW_CTS);
+    }
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void isotp_init(isotp_t * tp, isotp_send_t send, void * send_ctx)
+{
+    memset(tp, 0, sizeof(*tp));
+    tp->send = send;
+    tp->send_ctx = send_ctx;
+}
+
+int isotp_add_session(isotp_t * tp, isotp_session_t * session, const isotp_session_config_t * config)
+{
+    if(tp->session_count >= ISOTP_MAX_SESSIONS) return -1;
+
+    memset(session, 0, sizeof(*session));
+    session->config = *config;
+    session->tp = tp;
+    session->rx_fc_pending = ISOTP_FLOW_NONE;
+    tp->sessions[tp->session_count++] = session;
+    return 0;
+}
+
+int isotp_send(isotp_session_t * session, const uint8_t * data, uint16_t len, uint64_t now_us)
+{
+    if(session->tx_state != ISOTP_TX_IDLE || len == 0 || len > ISOTP_MAX_LENGTH) return -1;
+
+    session->tx_data = data;
+    session->tx_len = len;
+    session->tx_offset = 0;
+    session->tx_state = ISOTP_TX_FIRST;
+    isotp_tx_step(session, now_us);
+    return 0;
+}
+
+void isotp_receive(isotp_t * tp, const struct can2040_msg * msg, uint64_t now_us)
+{
+    if(msg->dlc < 1 || (msg->id & CAN2040_ID_RTR)) return;
+
+    for(uint8_t i = 0; i < tp->session_count; i++)
+    {
+        isotp_session_t * session = tp->sessions[i];
+        if(msg->id != session->config.rx_id) continue;
+
+        switch(msg->data[0] & 0xf0)
+        {
+            case ISOTP_PCI_SINGLE: isotp_rx_single(session, msg); break;
+            case ISOTP_PCI_FIRST: isotp_rx_first(session, msg, now_us); break;
+            case ISOTP_PCI_CONSECUTIVE: isotp_rx_consecutive(session, msg, now_us); break;
+            case ISOTP_PCI_FLOW: isotp_rx_flow(session, msg, now_us); break;
+            default: break;
+        }
+        return;
+    }
+}
+
+void isotp_poll(isotp_t * tp, uint64_t now_us)
+{
+    for(uint8_t i = 0; i < tp->session_count; i++)
+    {
+        isotp_session_t * session = tp->sessions[i];
+
+        if(session->rx_fc_pending != ISOTP_FLOW_NONE) isotp_send_flow(session, session->rx_fc_pending);
+        if(session->rx_state == ISOTP_RX_CONSECUTIVE && now_us >= session->rx_deadline_us)
+        {
+            isotp_rx_abort(session, ISOTP_EVENT_RX_TIMEOUT);
+        }
+        if(session->tx_state != ISOTP_TX_IDLE) isotp_tx_step(session, now_us);
+    }
+}
@@ -0,0 +1,120 @@
+/**
+ * isotp.h
+ * Jannis Lämmle
+ * ISO-TP (ISO 15765-2) transport over 8 byte CAN frames, for the multi-frame transfers of battery
+ * management systems and inverters
+ *
+ * An isotp_t serves up to ISOTP_MAX_SESSIONS sessions, each a pair of CAN ids. Received frames are handed
+ * in with isotp_receive(), frames are sent through the send function given to isotp_init() (usually
+ * can2040_transmit()). isotp_poll() sends what had to wait for the bus or for the separation time and
+ * runs the timeouts, call it from the main loop.
+ *
+ * Both directions work without copies in the layer: a message is sent straight from the caller's buffer,
+ * which has to stay valid until ISOTP_EVENT_TX_DONE, and consecutive frames are reassembled straight into
+ * the receive buffer of the session, which is valid until the next first frame after ISOTP_EVENT_RX_DONE.
+ * Flow control follows the block size and STmin of the receiving side, messages are up to 4095 bytes.
+ */
+
+#ifndef ISOTP_H_
+#define ISOTP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define ISOTP_MAX_SESSIONS 4
+#define ISOTP_MAX_LENGTH 4095
+
+// N_Bs and N_Cr: waiting for a flow control frame, and for the next consecutive frame
+#ifndef ISOTP_TIMEOUT_US
+#define ISOTP_TIMEOUT_US 1000000
+#endif
+
+#define ISOTP_PADDING 0xCC
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum isotp_event {
+    ISOTP_EVENT_RX_DONE,        // len bytes are in the receive buffer
+    ISOTP_EVENT_TX_DONE,
+    ISOTP_EVENT_RX_TIMEOUT,     // the sender stopped, the message is dropped
+    ISOTP_EVENT_RX_SEQUENCE,    // a consecutive frame is missing
+    ISOTP_EVENT_RX_OVERFLOW,    // the message does not fit the receive buffer, the sender is told so
+    ISOTP_EVENT_TX_TIMEOUT,     // no flow control from the receiver
+    ISOTP_EVENT_TX_OVERFLOW,    // the receiver has no room for the message
+} isotp_event_t;
+
+struct isotp_session;
+typedef void (* isotp_event_cb_t)(struct isotp_session * session, isotp_event_t event, uint32_t len);
+
+// Returns 0 if the frame was queued, a negative value if the bus has no room for it now
+typedef int (* isotp_send_t)(void * ctx, struct can2040_msg * msg);
+
+typedef struct isotp_session_config {
+    uint32_t tx_id;             // can2040 ids, with CAN2040_ID_EFF for 29 bit ids
+    uint32_t rx_id;
+    uint8_t block_size;         // consecutive frames the sender may send per flow control, 0 for all
+    uint8_t st_min;             // separation time asked of the sender: 0-127 ms, 0xF1-0xF9 100-900 us
+    bool padding;               // pad frames to 8 bytes with ISOTP_PADDING
+    uint8_t * rx_buffer;
+    uint16_t rx_size;
+    isotp_event_cb_t event_cb;
+    void * user;
+} isotp_session_config_t;
+
+typedef struct isotp_session {
+    isotp_session_config_t config;
+    struct isotp * tp;
+
+    // Sending
+    uint8_t tx_state;
+    uint8_t tx_sn;              // sequence number of the next consecutive frame
+    uint8_t tx_block_left;      // consecutive frames left in this block, 0 for all
+    uint8_t tx_block_size;      // as granted by the receiver
+    const uint8_t * tx_data;
+    uint16_t tx_len;
+    uint16_t tx_offset;
+    uint32_t tx_st_min_us;
+    uint64_t tx_next_us;        // earliest time for the next consecutive frame
+    uint64_t tx_deadline_us;
+
+    // Receiving
+    uint8_t rx_state;
+    uint8_t rx_sn;
+    uint8_t rx_block_left;
+    uint8_t rx_fc_pending;      // flow status of a flow control frame the bus had no room for, 0xff for none
+    uint16_t rx_len;
+    uint16_t rx_offset;
+    uint64_t rx_deadline_us;
+} isotp_session_t;
+
+typedef struct isotp {
+    isotp_session_t * sessions[ISOTP_MAX_SESSIONS];
+    uint8_t session_count;
+    isotp_send_t send;
+    void * send_ctx;
+} isotp_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void isotp_init(isotp_t * tp, isotp_send_t send, void * send_ctx);
+int isotp_add_session(isotp_t * tp, isotp_session_t * session, const isotp_session_config_t * config);
+
+// Returns 0 if the message is on its way, -1 if the session is still sending or len is out of range
+int isotp_send(isotp_session_t * session, const uint8_t * data, uint16_t len, uint64_t now_us);
+void isotp_receive(isotp_t * tp, const struct can2040_msg * msg, uint64_t now_us);
+void isotp_poll(isotp_t * tp, uint64_t now_us);
+
+#endif /* ISOTP_H_ */
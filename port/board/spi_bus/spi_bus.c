@@ -0,0 +1,292 @@
+/**
+ * spi_bus.c
+ * Jannis Lämmle
+ * Arbiter for SPI controllers shared by several devices, see spi_bus.h
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+#include "spi_bus.h"
+#include "log.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static spi_bus_t g_spi_bus[NUM_SPIS];
+static bool g_spi_bus_ready[NUM_SPIS];
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Setup
+ * ----------------------------------------------------------------------------------------------------
+ */
+spi_bus_t * spi_bus_init(spi_inst_t * spi, uint sck_pin, uint mosi_pin, int miso_pin)
+{
+    uint index = spi_get_index(spi);
+    spi_bus_t * bus = &g_spi_bus[index];
+
+    if(g_spi_bus_ready[index]) return bus;
+
+    memset(bus, 0, sizeof(*bus));
+    bus->spi = spi;
+    bus->lock = spin_lock_init(spin_lock_claim_unused(true));
+
+    // Clock and mode are set by the devices
+    spi_init(spi, 1000 * 1000);
+    gpio_set_function(sck_pin, GPIO_FUNC_SPI);
+    gpio_set_function(mosi_pin, GPIO_FUNC_SPI);
+    if(miso_pin >= 0) gpio_set_function((uint)miso_pin, GPIO_FUNC_SPI);
+
+    bus->dma_tx = dma_claim_unused_channel(true);
+    bus->dma_rx = dma_claim_unused_channel(true);
+
+    g_spi_bus_ready[index] = true;
+    return bus;
+}
+
+void spi_bus_add_device(spi_bus_t * bus, spi_bus_device_t * dev, const spi_bus_device_config_t * config)
+{
+    hard_assert(bus->device_count < SPI_BUS_MAX_DEVICES);
+
+    memset(dev, 0, sizeof(*dev));
+    dev->bus = bus;
+    dev->id = bus->device_count;
+    dev->priority = config->priority;
+    dev->cs_pin = config->cs_pin;
+
+    gpio_init(config->cs_pin);
+    gpio_set_dir(config->cs_pin, GPIO_OUT);
+    gpio_put(config->cs_pin, 1);
+
+    // Let the sdk work out the prescalers once, switching devices then only writes the registers
+    spi_set_baudrate(bus->spi, config->baudrate);
+    spi_set_format(bus->spi, 8, config->cpol, config->cpha, SPI_MSB_FIRST);
+    dev->cr0 = spi_get_hw(bus->spi)->cr0;
+    dev->cpsr = spi_get_hw(bus->spi)->cpsr;
+    bus->configured = dev;
+
+    bus->devices[bus->device_count++] = dev;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Arbitration
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Waiting device to hand the bus to, called with the bus lock held
+static spi_bus_device_t * spi_bus_next(spi_bus_t * bus)
+{
+    spi_bus_device_t * next = NULL;
+
+    for(uint8_t i = 0; i < bus->device_count; i++)
+    {
+        spi_bus_device_t * dev = bus->devices[i];
+        if(!(bus->waiting & (1u << i))) continue;
+
+        if(dev->passed >= SPI_BUS_MAX_PASSED)
+        {
+            next = dev;
+            break;
+        }
+        if(!next || dev->priority < next->priority) next = dev;
+    }
+    if(!next) return NULL;
+
+    for(uint8_t i = 0; i < bus->device_count; i++)
+    {
+        if((bus->waiting & (1u << i)) && bus->devices[i] != next) bus->devices[i]->passed++;
+    }
+    next->passed = 0;
+    bus->waiting &= ~(1u << next->id);
+    return next;
+}
+
+void spi_bus_acquire(spi_bus_device_t * dev)
+{
+    spi_bus_t * bus = dev->bus;
+    uint32_t start = time_us_32();
+    bool contended = false;
+
+    uint32_t save = spin_lock_blocking(bus->lock);
+    if(bus->owner == NULL)
+    {
+        bus->owner = dev;
+    }
+    else
+    {
+        bus->waiting |= 1u << dev->id;
+        contended = true;
+    }
+    spin_unlock(bus->lock, save);
+
+    // Handed over by spi_bus_release()
+    while(bus->owner != dev) tight_loop_contents();
+    __mem_fence_acquire();
+
+    if(bus->configured != dev)
+    {
+        spi_hw_t * hw = spi_get_hw(bus->spi);
+        hw_clear_bits(&hw->cr1, SPI_SSPCR1_SSE_BITS);
+        hw->cpsr = dev->cpsr;
+        hw->cr0 = dev->cr0;
+        hw_set_bits(&hw->cr1, SPI_SSPCR1_SSE_BITS);
+        bus->configured = dev;
+    }
+    gpio_put(dev->cs_pin, 0);
+
+    uint32_t now = time_us_32();
+    uint32_t wait = now - start;
+    dev->acquired_us = now;
+    dev->stats.transactions++;
+    if(contended) dev->stats.contended++;
+    dev->stats.wait_us_total += wait;
+    if(wait > dev->stats.wait_us_max) dev->stats.wait_us_max = wait;
+}
+
+void spi_bus_release(spi_bus_device_t * dev)
+{
+    spi_bus_t * bus = dev->bus;
+
+    spi_bus_wait(dev);
+    gpio_put(dev->cs_pin, 1);
+
+    uint32_t hold = time_us_32() - dev->acquired_us;
+    if(hold > dev->stats.hold_us_max) dev->stats.hold_us_max = hold;
+
+    __mem_fence_release();
+    uint32_t save = spin_lock_blocking(bus->lock);
+    bus->owner = spi_bus_next(bus);
+    spin_unlock(bus->lock, save);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Transfers
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void spi_bus_dma_start(spi_bus_t * bus, const uint8_t * src, bool src_increment, uint8_t * dst, bool dst_increment,
+                              size_t len)
+{
+    dma_channel_config tx_config = dma_channel_get_default_config(bus->dma_tx);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
+    channel_config_set_dreq(&tx_config, spi_get_dreq(bus->spi, true));
+    channel_config_set_read_increment(&tx_config, src_increment);
+    channel_config_set_write_increment(&tx_config, false);
+    dma_channel_configure(bus->dma_tx, &tx_config, &spi_get_hw(bus->spi)->dr, src, len, false);
+
+    if(dst)
+    {
+        dma_channel_config rx_config = dma_channel_get_default_config(bus->dma_rx);
+        channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+        channel_config_set_dreq(&rx_config, spi_get_dreq(bus->spi, false));
+        channel_config_set_read_increment(&rx_config, false);
+        channel_config_set_write_increment(&rx_config, dst_increment);
+        dma_channel_configure(bus->dma_rx, &rx_config, dst, &spi_get_hw(bus->spi)->dr, len, false);
+        dma_start_channel_mask((1u << bus->dma_tx) | (1u << bus->dma_rx));
+    }
+    else
+    {
+        dma_channel_start(bus->dma_tx);
+    }
+}
+
+void spi_bus_write(spi_bus_device_t * dev, const uint8_t * src, size_t len)
+{
+    spi_bus_t * bus = dev->bus;
+    uint8_t discard;
+
+    spi_bus_wait(dev);
+    if(len < SPI_BUS_DMA_MIN)
+    {
+        spi_write_blocking(bus->spi, src, len);
+    }
+    else
+    {
+        spi_bus_dma_start(bus, src, true, &discard, false, len);
+        dma_channel_wait_for_finish_blocking(bus->dma_rx);
+    }
+    dev->stats.bytes += len;
+}
+
+void spi_bus_read(spi_bus_device_t * dev, uint8_t tx_fill, uint8_t * dst, size_t len)
+{
+    spi_bus_t * bus = dev->bus;
+
+    spi_bus_wait(dev);
+    if(len < SPI_BUS_DMA_MIN)
+    {
+        spi_read_blocking(bus->spi, tx_fill, dst, len);
+    }
+    else
+    {
+        spi_bus_dma_start(bus, &tx_fill, false, dst, true, len);
+        dma_channel_wait_for_finish_blocking(bus->dma_rx);
+    }
+    dev->stats.bytes += len;
+}
+
+void spi_bus_write_start(spi_bus_device_t * dev, const uint8_t * src, size_t len)
+{
+    spi_bus_t * bus = dev->bus;
+
+    spi_bus_wait(dev);
+    spi_bus_dma_start(bus, src, true, NULL, false, len);
+    bus->dma_active = true;
+    dev->stats.bytes += len;
+}
+
+void spi_bus_wait(spi_bus_device_t * dev)
+{
+    spi_bus_t * bus = dev->bus;
+
+    if(!bus->dma_active) return;
+
+    dma_channel_wait_for_finish_blocking(bus->dma_tx);
+    // DMA is done once the last byte is in the FIFO, wait for it to leave the shifter
+    while(spi_is_busy(bus->spi)) tight_loop_contents();
+    // Drop what was clocked in meanwhile, the next device may read
+    while(spi_is_readable(bus->spi)) (void)spi_get_hw(bus->spi)->dr;
+    spi_get_hw(bus->spi)->icr = SPI_SSPICR_RORIC_BITS;
+    bus->dma_active = false;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Statistics
+ * ----------------------------------------------------------------------------------------------------
+ */
+void spi_bus_report(void)
+{
+    for(uint index = 0; index < NUM_SPIS; index++)
+    {
+        if(!g_spi_bus_ready[index]) continue;
+
+        spi_bus_t * bus = &g_spi_bus[index];
+        for(uint8_t i = 0; i < bus->device_count; i++)
+        {
+            const spi_bus_stats_t * stats = &bus->devices[i]->stats;
+            uint32_t wait_avg = stats->transactions ? (uint32_t)(stats->wait_us_total / stats->transactions) : 0;
+
+            LOG(SPI_BUS_USE, index, bus->devices[i]->cs_pin, stats->transactions, stats->contended,
+                (uint32_t)(stats->bytes / 1024));
+            LOG(SPI_BUS_LATENCY, index, bus->devices[i]->cs_pin, wait_avg, stats->wait_us_max, stats->hold_us_max);
+        }
+    }
+}
+
+void spi_bus_reset_stats(void)
+{
+    for(uint index = 0; index < NUM_SPIS; index++)
+    {
+        if(!g_spi_bus_ready[index]) continue;
+
+        spi_bus_t * bus = &g_spi_bus[index];
+        for(uint8_t i = 0; i < bus->device_count; i++) memset(&bus->devices[i]->stats, 0, sizeof(spi_bus_stats_t));
+    }
+}
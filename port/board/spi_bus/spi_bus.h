@@ -0,0 +1,116 @@
+/**
+ * spi_bus.h
+ * Jannis Lämmle
+ * Arbiter for SPI controllers shared by several devices (W5x00, display)
+ *
+ * A bus owns its controller and one pair of DMA channels for all of its devices. A device acquires the
+ * bus for a transaction, which applies its clock and mode if another device used the bus last and asserts
+ * its chip select. Devices waiting for the bus are served by priority on release. A device passed over
+ * SPI_BUS_MAX_PASSED times is served next regardless, so a busy high priority device cannot starve the
+ * others. Waiting spins, so the bus must not be acquired from interrupt handlers.
+ *
+ * To put the display on the controller of the W5x00, set DISPLAY_SPI_PORT and its pins in display.h to
+ * the ones in w5x00_spi.h: both drivers get the same bus from spi_bus_init().
+ */
+
+#ifndef SPI_BUS_H_
+#define SPI_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define SPI_BUS_MAX_DEVICES 4
+
+// Transfers of at least this many bytes use the DMA, shorter ones are copied by the cpu
+#ifndef SPI_BUS_DMA_MIN
+#define SPI_BUS_DMA_MIN 16
+#endif
+
+// Releases a waiting device may be passed over by higher priority ones before it is served
+#ifndef SPI_BUS_MAX_PASSED
+#define SPI_BUS_MAX_PASSED 4
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef struct spi_bus_device_config {
+    uint cs_pin;
+    uint baudrate;
+    spi_cpol_t cpol;
+    spi_cpha_t cpha;
+    uint8_t priority;       // 0 is served first
+} spi_bus_device_config_t;
+
+typedef struct spi_bus_stats {
+    uint32_t transactions;  // times the bus was acquired
+    uint32_t contended;     // of these, times the device had to wait
+    uint32_t wait_us_max;
+    uint64_t wait_us_total;
+    uint32_t hold_us_max;   // longest time the bus was held
+    uint64_t bytes;
+} spi_bus_stats_t;
+
+struct spi_bus;
+
+typedef struct spi_bus_device {
+    struct spi_bus * bus;
+    uint8_t id;             // slot on the bus
+    uint8_t priority;
+    uint8_t passed;         // releases this device was passed over while waiting
+    uint cs_pin;
+    uint32_t cr0;           // clock and mode, written when the bus switches to this device
+    uint32_t cpsr;
+    uint32_t acquired_us;
+    spi_bus_stats_t stats;
+} spi_bus_device_t;
+
+typedef struct spi_bus {
+    spi_inst_t * spi;
+    spin_lock_t * lock;
+    uint dma_tx;
+    uint dma_rx;
+    spi_bus_device_t * devices[SPI_BUS_MAX_DEVICES];
+    uint8_t device_count;
+    volatile uint8_t waiting;               // bit per device id
+    spi_bus_device_t * volatile owner;
+    spi_bus_device_t * configured;          // device whose clock and mode are set
+    bool dma_active;                        // write started by spi_bus_write_start()
+} spi_bus_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Setup */
+// Returns the bus of the controller, initialized by its first caller. miso_pin is -1 for write only buses
+spi_bus_t * spi_bus_init(spi_inst_t * spi, uint sck_pin, uint mosi_pin, int miso_pin);
+void spi_bus_add_device(spi_bus_t * bus, spi_bus_device_t * dev, const spi_bus_device_config_t * config);
+
+/* Arbitration */
+void spi_bus_acquire(spi_bus_device_t * dev);   // blocks until the bus is free, then asserts chip select
+void spi_bus_release(spi_bus_device_t * dev);   // waits for a pending write, deasserts chip select
+
+/* Transfers, only between acquire and release */
+void spi_bus_write(spi_bus_device_t * dev, const uint8_t * src, size_t len);
+void spi_bus_read(spi_bus_device_t * dev, uint8_t tx_fill, uint8_t * dst, size_t len);
+void spi_bus_write_start(spi_bus_device_t * dev, const uint8_t * src, size_t len); // returns while the DMA sends
+void spi_bus_wait(spi_bus_device_t * dev);      // wait for spi_bus_write_start() to finish
+
+/* Statistics */
+void spi_bus_report(void);                      // logs the contention and latency of all devices
+void spi_bus_reset_stats(void);
+
+#endif /* SPI_BUS_H_ */
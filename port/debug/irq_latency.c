@@ -0,0 +1,97 @@
+/**
+ * irq_latency.c
+ * Jannis Lämmle
+ * Interrupt latency probe, see irq_latency.h
+ *
+ * The alarm is armed for an absolute time, the handler compares the timer with it. The timer counts
+ * microseconds, so latencies below 1 us read as 0.
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+
+#include "irq_latency.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static int g_alarm = -1;
+static uint32_t g_period_us;
+static volatile uint64_t g_target_us;
+static irq_latency_stats_t g_stats;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+// A target that has already passed does not fire, the next period is tried then
+static void irq_latency_arm(uint alarm_num, uint64_t now)
+{
+    do
+    {
+        g_target_us = now + g_period_us;
+        now = time_us_64();
+    } while(hardware_alarm_set_target(alarm_num, from_us_since_boot(g_target_us)));
+}
+
+static void irq_latency_alarm(uint alarm_num)
+{
+    uint64_t now = time_us_64();
+    uint32_t latency = (uint32_t)(now - g_target_us);
+
+    g_stats.samples++;
+    g_stats.us_total += latency;
+    if(latency < g_stats.us_min) g_stats.us_min = latency;
+    if(latency > g_stats.us_max) g_stats.us_max = latency;
+
+    // Relative to now, a late sample does not cause a burst of catch-up alarms
+    irq_latency_arm(alarm_num, now);
+}
+
+void irq_latency_start(uint32_t period_us)
+{
+    if(g_alarm < 0)
+    {
+        g_alarm = hardware_alarm_claim_unused(true);
+        hardware_alarm_set_callback((uint)g_alarm, irq_latency_alarm);
+        irq_set_priority(hardware_alarm_get_irq_num((uint)g_alarm), PICO_HIGHEST_IRQ_PRIORITY);
+    }
+
+    g_period_us = period_us;
+    irq_latency_reset_stats();
+
+    irq_latency_arm((uint)g_alarm, time_us_64());
+}
+
+void irq_latency_stop(void)
+{
+    if(g_alarm < 0) return;
+
+    hardware_alarm_cancel((uint)g_alarm);
+    hardware_alarm_set_callback((uint)g_alarm, NULL);
+    irq_set_priority(hardware_alarm_get_irq_num((uint)g_alarm), PICO_DEFAULT_IRQ_PRIORITY);
+    hardware_alarm_unclaim((uint)g_alarm);
+    g_alarm = -1;
+}
+
+void irq_latency_get_stats(irq_latency_stats_t * stats)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *stats = g_stats;
+    restore_interrupts(irq);
+}
+
+void irq_latency_reset_stats(void)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.us_min = UINT32_MAX;
+    restore_interrupts(irq);
+}
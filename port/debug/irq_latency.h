@@ -0,0 +1,38 @@
+/**
+ * irq_latency.h
+ * Jannis Lämmle
+ * Interrupt latency probe: a hardware alarm fires periodically and its handler records how late it runs.
+ * The timer interrupt gets the highest priority, like the PIO interrupts of can2040 (can_bus.c), so the
+ * latency seen by the probe is the time the CAN receiver may have to wait as well, e.g. while code with
+ * interrupts disabled or another handler of the highest priority runs.
+ */
+
+#ifndef IRQ_LATENCY_H_
+#define IRQ_LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef struct irq_latency_stats {
+    uint32_t samples;
+    uint32_t us_min;
+    uint32_t us_max;
+    uint64_t us_total;
+} irq_latency_stats_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void irq_latency_start(uint32_t period_us);     // claims a hardware alarm, resets the statistics
+void irq_latency_stop(void);                    // releases the alarm
+void irq_latency_get_stats(irq_latency_stats_t * stats);
+void irq_latency_reset_stats(void);
+
+#endif /* IRQ_LATENCY_H_ */
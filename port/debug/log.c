@@ -0,0 +1,218 @@
+/**
+ * log.c
+ * Jannis Lämmle
+ * Deferred binary logging: call sites store a message id and integer arguments in a ring, formatting
+ * and output happen later in log_drain() (on core1 on device)
+ *
+ * Record layout in the ring (32 bit words):
+ *   header     id | argc << LOG_HEADER_ARGS_SHIFT | data length << LOG_HEADER_DATA_SHIFT
+ *   timestamp  time_us_32() when the record was written
+ *   args       argc words
+ *   data       (data length + 3) / 4 words, bytes in little endian order
+ * Binary output is LOG_SYNC followed by the record words in little endian.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#endif
+
+#include "log.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define RING_MASK (LOG_RING_WORDS - 1)
+#define RECORD_MAX_WORDS (2 + LOG_MAX_ARGS + (LOG_MAX_DATA + 3) / 4)
+
+_Static_assert((LOG_RING_WORDS & RING_MASK) == 0, "LOG_RING_WORDS has to be a power of two");
+_Static_assert(LOG_RING_WORDS >= RECORD_MAX_WORDS, "LOG_RING_WORDS is too small for LOG_MAX_DATA");
+_Static_assert(LOG_MSG_COUNT <= LOG_HEADER_ID_MASK + 1, "too many log messages");
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+#if !LOG_BINARY
+static const char * const g_formats[LOG_MSG_COUNT] = {
+#define LOG_MESSAGE(name, level, format) format,
+#include "log_messages.def"
+#undef LOG_MESSAGE
+};
+#endif
+
+static uint32_t g_ring[LOG_RING_WORDS];
+static uint32_t g_head; // written by log_write only
+static uint32_t g_tail; // written by log_drain only
+
+static log_stats_t g_stats;
+static uint32_t g_dropped_reported;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+static uint32_t log_irq_disable(void)
+{
+#if PICO_ON_DEVICE
+    return save_and_disable_interrupts();
+#else
+    return 0;
+#endif
+}
+
+static void log_irq_restore(uint32_t status)
+{
+#if PICO_ON_DEVICE
+    restore_interrupts(status);
+#else
+    (void)status;
+#endif
+}
+
+void log_write(log_message_t id, uint8_t argc, const uint32_t * argv, const void * data, uint16_t len)
+{
+    const uint8_t * bytes = data;
+
+    if(argc > LOG_MAX_ARGS) argc = LOG_MAX_ARGS;
+    if(len > LOG_MAX_DATA) len = LOG_MAX_DATA;
+
+    uint32_t words = 2 + argc + (len + 3) / 4;
+
+    // Interrupts on this core could log as well, the ring is only reserved for a few cycles
+    uint32_t irq = log_irq_disable();
+    uint32_t head = g_head;
+    uint32_t used = head - __atomic_load_n(&g_tail, __ATOMIC_ACQUIRE);
+
+    if(used + words > LOG_RING_WORDS)
+    {
+        g_stats.dropped++;
+        log_irq_restore(irq);
+        return;
+    }
+
+    g_ring[head++ & RING_MASK] = id | (uint32_t)argc << LOG_HEADER_ARGS_SHIFT | (uint32_t)len << LOG_HEADER_DATA_SHIFT;
+    g_ring[head++ & RING_MASK] = time_us_32();
+    for(uint8_t i = 0; i < argc; i++) g_ring[head++ & RING_MASK] = argv[i];
+    for(uint16_t i = 0; i < len; i += 4)
+    {
+        uint32_t word = 0;
+        memcpy(&word, &bytes[i], len - i < 4 ? len - i : 4);
+        g_ring[head++ & RING_MASK] = word;
+    }
+
+    // Publish the record to the drain only after all of its words are written
+    __atomic_store_n(&g_head, head, __ATOMIC_RELEASE);
+
+    g_stats.records++;
+    if(used + words > g_stats.used_max) g_stats.used_max = used + words;
+    log_irq_restore(irq);
+}
+
+#if LOG_BINARY
+static void log_output_byte(uint8_t byte)
+{
+#if PICO_ON_DEVICE
+    putchar_raw(byte); // no newline translation
+#else
+    fputc(byte, stdout);
+#endif
+}
+
+static void log_output(const uint32_t * record, uint32_t words)
+{
+    log_output_byte(LOG_SYNC);
+    for(uint32_t i = 0; i < words; i++)
+    {
+        for(uint8_t b = 0; b < 32; b += 8) log_output_byte(record[i] >> b);
+    }
+}
+#else
+static void log_output(const uint32_t * record, uint32_t words)
+{
+    uint32_t id = record[0] & LOG_HEADER_ID_MASK;
+    uint8_t argc = (record[0] >> LOG_HEADER_ARGS_SHIFT) & LOG_HEADER_ARGS_MASK;
+    uint16_t len = record[0] >> LOG_HEADER_DATA_SHIFT;
+    uint32_t args[LOG_MAX_ARGS] = {0};
+
+    memcpy(args, &record[2], argc * sizeof(uint32_t));
+
+    printf("[%6lu.%03lu] ", (unsigned long)(record[1] / 1000000), (unsigned long)(record[1] / 1000 % 1000));
+    if(id < LOG_MSG_COUNT) printf(g_formats[id], args[0], args[1], args[2], args[3], args[4], args[5]);
+    else printf("unknown message %lu", (unsigned long)id);
+
+    if(len > 0)
+    {
+        printf("\r\n");
+        fwrite(&record[2 + argc], 1, len, stdout);
+    }
+    printf("\r\n");
+}
+#endif
+
+uint32_t log_drain(uint32_t max_records)
+{
+    static uint32_t record[RECORD_MAX_WORDS];
+    uint32_t tail = g_tail;
+    uint32_t count = 0;
+
+    while(count < max_records && tail != __atomic_load_n(&g_head, __ATOMIC_ACQUIRE))
+    {
+        uint32_t header = g_ring[tail & RING_MASK];
+        uint8_t argc = (header >> LOG_HEADER_ARGS_SHIFT) & LOG_HEADER_ARGS_MASK;
+        uint32_t words = 2 + argc + ((header >> LOG_HEADER_DATA_SHIFT) + 3) / 4;
+
+        // Copy the record out and release its space before the slow output
+        for(uint32_t i = 0; i < words; i++) record[i] = g_ring[(tail + i) & RING_MASK];
+        tail += words;
+        __atomic_store_n(&g_tail, tail, __ATOMIC_RELEASE);
+
+        log_output(record, words);
+        count++;
+    }
+
+    uint32_t dropped = g_stats.dropped;
+    if(dropped != g_dropped_reported)
+    {
+        uint32_t notice[3] = {LOG_MSG_LOG_DROPPED | 1u << LOG_HEADER_ARGS_SHIFT, time_us_32(), dropped - g_dropped_reported};
+        log_output(notice, count_of(notice));
+        g_dropped_reported = dropped;
+    }
+
+    return count;
+}
+
+#if PICO_ON_DEVICE && LOG_DRAIN_CORE1
+static void log_core1_main(void)
+{
+    while(true)
+    {
+        if(log_drain(16) == 0) sleep_ms(1);
+    }
+}
+#endif
+
+void log_init(void)
+{
+    g_head = 0;
+    g_tail = 0;
+    g_dropped_reported = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+
+#if PICO_ON_DEVICE && LOG_DRAIN_CORE1
+    multicore_launch_core1(log_core1_main);
+#endif
+}
+
+void log_get_stats(log_stats_t * stats)
+{
+    memcpy(stats, &g_stats, sizeof(*stats));
+}
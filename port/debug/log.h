@@ -0,0 +1,110 @@
+/**
+ * log.h
+ * Jannis Lämmle
+ * Deferred binary logging: call sites store a message id and integer arguments in a ring, formatting
+ * and output happen later in log_drain() (on core1 on device)
+ */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Levels */
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+// Messages above this level are removed at compile time
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/* Ring */
+// 32 bit words, has to be a power of two
+#ifndef LOG_RING_WORDS
+#define LOG_RING_WORDS 1024
+#endif
+#define LOG_MAX_ARGS 6
+// Bytes kept of the data passed to LOG_DATA()
+#define LOG_MAX_DATA 512
+
+/* Output */
+// 1: log_drain() writes the raw records for scripts/log_decode.py, 0: formatted text
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+// Drain the ring from a loop on core1, otherwise log_drain() has to be called when idle
+#ifndef LOG_DRAIN_CORE1
+#define LOG_DRAIN_CORE1 1
+#endif
+
+// First byte of every record in binary output
+#define LOG_SYNC 0xA5
+
+/* Record header word */
+#define LOG_HEADER_ID_MASK 0x0FFFu
+#define LOG_HEADER_ARGS_SHIFT 12
+#define LOG_HEADER_ARGS_MASK 0x7u
+#define LOG_HEADER_DATA_SHIFT 16
+
+/* Call sites */
+#define LOG_ENABLED(name) (LOG_LEVEL_OF_##name <= LOG_LEVEL)
+
+#define LOG_COUNT(...) LOG_COUNT_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_COUNT_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+
+// LOG(name, args...) with up to LOG_MAX_ARGS integer arguments
+#define LOG(name, ...) do { \
+        if(LOG_ENABLED(name)) log_write(LOG_MSG_##name, LOG_COUNT(__VA_ARGS__), \
+                                        (const uint32_t []){0, ##__VA_ARGS__} + 1, NULL, 0); \
+    } while(0)
+
+// LOG_DATA(name, data, len, args...) additionally copies up to LOG_MAX_DATA bytes of data
+#define LOG_DATA(name, data, len, ...) do { \
+        if(LOG_ENABLED(name)) log_write(LOG_MSG_##name, LOG_COUNT(__VA_ARGS__), \
+                                        (const uint32_t []){0, ##__VA_ARGS__} + 1, (data), (len)); \
+    } while(0)
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum {
+#define LOG_MESSAGE(name, level, format) LOG_MSG_##name,
+#include "log_messages.def"
+#undef LOG_MESSAGE
+    LOG_MSG_COUNT,
+} log_message_t;
+
+enum {
+#define LOG_MESSAGE(name, level, format) LOG_LEVEL_OF_##name = level,
+#include "log_messages.def"
+#undef LOG_MESSAGE
+};
+
+typedef struct log_stats {
+    uint32_t records;       // records written to the ring
+    uint32_t dropped;       // records lost because the ring was full
+    uint32_t used_max;      // highest ring fill in words
+} log_stats_t;
+
+/*********************************************
+* Log Functions
+*********************************************/
+void log_init(void); // Start draining on core1 if LOG_DRAIN_CORE1
+// Store a record, never blocks. Safe from interrupts on the logging core, not from both cores at once
+void log_write(log_message_t id, uint8_t argc, const uint32_t * argv, const void * data, uint16_t len);
+uint32_t log_drain(uint32_t max_records); // Format and output up to max_records, returns the number written
+void log_get_stats(log_stats_t * stats);
+
+#endif /* LOG_H_ */
@@ -0,0 +1,104 @@
+/**
+ * trace.c
+ * Jannis Lämmle
+ * Event tracing into a ring per core, dumped as text and converted by scripts/trace2json.py
+ *
+ * Each core only writes its own ring, so recording needs no lock shared between the cores. Within a core
+ * a slot is claimed with an atomic increment of the head (interrupts off for the increment on the M0+,
+ * which has no exclusive access instructions), so trace points may be used in interrupt handlers.
+ *
+ * Dump format, one line per event after a header with the 64 bit time of the dump:
+ *   trace: now <time_us_64>
+ *   trace: <core> <timestamp> <event> <phase> <arg>
+ *   trace: end
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#endif
+
+#include "trace.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+#define RING_MASK (TRACE_RING_EVENTS - 1)
+
+_Static_assert((TRACE_RING_EVENTS & RING_MASK) == 0, "TRACE_RING_EVENTS has to be a power of two");
+_Static_assert(TRACE_EVENT_COUNT <= TRACE_ID_MASK + 1, "too many trace events");
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef struct trace_ring {
+    trace_record_t records[TRACE_RING_EVENTS];
+    uint32_t head;          // events recorded in total
+} trace_ring_t;
+
+static trace_ring_t g_rings[TRACE_CORES];
+static volatile bool g_paused;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+static uint32_t trace_claim(trace_ring_t * ring)
+{
+#if PICO_ON_DEVICE && defined(__ARM_ARCH_6M__)
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t slot = ring->head++;
+    restore_interrupts(irq);
+    return slot;
+#else
+    return __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+void trace_record(uint16_t event, uint16_t arg)
+{
+    if(g_paused) return;
+
+#if PICO_ON_DEVICE
+    trace_ring_t * ring = &g_rings[get_core_num()];
+#else
+    trace_ring_t * ring = &g_rings[0];
+#endif
+    trace_record_t * record = &ring->records[trace_claim(ring) & RING_MASK];
+
+    record->timestamp = time_us_32();
+    record->event = event;
+    record->arg = arg;
+}
+
+void trace_dump(void)
+{
+    g_paused = true;
+
+    printf("trace: now %llu\n", (unsigned long long)time_us_64());
+    for(uint8_t core = 0; core < TRACE_CORES; core++)
+    {
+        trace_ring_t * ring = &g_rings[core];
+        uint32_t head = ring->head;
+        uint32_t count = head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+
+        for(uint32_t i = head - count; i != head; i++)
+        {
+            const trace_record_t * record = &ring->records[i & RING_MASK];
+            printf("trace: %u %lu %u %u %u\n", core, (unsigned long)record->timestamp, record->event & TRACE_ID_MASK,
+                   record->event >> TRACE_PHASE_SHIFT, record->arg);
+        }
+        ring->head = 0;
+    }
+    printf("trace: end\n");
+
+    g_paused = false;
+}
@@ -0,0 +1,74 @@
+/**
+ * trace.h
+ * Jannis Lämmle
+ * Event tracing into a ring per core, dumped as text and converted by scripts/trace2json.py
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Trace points compile to nothing unless enabled (cmake -DTRACE=ON)
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+// Events per core, has to be a power of two. Older events are overwritten
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS 1024
+#endif
+
+#define TRACE_CORES 2
+
+/* Phases */
+#define TRACE_PHASE_INSTANT 0
+#define TRACE_PHASE_BEGIN 1
+#define TRACE_PHASE_END 2
+
+#define TRACE_ID_MASK 0x3FFFu
+#define TRACE_PHASE_SHIFT 14
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(name, arg) trace_record(TRACE_##name | TRACE_PHASE_BEGIN << TRACE_PHASE_SHIFT, (arg))
+#define TRACE_END(name, arg) trace_record(TRACE_##name | TRACE_PHASE_END << TRACE_PHASE_SHIFT, (arg))
+#define TRACE_INSTANT(name, arg) trace_record(TRACE_##name | TRACE_PHASE_INSTANT << TRACE_PHASE_SHIFT, (arg))
+#else
+#define TRACE_BEGIN(name, arg) ((void)0)
+#define TRACE_END(name, arg) ((void)0)
+#define TRACE_INSTANT(name, arg) ((void)0)
+#endif
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum {
+#define TRACE_EVENT(name) TRACE_##name,
+#include "trace_events.def"
+#undef TRACE_EVENT
+    TRACE_EVENT_COUNT,
+} trace_event_t;
+
+typedef struct trace_record {
+    uint32_t timestamp;     // time_us_32()
+    uint16_t event;         // trace_event_t | phase << TRACE_PHASE_SHIFT
+    uint16_t arg;
+} trace_record_t;
+
+/*********************************************
+* Trace Functions
+*********************************************/
+// Store an event in the ring of the calling core. Lock free, safe from interrupts
+void trace_record(uint16_t event, uint16_t arg);
+// Print all recorded events as "trace:" lines, recording is paused meanwhile
+void trace_dump(void);
+
+#endif /* TRACE_H_ */
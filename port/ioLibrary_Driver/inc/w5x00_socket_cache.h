@@ -0,0 +1,103 @@
+/**
+ * w5x00_socket_cache.h
+ * Jannis Lämmle
+ * Socket register snapshots: the register block of a socket is read in one SPI frame and kept as a shadow
+ * copy until the next tick, so repeated reads of status, interrupt and receive size within one poll cost
+ * no further SPI transactions. Registers written through the ioLibrary (commands, setSn_IR) are not seen
+ * by the shadow copy before the next tick, w5x00_socket_cache_clear_ir() updates both.
+ */
+
+#ifndef _W5X00_SOCKET_CACHE_H_
+#define _W5X00_SOCKET_CACHE_H_
+
+#include <stdint.h>
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Sn_MR up to and including Sn_KPALVTR */
+#define W5X00_SOCKET_SNAPSHOT_LEN 0x30
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef struct w5x00_socket_cache_stats {
+    uint32_t ticks;
+    uint32_t transactions;  // SPI frames issued for snapshots
+    uint32_t replaced;      // SPI frames the reads served from the snapshots would have cost through the ioLibrary
+} w5x00_socket_cache_stats_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+/*! \brief Read the register block of a socket
+ *  \ingroup w5x00_socket_cache
+ *
+ *  Reads W5X00_SOCKET_SNAPSHOT_LEN bytes from Sn_MR on in one SPI frame. Sn_RX_RSR is read again until
+ *  two reads agree, as the chip may update it between its two bytes.
+ *
+ *  \param sn socket number
+ *  \param regs buffer of W5X00_SOCKET_SNAPSHOT_LEN bytes
+ */
+void w5x00_socket_snapshot(uint8_t sn, uint8_t *regs);
+
+/*! \brief Start a new poll tick
+ *  \ingroup w5x00_socket_cache
+ *
+ *  Invalidates the shadow copies, the next read of a socket takes a new snapshot.
+ */
+void w5x00_socket_cache_tick(void);
+
+/*! \brief Invalidate the shadow copy of a socket
+ *  \ingroup w5x00_socket_cache
+ *
+ *  \param sn socket number
+ */
+void w5x00_socket_cache_invalidate(uint8_t sn);
+
+/*! \brief Cached socket registers
+ *  \ingroup w5x00_socket_cache
+ *
+ *  Served from the snapshot of the current tick, taking one if there is none.
+ *
+ *  \param sn socket number
+ */
+uint8_t w5x00_socket_cache_sr(uint8_t sn);
+uint8_t w5x00_socket_cache_ir(uint8_t sn);
+uint16_t w5x00_socket_cache_rx_rsr(uint8_t sn);
+void w5x00_socket_cache_dest(uint8_t sn, uint8_t *ip, uint16_t *port);
+
+/*! \brief Clear socket interrupt flags
+ *  \ingroup w5x00_socket_cache
+ *
+ *  Writes Sn_IR and clears the flags in the shadow copy as well.
+ *
+ *  \param sn socket number
+ *  \param mask Sn_IR flags to clear
+ */
+void w5x00_socket_cache_clear_ir(uint8_t sn, uint8_t mask);
+
+/*! \brief Count a read skipped because of the cached state
+ *  \ingroup w5x00_socket_cache
+ *
+ *  For callers that skip an ioLibrary call which would only have read registers.
+ *
+ *  \param transactions SPI frames the skipped call would have cost
+ */
+void w5x00_socket_cache_count_skipped(uint32_t transactions);
+
+/*! \brief Statistics since the last reset
+ *  \ingroup w5x00_socket_cache
+ *
+ *  transactions saved = replaced - transactions
+ */
+const w5x00_socket_cache_stats_t *w5x00_socket_cache_get_stats(void);
+void w5x00_socket_cache_reset_stats(void);
+
+#endif /* _W5X00_SOCKET_CACHE_H_ */
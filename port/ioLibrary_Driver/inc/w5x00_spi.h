@@ -40,6 +40,20 @@
 /* Use SPI DMA */
 //#define USE_SPI_DMA // if you want to use SPI DMA, uncomment.
 #endif
+
+/* Locking */
+// 1: frames to the chip run with interrupts disabled (critical section), as in the WIZnet examples.
+// 0: a mutex, interrupts stay enabled during frames, so e.g. the can2040 PIO interrupt is not delayed
+#ifndef WIZCHIP_LOCK_MASKS_IRQ
+#define WIZCHIP_LOCK_MASKS_IRQ 0
+#endif
+
+#ifdef USE_SPI_PIO
+#include "wiznet_spi_pio.h"
+
+/* PIO SPI handle, for transfers with wiznet_spi_pio_transfer_async() */
+extern wiznet_spi_handle_t spi_handle;
+#endif
 /**
  * ----------------------------------------------------------------------------------------------------
  * Functions
@@ -112,8 +126,9 @@ static void wizchip_write_burst(uint8_t *pBuf, uint16_t len);
  *  \ingroup w5x00_spi
  *
  *  Set ciritical section enter blocking function.
- *  If the spin lock associated with this critical section is in use, then this
- *  method will block until it is released.
+ *  If the lock is in use, then this method will block until it is released.
+ *  Interrupts are only disabled with WIZCHIP_LOCK_MASKS_IRQ, so the chip must
+ *  not be accessed from interrupt handlers.
  *
  *  \param none
  */
@@ -7,9 +7,30 @@
 #ifndef _WIZNET_SPI_PIO_H_
 #define _WIZNET_SPI_PIO_H_
 
+#include <stddef.h>
+
+#include "pico/error.h"
+
 #include "wiznet_spi.h"
 
+// Result of wiznet_spi_pio_transfer_poll() while the transfer is running
+#define WIZNET_SPI_PIO_BUSY 1
+
+// Called from the DMA interrupt or the timeout alarm with PICO_OK or PICO_ERROR_TIMEOUT
+typedef void (*wiznet_spi_pio_callback_t)(wiznet_spi_handle_t handle, int result, void *user_data);
 
 wiznet_spi_handle_t wiznet_spi_pio_open(const wiznet_spi_config_t *spi_config);
 
+// Send tx and then receive rx_length bytes into rx (NULL to only send) by DMA, between frame_start and
+// frame_end of the handle. tx has to start with the 3 byte spi header and is limited to the 4 byte fifo
+// when reading, both buffers have to stay valid until the transfer ended. With a callback its end is signalled by interrupt, without one it is found by
+// wiznet_spi_pio_transfer_poll(). Returns PICO_OK if started, PICO_ERROR_RESOURCE_IN_USE while another
+// transfer is running or PICO_ERROR_INVALID_ARG.
+int wiznet_spi_pio_transfer_async(wiznet_spi_handle_t handle, const uint8_t *tx, size_t tx_length, uint8_t *rx, size_t rx_length,
+                                  wiznet_spi_pio_callback_t callback, void *user_data);
+
+// WIZNET_SPI_PIO_BUSY while the transfer is running, then PICO_OK or PICO_ERROR_TIMEOUT
+int wiznet_spi_pio_transfer_poll(wiznet_spi_handle_t handle);
+int wiznet_spi_pio_transfer_wait(wiznet_spi_handle_t handle);
+
 #endif
@@ -0,0 +1,144 @@
+/**
+ * w5x00_socket_cache.c
+ * Jannis Lämmle
+ * Socket register snapshots with a shadow copy per poll tick, see w5x00_socket_cache.h
+ */
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Includes
+ * ----------------------------------------------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "wizchip_conf.h"
+#include "socket.h"
+#include "w5x00_socket_cache.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Offset of a socket register in the snapshot, the W5500 has the offset above the block select bits */
+#if (_WIZCHIP_ == W5500)
+#define SOCKET_REG_STEP 0x100
+#else
+#define SOCKET_REG_STEP 1
+#endif
+#define SOCKET_REG(reg) ((uint8_t)(((reg(0)) - (Sn_MR(0))) / SOCKET_REG_STEP))
+
+/* SPI frames of the ioLibrary getters, one per WIZCHIP_READ/WIZCHIP_READ_BUF */
+#define COST_SR 1
+#define COST_IR 1
+#define COST_RX_RSR_EMPTY 2 // Sn_RX_RSR is read twice as long as it is not zero
+#define COST_RX_RSR 4
+#define COST_DEST 3         // getSn_DIPR and the two bytes of getSn_DPORT
+
+_Static_assert(SOCKET_REG(Sn_RX_RSR) + 2 <= W5X00_SOCKET_SNAPSHOT_LEN, "Sn_RX_RSR outside of the snapshot");
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static uint8_t g_socket_regs[_WIZCHIP_SOCK_NUM_][W5X00_SOCKET_SNAPSHOT_LEN];
+static uint8_t g_socket_valid; // bit per socket
+
+static w5x00_socket_cache_stats_t g_socket_cache_stats;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void w5x00_socket_snapshot(uint8_t sn, uint8_t *regs)
+{
+    uint8_t *rsr = regs + SOCKET_REG(Sn_RX_RSR);
+    uint8_t again[2];
+
+    WIZCHIP_READ_BUF(Sn_MR(sn), regs, W5X00_SOCKET_SNAPSHOT_LEN);
+    g_socket_cache_stats.transactions++;
+
+    // Same check as getSn_RX_RSR(), but as a two byte burst
+    while (rsr[0] || rsr[1])
+    {
+        WIZCHIP_READ_BUF(Sn_RX_RSR(sn), again, sizeof(again));
+        g_socket_cache_stats.transactions++;
+        if (memcmp(rsr, again, sizeof(again)) == 0)
+        {
+            break;
+        }
+        memcpy(rsr, again, sizeof(again));
+    }
+}
+
+void w5x00_socket_cache_tick(void)
+{
+    g_socket_valid = 0;
+    g_socket_cache_stats.ticks++;
+}
+
+void w5x00_socket_cache_invalidate(uint8_t sn)
+{
+    g_socket_valid &= ~(1u << sn);
+}
+
+static const uint8_t *socket_cache_regs(uint8_t sn, uint32_t replaced)
+{
+    if (!(g_socket_valid & (1u << sn)))
+    {
+        w5x00_socket_snapshot(sn, g_socket_regs[sn]);
+        g_socket_valid |= 1u << sn;
+    }
+    g_socket_cache_stats.replaced += replaced;
+    return g_socket_regs[sn];
+}
+
+uint8_t w5x00_socket_cache_sr(uint8_t sn)
+{
+    return socket_cache_regs(sn, COST_SR)[SOCKET_REG(Sn_SR)];
+}
+
+uint8_t w5x00_socket_cache_ir(uint8_t sn)
+{
+    return socket_cache_regs(sn, COST_IR)[SOCKET_REG(Sn_IR)];
+}
+
+uint16_t w5x00_socket_cache_rx_rsr(uint8_t sn)
+{
+    const uint8_t *regs = socket_cache_regs(sn, 0);
+    uint16_t rsr = (uint16_t)regs[SOCKET_REG(Sn_RX_RSR)] << 8 | regs[SOCKET_REG(Sn_RX_RSR) + 1];
+
+    g_socket_cache_stats.replaced += rsr ? COST_RX_RSR : COST_RX_RSR_EMPTY;
+    return rsr;
+}
+
+void w5x00_socket_cache_dest(uint8_t sn, uint8_t *ip, uint16_t *port)
+{
+    const uint8_t *regs = socket_cache_regs(sn, COST_DEST);
+
+    memcpy(ip, regs + SOCKET_REG(Sn_DIPR), 4);
+    *port = (uint16_t)regs[SOCKET_REG(Sn_DPORT)] << 8 | regs[SOCKET_REG(Sn_DPORT) + 1];
+}
+
+void w5x00_socket_cache_clear_ir(uint8_t sn, uint8_t mask)
+{
+    setSn_IR(sn, mask);
+    g_socket_regs[sn][SOCKET_REG(Sn_IR)] &= ~mask;
+}
+
+void w5x00_socket_cache_count_skipped(uint32_t transactions)
+{
+    g_socket_cache_stats.replaced += transactions;
+}
+
+const w5x00_socket_cache_stats_t *w5x00_socket_cache_get_stats(void)
+{
+    return &g_socket_cache_stats;
+}
+
+void w5x00_socket_cache_reset_stats(void)
+{
+    memset(&g_socket_cache_stats, 0, sizeof(g_socket_cache_stats));
+}
@@ -12,13 +12,17 @@
 #include <stdio.h>
 
 #include "port_common.h"
+#include "pico/mutex.h"
 
 #include "wizchip_conf.h"
 #include "w5x00_spi.h"
 #include "board_list.h"
+#include "trace.h"
 
 #if (DEVICE_BOARD_NAME == W55RP20_EVB_PICO)
 #include "wiznet_spi_pio.h"
+#else
+#include "spi_bus.h"
 #endif
 
 /**
@@ -32,13 +36,15 @@
  * Variables
  * ----------------------------------------------------------------------------------------------------
  */
+#if WIZCHIP_LOCK_MASKS_IRQ
 static critical_section_t g_wizchip_cri_sec;
+#else
+static mutex_t g_wizchip_mutex;
+#endif
 
-#ifdef USE_SPI_DMA
-static uint dma_tx;
-static uint dma_rx;
-static dma_channel_config dma_channel_config_tx;
-static dma_channel_config dma_channel_config_rx;
+#ifndef USE_SPI_PIO
+// The W5x00 comes first on a shared bus, e.g. with the display
+static spi_bus_device_t g_wizchip_spi;
 #endif
 
 
@@ -62,15 +68,19 @@ wiznet_spi_handle_t spi_handle;
  * Functions
  * ----------------------------------------------------------------------------------------------------
  */
+#ifndef USE_SPI_PIO
 static inline void wizchip_select(void)
 {
-    gpio_put(PIN_CS, 0);
+    TRACE_BEGIN(SPI_FRAME, 0);
+    spi_bus_acquire(&g_wizchip_spi);
 }
 
 static inline void wizchip_deselect(void)
 {
-    gpio_put(PIN_CS, 1);
+    spi_bus_release(&g_wizchip_spi);
+    TRACE_END(SPI_FRAME, 0);
 }
+#endif
 
 void wizchip_reset()
 {
@@ -97,77 +107,46 @@ void wizchip_reset()
 static uint8_t wizchip_read(void)
 {
     uint8_t rx_data = 0;
-    uint8_t tx_data = 0xFF;
 
-    spi_read_blocking(SPI_PORT, tx_data, &rx_data, 1);
+    spi_bus_read(&g_wizchip_spi, 0xFF, &rx_data, 1);
 
     return rx_data;
 }
 
 static void wizchip_write(uint8_t tx_data)
 {
-    spi_write_blocking(SPI_PORT, &tx_data, 1);
+    spi_bus_write(&g_wizchip_spi, &tx_data, 1);
 }
 
 #ifdef USE_SPI_DMA
 static void wizchip_read_burst(uint8_t *pBuf, uint16_t len)
 {
-    uint8_t dummy_data = 0xFF;
-
-    channel_config_set_read_increment(&dma_channel_config_tx, false);
-    channel_config_set_write_increment(&dma_channel_config_tx, false);
-    dma_channel_configure(dma_tx, &dma_channel_config_tx,
-                          &spi_get_hw(SPI_PORT)->dr, // write address
-                          &dummy_data,               // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, true);
-    dma_channel_configure(dma_rx, &dma_channel_config_rx,
-                          pBuf,                      // write address
-                          &spi_get_hw(SPI_PORT)->dr, // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
-    dma_channel_wait_for_finish_blocking(dma_rx);
+    spi_bus_read(&g_wizchip_spi, 0xFF, pBuf, len);
 }
 
 static void wizchip_write_burst(uint8_t *pBuf, uint16_t len)
 {
-    uint8_t dummy_data;
-
-    channel_config_set_read_increment(&dma_channel_config_tx, true);
-    channel_config_set_write_increment(&dma_channel_config_tx, false);
-    dma_channel_configure(dma_tx, &dma_channel_config_tx,
-                          &spi_get_hw(SPI_PORT)->dr, // write address
-                          pBuf,                      // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, false);
-    dma_channel_configure(dma_rx, &dma_channel_config_rx,
-                          &dummy_data,               // write address
-                          &spi_get_hw(SPI_PORT)->dr, // read address
-                          len,                       // element count (each element is of size transfer_data_size)
-                          false);                    // don't start yet
-
-    dma_start_channel_mask((1u << dma_tx) | (1u << dma_rx));
-    dma_channel_wait_for_finish_blocking(dma_rx);
+    spi_bus_write(&g_wizchip_spi, pBuf, len);
 }
 #endif
 #endif
 
 static void wizchip_critical_section_lock(void)
 {
+#if WIZCHIP_LOCK_MASKS_IRQ
     critical_section_enter_blocking(&g_wizchip_cri_sec);
+#else
+    mutex_enter_blocking(&g_wizchip_mutex);
+#endif
 }
 
 static void wizchip_critical_section_unlock(void)
 {
+#if WIZCHIP_LOCK_MASKS_IRQ
     critical_section_exit(&g_wizchip_cri_sec);
+#else
+    mutex_exit(&g_wizchip_mutex);
+#endif
 }
 
 void wizchip_spi_initialize(void)
@@ -177,47 +156,34 @@ void wizchip_spi_initialize(void)
     (*spi_handle)->set_active(spi_handle);
 
 #else
-    // this example will use SPI0 at 5MHz
-    spi_init(SPI_PORT, 5000 * 1000);
-
-    gpio_set_function(PIN_SCK, GPIO_FUNC_SPI);
-    gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
-    gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
+    // this example will use SPI0 at 5MHz, the bus also serves the DMA bursts
+    static const spi_bus_device_config_t config = {
+        .cs_pin = PIN_CS,
+        .baudrate = 5000 * 1000,
+        .cpol = SPI_CPOL_0,
+        .cpha = SPI_CPHA_0,
+        .priority = 0,
+    };
+    spi_bus_t *bus = spi_bus_init(SPI_PORT, PIN_SCK, PIN_MOSI, PIN_MISO);
 
     // make the SPI pins available to picotool
     bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
 
-    // chip select is active-low, so we'll initialise it to a driven-high state
-    gpio_init(PIN_CS);
-    gpio_set_dir(PIN_CS, GPIO_OUT);
-    gpio_put(PIN_CS, 1);
+    // chip select is active-low, the bus initialises it to a driven-high state
+    spi_bus_add_device(bus, &g_wizchip_spi, &config);
 
     // make the SPI pins available to picotool
     bi_decl(bi_1pin_with_name(PIN_CS, "W5x00 CHIP SELECT"));
-
-#ifdef USE_SPI_DMA
-    dma_tx = dma_claim_unused_channel(true);
-    dma_rx = dma_claim_unused_channel(true);
-
-    dma_channel_config_tx = dma_channel_get_default_config(dma_tx);
-    channel_config_set_transfer_data_size(&dma_channel_config_tx, DMA_SIZE_8);
-    channel_config_set_dreq(&dma_channel_config_tx, DREQ_SPI0_TX);
-
-    // We set the inbound DMA to transfer from the SPI receive FIFO to a memory buffer paced by the SPI RX FIFO DREQ
-    // We coinfigure the read address to remain unchanged for each element, but the write
-    // address to increment (so data is written throughout the buffer)
-    dma_channel_config_rx = dma_channel_get_default_config(dma_rx);
-    channel_config_set_transfer_data_size(&dma_channel_config_rx, DMA_SIZE_8);
-    channel_config_set_dreq(&dma_channel_config_rx, DREQ_SPI0_RX);
-    channel_config_set_read_increment(&dma_channel_config_rx, false);
-    channel_config_set_write_increment(&dma_channel_config_rx, true);
-#endif
 #endif
 }
 
 void wizchip_cris_initialize(void)
 {
+#if WIZCHIP_LOCK_MASKS_IRQ
     critical_section_init(&g_wizchip_cri_sec);
+#else
+    mutex_init(&g_wizchip_mutex);
+#endif
     reg_wizchip_cris_cbfunc(wizchip_critical_section_lock, wizchip_critical_section_unlock);
 }
 
@@ -232,9 +198,6 @@ void wizchip_initialize(void)
     reg_wizchip_cs_cbfunc((*spi_handle)->frame_start, (*spi_handle)->frame_end);
 #else
 
-    /* Deselect the FLASH : chip select high */
-    wizchip_deselect();
-
     /* CS function register */
     reg_wizchip_cs_cbfunc(wizchip_select, wizchip_deselect);
 
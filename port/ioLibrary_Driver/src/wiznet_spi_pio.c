@@ -12,8 +12,12 @@
 
 #include "hardware/dma.h"
 #include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
 #include "wiznet_spi_pio.h"
+#include "log.h"
+#include "trace.h"
 
 #include "wiznet_spi_pio.pio.h"
 
@@ -35,6 +39,24 @@
 // All wiznet spi operations must start with writing a 3 byte header
 #define SPI_HEADER_LEN 3
 
+// Up to this many bytes are put into the tx fifo by the cpu instead of the DMA
+#define PIO_SPI_TX_FIFO_DEPTH 4
+
+// Reads up to this length are copied from the rx fifo by the cpu, below it the DMA setup takes longer
+#ifndef PIO_SPI_CPU_RX_MAX
+#define PIO_SPI_CPU_RX_MAX 16
+#endif
+
+// A transfer not completed within this time is aborted, 2 KB take about 0.6 ms at the default clock
+#ifndef PIO_SPI_TIMEOUT_US
+#define PIO_SPI_TIMEOUT_US 10000
+#endif
+
+// Completion of asynchronous transfers is signalled on DMA_IRQ_0 + PIO_SPI_DMA_IRQ, shared with other users
+#ifndef PIO_SPI_DMA_IRQ
+#define PIO_SPI_DMA_IRQ 1
+#endif
+
 #ifndef PICO_WIZNET_SPI_PIO_INSTANCE_COUNT
 #define PICO_WIZNET_SPI_PIO_INSTANCE_COUNT 1
 #endif
@@ -46,16 +68,32 @@ typedef struct spi_pio_state {
     uint8_t pio_func_sel;
     int8_t pio_offset;
     int8_t pio_sm;
-    int8_t dma_out;
-    int8_t dma_in;
+    int8_t dma; // sends or receives, the cpu puts the spi header into the fifo
     uint8_t spi_header[SPI_HEADER_LEN];
     uint8_t spi_header_count;
+    // Built once in wiznet_spi_pio_open(), a transfer only writes them to the hardware
+    uint32_t dma_tx_ctrl;
+    uint32_t dma_rx_ctrl;
+    uint32_t execctrl_write_read;
+    uint32_t execctrl_write;
+    uint32_t ctrl_restart;
+    uint16_t jmp_write_read;
+    uint16_t jmp_write;
+    // Transfer in progress, transfer_result is WIZNET_SPI_PIO_BUSY until it ends
+    volatile int transfer_result;
+    bool transfer_tx_only;
+    uint32_t transfer_length;
+    absolute_time_t transfer_deadline;
+    volatile alarm_id_t transfer_alarm;
+    wiznet_spi_pio_callback_t transfer_callback;
+    void *transfer_user_data;
 } spi_pio_state_t;
 static spi_pio_state_t spi_pio_state[PICO_WIZNET_SPI_PIO_INSTANCE_COUNT];
 static spi_pio_state_t *active_state;
 
 static void wiznet_spi_pio_close(wiznet_spi_handle_t funcs);
 static wiznet_spi_funcs_t *get_wiznet_spi_pio_impl(void);
+static void pio_spi_dma_irq_handler(void);
 
 // Initialise our gpios
 static void pio_spi_gpio_setup(spi_pio_state_t *state) {
@@ -102,8 +140,7 @@ wiznet_spi_handle_t wiznet_spi_pio_open(const wiznet_spi_config_t *spi_config) {
     }
 
     state->pio = pios[pio_index];
-    state->dma_in = -1;
-    state->dma_out = -1;
+    state->dma = -1;
 
     static_assert(GPIO_FUNC_PIO1 == GPIO_FUNC_PIO0 + 1, "");
     state->pio_func_sel = GPIO_FUNC_PIO0 + pio_index;
@@ -147,12 +184,39 @@ wiznet_spi_handle_t wiznet_spi_pio_open(const wiznet_spi_config_t *spi_config) {
 
     pio_sm_exec(state->pio, state->pio_sm, pio_encode_set(pio_pins, 1));
 
-    state->dma_out = (int8_t) dma_claim_unused_channel(false); // todo: Should be able to use one dma channel?
-    state->dma_in = (int8_t) dma_claim_unused_channel(false);
-    if (state->dma_out < 0 || state->dma_in < 0) {
+    state->dma = (int8_t) dma_claim_unused_channel(false);
+    if (state->dma < 0) {
         wiznet_spi_pio_close(&state->funcs);
         return NULL;
     }
+
+    dma_channel_config tx_config = dma_channel_get_default_config(state->dma);
+    channel_config_set_dreq(&tx_config, pio_get_dreq(state->pio, state->pio_sm, true));
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
+    state->dma_tx_ctrl = channel_config_get_ctrl_value(&tx_config);
+
+    dma_channel_config rx_config = dma_channel_get_default_config(state->dma);
+    channel_config_set_dreq(&rx_config, pio_get_dreq(state->pio, state->pio_sm, false));
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    state->dma_rx_ctrl = channel_config_get_ctrl_value(&rx_config);
+
+    const uint32_t execctrl = state->pio->sm[state->pio_sm].execctrl & ~(PIO_SM0_EXECCTRL_WRAP_TOP_BITS | PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS);
+    const uint32_t wrap_bottom = (uint32_t)(state->pio_offset + SPI_OFFSET_WRITE_BITS) << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB;
+    state->execctrl_write_read = execctrl | wrap_bottom | (uint32_t)(state->pio_offset + SPI_OFFSET_READ_END - 1) << PIO_SM0_EXECCTRL_WRAP_TOP_LSB;
+    state->execctrl_write = execctrl | wrap_bottom | (uint32_t)(state->pio_offset + SPI_OFFSET_WRITE_END - 1) << PIO_SM0_EXECCTRL_WRAP_TOP_LSB;
+    state->ctrl_restart = (1u << (PIO_CTRL_SM_RESTART_LSB + state->pio_sm)) | (1u << (PIO_CTRL_CLKDIV_RESTART_LSB + state->pio_sm));
+    state->jmp_write_read = (uint16_t)pio_encode_jmp(state->pio_offset);
+    state->jmp_write = (uint16_t)pio_encode_jmp(state->pio_offset + SPI_OFFSET_WRITE_BITS);
+
+    state->transfer_result = PICO_OK;
+    static bool irq_handler_added;
+    if (!irq_handler_added) {
+        irq_add_shared_handler(DMA_IRQ_0 + PIO_SPI_DMA_IRQ, pio_spi_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0 + PIO_SPI_DMA_IRQ, true);
+        irq_handler_added = true;
+    }
     return &state->funcs;
 }
 
@@ -165,13 +229,9 @@ static void wiznet_spi_pio_close(wiznet_spi_handle_t handle) {
 
             pio_sm_unclaim(state->pio, state->pio_sm);
         }
-        if (state->dma_out >= 0) {
-            dma_channel_unclaim(state->dma_out);
-            state->dma_out = -1;
-        }
-        if (state->dma_in >= 0) {
-            dma_channel_unclaim(state->dma_in);
-            state->dma_in = -1;
+        if (state->dma >= 0) {
+            dma_channel_unclaim(state->dma);
+            state->dma = -1;
         }
         state->funcs = NULL;
     }
@@ -210,99 +270,256 @@ static void wiznet_spi_pio_frame_end(void) {
 #endif
 }
 
-// send tx then receive rx
-// rx can be null if you just want to send, but tx and tx_length must be valid
-static bool pio_spi_transfer(spi_pio_state_t *state, const uint8_t *tx, size_t tx_length, uint8_t *rx, size_t rx_length) {
-    assert(state);
-    if (!state || (tx == NULL)) {
-        return false;
+// Stop the state machine and load it for the next transfer, x holds the bits to write, y the bytes to read
+static void pio_spi_setup(spi_pio_state_t *state, uint32_t execctrl, uint32_t x, uint32_t y, uint32_t jmp) {
+    pio_hw_t *pio = state->pio;
+    uint sm = (uint)state->pio_sm;
+
+    pio_sm_set_enabled(pio, sm, false);
+    pio->sm[sm].execctrl = execctrl;
+    // Every transfer drains the fifos, anything left is from an aborted one
+    if (!pio_sm_is_tx_fifo_empty(pio, sm) || !pio_sm_is_rx_fifo_empty(pio, sm)) {
+        pio_sm_clear_fifos(pio, sm);
+    }
+    hw_set_bits(&pio->ctrl, state->ctrl_restart);
+    pio_sm_put(pio, sm, x);
+    pio_sm_exec(pio, sm, pio_encode_out(pio_x, 32));
+    pio_sm_put(pio, sm, y);
+    pio_sm_exec(pio, sm, pio_encode_out(pio_y, 32));
+    pio_sm_exec(pio, sm, pio_encode_set(pio_pindirs, 1)); // data out, the read turns it around
+    pio_sm_exec(pio, sm, jmp);
+}
+
+// Data is left aligned in the tx fifo and right aligned in the rx fifo, as the 8 bit DMA accesses do
+static void pio_spi_fifo_put(spi_pio_state_t *state, const uint8_t *tx, size_t tx_length) {
+    for (size_t i = 0; i < tx_length; i++) {
+        state->pio->txf[state->pio_sm] = (uint32_t)tx[i] << 24;
     }
+}
 
-    if (rx != NULL && tx != NULL) {    
-        assert(tx && tx_length && rx_length);
-
-        pio_sm_set_enabled(state->pio, state->pio_sm, false); // disable sm
-        pio_sm_set_wrap(state->pio, state->pio_sm, state->pio_offset + SPI_OFFSET_WRITE_BITS, state->pio_offset + SPI_OFFSET_READ_END - 1); 
-        pio_sm_clear_fifos(state->pio, state->pio_sm); // clear fifos from previous run
-        pio_sm_set_pindirs_with_mask(state->pio, state->pio_sm, 1u << state->spi_config->data_out_pin, 1u << state->spi_config->data_out_pin);
-        pio_sm_restart(state->pio, state->pio_sm);
-        pio_sm_clkdiv_restart(state->pio, state->pio_sm);
-        pio_sm_put(state->pio, state->pio_sm, tx_length * 8 - 1); // set x
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_out(pio_x, 32));
-        pio_sm_put(state->pio, state->pio_sm, rx_length - 1); // set y
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_out(pio_y, 32));
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_jmp(state->pio_offset)); // setup pc
-        dma_channel_abort(state->dma_out);
-        dma_channel_abort(state->dma_in);
-
-        dma_channel_config out_config = dma_channel_get_default_config(state->dma_out);
-        channel_config_set_dreq(&out_config, pio_get_dreq(state->pio, state->pio_sm, true));
-        channel_config_set_transfer_data_size(&out_config, DMA_SIZE_8);
-        dma_channel_configure(state->dma_out, &out_config, &state->pio->txf[state->pio_sm], tx, tx_length, true);
-
-        dma_channel_config in_config = dma_channel_get_default_config(state->dma_in);
-        channel_config_set_dreq(&in_config, pio_get_dreq(state->pio, state->pio_sm, false));
-        channel_config_set_write_increment(&in_config, true);
-        channel_config_set_read_increment(&in_config, false);
-        channel_config_set_transfer_data_size(&in_config, DMA_SIZE_8);
-        dma_channel_configure(state->dma_in, &in_config, rx, &state->pio->rxf[state->pio_sm], rx_length, true);
-
-        pio_sm_set_enabled(state->pio, state->pio_sm, true);
-        __compiler_memory_barrier();
-
-        dma_channel_wait_for_finish_blocking(state->dma_out);
-        dma_channel_wait_for_finish_blocking(state->dma_in);
-
-        __compiler_memory_barrier();
-    } else if (tx != NULL) {
-        assert(tx_length);
+static bool pio_spi_fifo_get(spi_pio_state_t *state, uint8_t *rx, size_t rx_length) {
+    for (size_t i = 0; i < rx_length; i++) {
+        while (pio_sm_is_rx_fifo_empty(state->pio, state->pio_sm)) {
+            if (time_reached(state->transfer_deadline)) {
+                return false;
+            }
+            tight_loop_contents();
+        }
+        rx[i] = (uint8_t)state->pio->rxf[state->pio_sm];
+    }
+    return true;
+}
 
+static void pio_spi_dma_start(int8_t channel, uint32_t ctrl, volatile const void *read_addr, volatile void *write_addr, size_t length) {
+    dma_channel_hw_t *hw = dma_channel_hw_addr(channel);
+    hw->read_addr = (uintptr_t)read_addr;
+    hw->write_addr = (uintptr_t)write_addr;
+    hw->transfer_count = length;
+    hw->ctrl_trig = ctrl;
+}
+
+// Whether the hardware finished the transfer, polled by the blocking path whether interrupts are enabled or not
+static bool pio_spi_hw_done(spi_pio_state_t *state) {
+    if (state->transfer_tx_only) {
+        // The last bits are shifted out after the DMA finished, until the state machine stalls on the empty fifo
+        return !dma_channel_is_busy(state->dma) &&
+               (state->pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + state->pio_sm)));
+    }
+    return !dma_channel_is_busy(state->dma);
+}
+
+// End the transfer once, from the DMA interrupt, the timeout alarm or a poll
+static void pio_spi_finish(spi_pio_state_t *state, int result) {
+    uint32_t save = save_and_disable_interrupts();
+    if (state->transfer_result != WIZNET_SPI_PIO_BUSY) {
+        restore_interrupts(save);
+        return;
+    }
+
+    dma_irqn_set_channel_enabled(PIO_SPI_DMA_IRQ, state->dma, false);
+    if (result != PICO_OK) {
+        dma_channel_abort(state->dma);
         pio_sm_set_enabled(state->pio, state->pio_sm, false);
-        pio_sm_set_wrap(state->pio, state->pio_sm, state->pio_offset + SPI_OFFSET_WRITE_BITS, state->pio_offset + SPI_OFFSET_WRITE_END - 1);
         pio_sm_clear_fifos(state->pio, state->pio_sm);
-        pio_sm_restart(state->pio, state->pio_sm);
-        pio_sm_clkdiv_restart(state->pio, state->pio_sm);
-        pio_sm_put(state->pio, state->pio_sm, tx_length * 8 - 1);
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_out(pio_x, 32));
-        pio_sm_put(state->pio, state->pio_sm, tx_length - 1);
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_out(pio_y, 32));
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_set(pio_pins, 0));
-        pio_sm_set_consecutive_pindirs(state->pio, state->pio_sm, state->spi_config->data_out_pin, 1, true);
-        pio_sm_exec(state->pio, state->pio_sm, pio_encode_jmp(state->pio_offset + SPI_OFFSET_WRITE_BITS));
-        dma_channel_abort(state->dma_out);
-
-        dma_channel_config out_config = dma_channel_get_default_config(state->dma_out);
-        channel_config_set_dreq(&out_config, pio_get_dreq(state->pio, state->pio_sm, true));
-
-        channel_config_set_transfer_data_size(&out_config, DMA_SIZE_8);
-        dma_channel_configure(state->dma_out, &out_config, &state->pio->txf[state->pio_sm], tx, tx_length, true);
-
-        const uint32_t fDebugTxStall = 1u << (PIO_FDEBUG_TXSTALL_LSB + state->pio_sm);
-        state->pio->fdebug = fDebugTxStall;
-        pio_sm_set_enabled(state->pio, state->pio_sm, true);
-        while (!(state->pio->fdebug & fDebugTxStall)) {
-            tight_loop_contents(); // todo timeout
-        }
-        __compiler_memory_barrier();
+    } else if (state->transfer_tx_only) {
         pio_sm_set_enabled(state->pio, state->pio_sm, false);
-        pio_sm_set_consecutive_pindirs(state->pio, state->pio_sm, state->spi_config->data_in_pin, 1, false);
-    } else if (rx != NULL) {
-        panic_unsupported(); // shouldn't be used
     }
+    dma_irqn_acknowledge_channel(PIO_SPI_DMA_IRQ, state->dma);
     pio_sm_exec(state->pio, state->pio_sm, pio_encode_mov(pio_pins, pio_null)); // for next time we turn output on
+    state->transfer_result = result;
 
-    return true;
+    alarm_id_t alarm = state->transfer_alarm;
+    state->transfer_alarm = 0;
+    restore_interrupts(save);
+
+    if (alarm > 0) {
+        cancel_alarm(alarm);
+    }
+    if (result != PICO_OK) {
+        LOG(SPI_PIO_TIMEOUT, state->transfer_length);
+    }
+    TRACE_END(PIO_SPI_TRANSFER, state->transfer_length);
+    if (state->transfer_callback) {
+        state->transfer_callback(&state->funcs, result, state->transfer_user_data);
+    }
+}
+
+static int64_t pio_spi_timeout_alarm(alarm_id_t id, void *user_data) {
+    spi_pio_state_t *state = (spi_pio_state_t *)user_data;
+    state->transfer_alarm = 0;
+    pio_spi_finish(state, PICO_ERROR_TIMEOUT);
+    return 0;
+}
+
+static void __isr pio_spi_dma_irq_handler(void) {
+    for (int i = 0; i < count_of(spi_pio_state); i++) {
+        spi_pio_state_t *state = &spi_pio_state[i];
+        if (!state->funcs || state->transfer_result != WIZNET_SPI_PIO_BUSY ||
+            !dma_irqn_get_channel_status(PIO_SPI_DMA_IRQ, state->dma)) {
+            continue;
+        }
+        dma_irqn_acknowledge_channel(PIO_SPI_DMA_IRQ, state->dma);
+        // At most the fifo and the shift register are left to send
+        while (!pio_spi_hw_done(state) && !time_reached(state->transfer_deadline)) {
+            tight_loop_contents();
+        }
+        pio_spi_finish(state, pio_spi_hw_done(state) ? PICO_OK : PICO_ERROR_TIMEOUT);
+    }
+}
+
+// send the stashed spi header and tx, then receive rx, all in one frame
+// rx can be null if you just want to send, tx can be null if the header is all there is to send
+// The header and short sends are put into the tx fifo before the state machine starts, short reads are
+// copied by the cpu (unless dma is set), the rest is done by the DMA channel and completes in pio_spi_hw_done().
+// As the channel either sends or receives, everything sent before a read has to fit the fifo.
+static int pio_spi_start(spi_pio_state_t *state, const uint8_t *tx, size_t tx_length, uint8_t *rx, size_t rx_length, bool dma,
+                         wiznet_spi_pio_callback_t callback, void *user_data) {
+    if (!state || (tx == NULL && tx_length) || (rx != NULL && !rx_length)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    size_t head_length = state->spi_header_count;
+    size_t out_length = head_length + tx_length;
+    bool tx_fifo = out_length <= PIO_SPI_TX_FIFO_DEPTH && !(dma && rx == NULL); // else a send could only end by polling
+    if (!out_length || (rx != NULL && !tx_fifo)) {
+        return PICO_ERROR_INVALID_ARG;
+    }
+    if (state->transfer_result == WIZNET_SPI_PIO_BUSY) {
+        return PICO_ERROR_RESOURCE_IN_USE;
+    }
+    TRACE_BEGIN(PIO_SPI_TRANSFER, out_length + rx_length);
+
+    state->spi_header_count = 0;
+    state->transfer_tx_only = (rx == NULL);
+    state->transfer_length = out_length + rx_length;
+    state->transfer_deadline = make_timeout_time_us(PIO_SPI_TIMEOUT_US);
+    state->transfer_callback = callback;
+    state->transfer_user_data = user_data;
+    state->transfer_result = WIZNET_SPI_PIO_BUSY;
+    if (callback) {
+        dma_irqn_acknowledge_channel(PIO_SPI_DMA_IRQ, state->dma);
+        dma_irqn_set_channel_enabled(PIO_SPI_DMA_IRQ, state->dma, true);
+    }
+
+    if (rx != NULL) {
+        pio_spi_setup(state, state->execctrl_write_read, out_length * 8 - 1, rx_length - 1, state->jmp_write_read);
+    } else {
+        pio_spi_setup(state, state->execctrl_write, out_length * 8 - 1, out_length - 1, state->jmp_write);
+        state->pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + state->pio_sm);
+    }
+
+    pio_spi_fifo_put(state, state->spi_header, head_length);
+    if (tx_fifo) {
+        pio_spi_fifo_put(state, tx, tx_length);
+    } else {
+        // Paced by the DREQ, the payload follows the header in the fifo
+        pio_spi_dma_start(state->dma, state->dma_tx_ctrl, tx, &state->pio->txf[state->pio_sm], tx_length);
+    }
+    if (rx != NULL && (dma || rx_length > PIO_SPI_CPU_RX_MAX)) {
+        pio_spi_dma_start(state->dma, state->dma_rx_ctrl, &state->pio->rxf[state->pio_sm], rx, rx_length);
+    }
+
+    __compiler_memory_barrier();
+    pio_sm_set_enabled(state->pio, state->pio_sm, true);
+    return PICO_OK;
+}
+
+static int pio_spi_poll(spi_pio_state_t *state) {
+    if (state->transfer_result == WIZNET_SPI_PIO_BUSY) {
+        if (pio_spi_hw_done(state)) {
+            __compiler_memory_barrier();
+            pio_spi_finish(state, PICO_OK);
+        } else if (time_reached(state->transfer_deadline)) {
+            pio_spi_finish(state, PICO_ERROR_TIMEOUT);
+        }
+    }
+    return state->transfer_result;
+}
+
+// Blocking transfer of the ioLibrary. Its end is not signalled by the DMA interrupt, pio_spi_poll() checks
+// pio_spi_hw_done() against the deadline, so it is correct with interrupts enabled (the default mutex lock)
+// as well as masked (WIZCHIP_LOCK_MASKS_IRQ)
+static bool pio_spi_transfer(spi_pio_state_t *state, const uint8_t *tx, size_t tx_length, uint8_t *rx, size_t rx_length) {
+    assert(state);
+    if (pio_spi_start(state, tx, tx_length, rx, rx_length, false, NULL, NULL) != PICO_OK) {
+        state->spi_header_count = 0;
+        return false;
+    }
+
+    if (rx != NULL && rx_length <= PIO_SPI_CPU_RX_MAX) {
+        // Stalls on a full rx fifo while the cpu is not reading
+        if (!pio_spi_fifo_get(state, rx, rx_length)) {
+            pio_spi_finish(state, PICO_ERROR_TIMEOUT);
+        }
+    }
+
+    int result;
+    while ((result = pio_spi_poll(state)) == WIZNET_SPI_PIO_BUSY) {
+        tight_loop_contents();
+    }
+    return result == PICO_OK;
+}
+
+int wiznet_spi_pio_transfer_async(wiznet_spi_handle_t handle, const uint8_t *tx, size_t tx_length, uint8_t *rx, size_t rx_length,
+                                  wiznet_spi_pio_callback_t callback, void *user_data) {
+    spi_pio_state_t *state = (spi_pio_state_t *)handle;
+    int result = pio_spi_start(state, tx, tx_length, rx, rx_length, true, callback, user_data);
+    if (result != PICO_OK || !callback) {
+        return result;
+    }
+
+    // A negative id means no alarm was free, the transfer then only ends by the DMA
+    alarm_id_t alarm = add_alarm_in_us(PIO_SPI_TIMEOUT_US, pio_spi_timeout_alarm, state, true);
+    uint32_t save = save_and_disable_interrupts();
+    if (state->transfer_result == WIZNET_SPI_PIO_BUSY) {
+        state->transfer_alarm = alarm;
+        alarm = 0;
+    }
+    restore_interrupts(save);
+    if (alarm > 0) {
+        cancel_alarm(alarm); // already ended
+    }
+    return PICO_OK;
+}
+
+int wiznet_spi_pio_transfer_poll(wiznet_spi_handle_t handle) {
+    return pio_spi_poll((spi_pio_state_t *)handle);
+}
+
+int wiznet_spi_pio_transfer_wait(wiznet_spi_handle_t handle) {
+    int result;
+    while ((result = wiznet_spi_pio_transfer_poll(handle)) == WIZNET_SPI_PIO_BUSY) {
+        tight_loop_contents();
+    }
+    return result;
 }
 
 // To read a byte we must first have been asked to write a 3 byte spi header
+// A failed transfer was logged, the ioLibrary has no way to report it
 static uint8_t wiznet_spi_pio_read_byte(void) {
     assert(active_state);    
     assert(active_state->spi_header_count == SPI_HEADER_LEN);
-    uint8_t ret;
-    if (!pio_spi_transfer(active_state, active_state->spi_header, active_state->spi_header_count, &ret, 1)) {
-        panic("spi failed read");
-    }
-    active_state->spi_header_count = 0;
+    uint8_t ret = 0;
+    pio_spi_transfer(active_state, NULL, 0, &ret, 1);
     return ret;
 }
 
@@ -316,13 +533,10 @@ static void wiznet_spi_pio_read_buffer(uint8_t* pBuf, uint16_t len) {
 
     assert(active_state);
     assert(active_state->spi_header_count == SPI_HEADER_LEN);
-    if (!pio_spi_transfer(active_state, active_state->spi_header, active_state->spi_header_count, pBuf, len)) {
-        panic("spi failed reading buffer");
-    }
-    active_state->spi_header_count = 0;
+    pio_spi_transfer(active_state, NULL, 0, pBuf, len);
 }
 
-// If we have been asked to write a spi header already, then write it and the rest of the buffer
+// If we have been asked to write a spi header already, then write it and the rest of the buffer in one frame
 // or else if we've been given enough data for just the spi header, save it until the next call
 // or we're writing a byte in which case we're given a buffer including the spi header
 static void wiznet_spi_pio_write_buffer(uint8_t* pBuf, uint16_t len) {
@@ -331,16 +545,7 @@ static void wiznet_spi_pio_write_buffer(uint8_t* pBuf, uint16_t len) {
         memcpy(active_state->spi_header, pBuf, SPI_HEADER_LEN); // expect another call
         active_state->spi_header_count = SPI_HEADER_LEN;
     } else {
-        if (active_state->spi_header_count == SPI_HEADER_LEN) {
-            if (!pio_spi_transfer(active_state, active_state->spi_header, SPI_HEADER_LEN, NULL, 0)) {
-                panic("spi failed writing header");
-            }
-            active_state->spi_header_count = 0;
-        }
-        assert(active_state->spi_header_count == 0);
-        if (!pio_spi_transfer(active_state, pBuf, len, NULL, 0)) {
-            panic("spi failed writing buffer");
-        }
+        pio_spi_transfer(active_state, pBuf, len, NULL, 0);
     }
 }
 
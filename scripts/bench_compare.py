@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Compare two captures of the AlphaESS_bench output (bench/bench.h)
+#
+#   bench_compare.py before.txt after.txt
+#
+# Prints ns_avg (or value, for cases that are not timed) of both runs and the
+# change per case, cases only present in one capture or skipped are listed as
+# such. Lines not starting with
+# "bench case=" are ignored, so a complete serial log can be used. Exits with
+# 1 if a case got slower than --threshold percent.
+
+import argparse
+import sys
+
+def parse(path):
+    cases = {}
+    info = {}
+    with open(path) as f:
+        for line in f:
+            idx = line.find('bench ')
+            if idx < 0:
+                continue
+            fields = dict(kv.split('=', 1) for kv in line[idx + 6:].split() if '=' in kv)
+            if 'case' in fields:
+                cases[fields['case']] = fields
+                info = {'target': fields.get('target', '?'), 'rev': fields.get('rev', '?')}
+    return cases, info
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('before')
+    parser.add_argument('after')
+    parser.add_argument('--threshold', type=float, default=None,
+                        help='fail if a case is slower by more than this many percent')
+    args = parser.parse_args()
+
+    before, before_info = parse(args.before)
+    after, after_info = parse(args.after)
+
+    if before_info.get('target') != after_info.get('target'):
+        print('warning: comparing target %s with %s' % (before_info.get('target'), after_info.get('target')),
+              file=sys.stderr)
+
+    print('%-28s %14s %14s %9s' % ('case', before_info.get('rev', '?'), after_info.get('rev', '?'), 'change'))
+    regressed = False
+    for name in list(before) + [n for n in after if n not in before]:
+        b = before.get(name, {})
+        a = after.get(name, {})
+        key = 'ns_avg' if 'ns_avg' in b else 'value'
+        if key not in b or key not in a:
+            state = lambda c: c.get('skipped', 'missing') if key not in c else c[key]
+            print('%-28s %14s %14s %9s' % (name, state(b), state(a), '-'))
+            continue
+        old = int(b[key])
+        new = int(a[key])
+        change = (new - old) * 100.0 / old if old else 0.0
+        print('%-28s %14d %14d %+8.1f%%' % (name, old, new, change))
+        if args.threshold is not None and change > args.threshold:
+            regressed = True
+
+    return 1 if regressed else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+# Generate the flat CAN decode tables of src/canData.c from a DBC signal description
+#
+# Only the signals mapped to a power_data_t field end up in flash, the DBC is not
+# parsed on the device. Usage:
+#
+#   dbc_gen.py --dbc dbc/local.dbc --out-c can_signals.c --out-h can_signals.h \
+#       --map BMS_SOC:soc:10 --map INV_PV_Power:ppv:1000 ...
+#
+# Each --map is signal:field:scale, field one of ppv, pload, pgrid, pbat, soc and
+# scale the factor from the physical value of the signal to the unit of the field
+# (W, soc in 0.1 %), negative to flip the sign convention.
+#
+# Table format: messages sorted by id, each with the range of its signals. A signal
+# is read from the frame data taken as one little (Intel) or big (Motorola) endian
+# 64 bit number, shifted down by 'shift', and scaled as raw * num / den + offset.
+
+import argparse
+import fractions
+import os
+import re
+import sys
+
+
+FIELDS = ['ppv', 'pload', 'pgrid', 'pbat', 'soc']
+
+CAN2040_ID_EFF = 1 << 31
+DBC_ID_EXTENDED = 1 << 31
+
+RE_MESSAGE = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+\w+')
+RE_SIGNAL = re.compile(r'^SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+                       r'\(\s*([-+.\deE]+)\s*,\s*([-+.\deE]+)\s*\)\s*\[[^\]]*\]\s*"([^"]*)"')
+
+
+######################################################################
+# DBC
+######################################################################
+
+def parse_dbc(path):
+    messages = {}
+    message = None
+    with open(path, encoding='latin-1') as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            match = RE_MESSAGE.match(line)
+            if match:
+                dbc_id, name, dlc = int(match.group(1)), match.group(2), int(match.group(3))
+                if dbc_id & DBC_ID_EXTENDED:
+                    can_id = CAN2040_ID_EFF | (dbc_id & 0x1fffffff)
+                else:
+                    can_id = dbc_id & 0x7ff
+                message = {'name': name, 'id': can_id, 'dlc': dlc, 'signals': {}}
+                messages[name] = message
+                continue
+            if not line.startswith('SG_'):
+                if line:
+                    message = None
+                continue
+            match = RE_SIGNAL.match(line)
+            if not match or message is None:
+                sys.exit('dbc_gen: %s:%d: can not parse signal' % (path, number))
+            name, mux, start, length, order, sign, factor, offset, unit = match.groups()
+            message['signals'][name] = {
+                'name': name,
+                'multiplexed': mux is not None and mux != 'M',
+                'start': int(start),
+                'length': int(length),
+                'big_endian': order == '0',
+                'signed': sign == '-',
+                'factor': fractions.Fraction(factor),
+                'offset': fractions.Fraction(offset),
+                'unit': unit,
+            }
+    return messages
+
+
+# Shift of the least significant bit in the frame data read as one 64 bit number
+def signal_shift(signal, dlc):
+    start, length = signal['start'], signal['length']
+    if not signal['big_endian']:
+        lsb = start
+        msb = start + length - 1
+        if msb >= dlc * 8:
+            return None
+        return lsb
+    # Motorola: start is the most significant bit, counted 7..0 within each byte
+    msb = (start // 8) * 8 + (7 - start % 8)
+    lsb = msb + length - 1
+    if lsb >= dlc * 8:
+        return None
+    return 63 - lsb
+
+
+######################################################################
+# Tables
+######################################################################
+
+def build(messages, maps):
+    used = {}
+    for spec in maps:
+        try:
+            name, field, scale = spec.split(':')
+            scale = fractions.Fraction(scale)
+        except ValueError:
+            sys.exit('dbc_gen: bad --map %r, expected signal:field:scale' % spec)
+        if field not in FIELDS:
+            sys.exit('dbc_gen: unknown field %r (%s)' % (field, ', '.join(FIELDS)))
+        owner = [m for m in messages.values() if name in m['signals']]
+        if len(owner) != 1:
+            sys.exit('dbc_gen: signal %s %s' % (name, 'not found' if not owner else 'is not unique'))
+        message, signal = owner[0], owner[0]['signals'][name]
+        if signal['multiplexed']:
+            sys.exit('dbc_gen: multiplexed signal %s is not supported' % name)
+        if not 1 <= signal['length'] <= 32:
+            sys.exit('dbc_gen: signal %s is longer than 32 bits' % name)
+        shift = signal_shift(signal, message['dlc'])
+        if shift is None:
+            sys.exit('dbc_gen: signal %s does not fit its message' % name)
+
+        gain = (signal['factor'] * scale).limit_denominator(10000)
+        offset = signal['offset'] * scale
+        if gain == 0 or offset.denominator != 1 or abs(gain.numerator) >= 1 << 31 or abs(offset) >= 1 << 31:
+            sys.exit('dbc_gen: signal %s can not be scaled to %s in integers' % (name, field))
+        used.setdefault(message['id'], (message, []))[1].append(
+            (signal, shift, FIELDS.index(field), gain, int(offset)))
+    return [used[can_id] for can_id in sorted(used)]
+
+
+def generate(table, dbc, out_c, out_h):
+    header = ['// Generated by scripts/dbc_gen.py from %s, do not edit' % dbc, '']
+    h = header + ['#ifndef CAN_SIGNALS_H_', '#define CAN_SIGNALS_H_', '', '#include "canData.h"', '']
+    c = header + ['#include "can_signals.h"', '']
+
+    message_lines, signal_lines = [], []
+    fields = 0
+    for message, signals in table:
+        message_lines.append('    {0x%08x, %d, %d, %d}, // %s' % (message['id'], message['dlc'], len(signal_lines),
+                                                                 len(signals), message['name']))
+        for signal, shift, field, gain, offset in signals:
+            flags = []
+            if signal['signed']:
+                flags.append('CAN_SIGNAL_SIGNED')
+            if signal['big_endian']:
+                flags.append('CAN_SIGNAL_BIG_ENDIAN')
+            signal_lines.append('    {%d, %d, %s, CAN_DATA_%s, %d, %d, %d}, // %s [%s]' % (
+                shift, signal['length'], ' | '.join(flags) or '0', FIELDS[field].upper(), gain.numerator,
+                gain.denominator, offset, signal['name'], signal['unit']))
+            fields |= 1 << field
+
+    c.append('static const can_message_t can_signal_messages[%d] = {' % max(len(message_lines), 1))
+    c.extend(message_lines)
+    c.append('};')
+    c.append('')
+    c.append('static const can_signal_t can_signal_signals[%d] = {' % max(len(signal_lines), 1))
+    c.extend(signal_lines)
+    c.append('};')
+    c.append('')
+    c.append('const can_signal_table_t can_signals = {')
+    c.append('    .message_count = %d,' % len(message_lines))
+    c.append('    .fields = 0x%02x,' % fields)
+    c.append('    .messages = can_signal_messages,')
+    c.append('    .signals = can_signal_signals,')
+    c.append('};')
+    c.append('')
+    h.append('extern const can_signal_table_t can_signals; // %d messages, %d signals' % (len(message_lines),
+                                                                                        len(signal_lines)))
+    h += ['', '#endif /* CAN_SIGNALS_H_ */', '']
+    with open(out_c, 'w') as f:
+        f.write('\n'.join(c))
+    with open(out_h, 'w') as f:
+        f.write('\n'.join(h))
+    return len(message_lines), len(signal_lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--dbc', required=True)
+    parser.add_argument('--out-c', required=True)
+    parser.add_argument('--out-h', required=True)
+    parser.add_argument('--map', action='append', required=True, help='signal:field:scale')
+    args = parser.parse_args()
+
+    table = build(parse_dbc(args.dbc), args.map)
+    if len(table) > 255:
+        sys.exit('dbc_gen: more than 255 messages')
+    messages, signals = generate(table, os.path.basename(args.dbc), args.out_c, args.out_h)
+    print('dbc_gen: %d messages, %d signals' % (messages, signals))
+
+
+if __name__ == '__main__':
+    main()
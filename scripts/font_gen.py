@@ -0,0 +1,400 @@
+#!/usr/bin/env python3
+# Generate run-length encoded glyph tables for the display from a TTF or BDF font
+#
+# Only the requested characters at the requested pixel heights end up in flash,
+# nothing is rasterized on the device. Usage:
+#
+#   font_gen.py --out-c font_data.c --out-h font_data.h \
+#       --font value:fonts/DejaVuSansMono-Bold.ttf:40:"0123456789-" ...
+#
+# Each --font is name:path:pixel_height:characters. For BDF fonts the pixel
+# height is ignored, the font is used at its native size.
+#
+# Glyph format: rows of the glyph bitmap are concatenated and stored as runs,
+# one byte per run, bit 7 set for foreground, bits 0-6 the run length (1-127).
+
+import argparse
+import math
+import os
+import struct
+import sys
+
+
+######################################################################
+# TrueType
+######################################################################
+
+class TrueType:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        num_tables = struct.unpack_from('>H', self.data, 4)[0]
+        self.tables = {}
+        for i in range(num_tables):
+            tag, _, offset, length = struct.unpack_from('>4sIII', self.data, 12 + 16 * i)
+            self.tables[tag.decode('latin-1')] = (offset, length)
+        head = self.tables['head'][0]
+        self.units_per_em = struct.unpack_from('>H', self.data, head + 18)[0]
+        self.loca_long = struct.unpack_from('>h', self.data, head + 50)[0] == 1
+        hhea = self.tables['hhea'][0]
+        self.ascent, self.descent = struct.unpack_from('>hh', self.data, hhea + 4)
+        self.num_hmetrics = struct.unpack_from('>H', self.data, hhea + 34)[0]
+        self.num_glyphs = struct.unpack_from('>H', self.data, self.tables['maxp'][0] + 4)[0]
+        self.cmap = self._read_cmap()
+
+    def _read_cmap(self):
+        base = self.tables['cmap'][0]
+        count = struct.unpack_from('>H', self.data, base + 2)[0]
+        for i in range(count):
+            platform, encoding, offset = struct.unpack_from('>HHI', self.data, base + 4 + 8 * i)
+            sub = base + offset
+            if struct.unpack_from('>H', self.data, sub)[0] == 4 and (platform, encoding) in ((3, 1), (0, 3), (0, 4)):
+                return self._read_cmap4(sub)
+        raise ValueError('no unicode cmap (format 4) found')
+
+    def _read_cmap4(self, sub):
+        seg_count = struct.unpack_from('>H', self.data, sub + 6)[0] // 2
+        ends = sub + 14
+        starts = ends + 2 * seg_count + 2
+        deltas = starts + 2 * seg_count
+        range_offsets = deltas + 2 * seg_count
+        mapping = {}
+        for s in range(seg_count):
+            end = struct.unpack_from('>H', self.data, ends + 2 * s)[0]
+            start = struct.unpack_from('>H', self.data, starts + 2 * s)[0]
+            delta = struct.unpack_from('>h', self.data, deltas + 2 * s)[0]
+            ro_pos = range_offsets + 2 * s
+            ro = struct.unpack_from('>H', self.data, ro_pos)[0]
+            for c in range(start, min(end, 0x7f) + 1):
+                if ro == 0:
+                    glyph = (c + delta) & 0xffff
+                else:
+                    glyph = struct.unpack_from('>H', self.data, ro_pos + ro + 2 * (c - start))[0]
+                    if glyph:
+                        glyph = (glyph + delta) & 0xffff
+                mapping[c] = glyph
+        return mapping
+
+    def advance(self, glyph):
+        hmtx = self.tables['hmtx'][0]
+        return struct.unpack_from('>H', self.data, hmtx + 4 * min(glyph, self.num_hmetrics - 1))[0]
+
+    def _glyph_range(self, glyph):
+        loca = self.tables['loca'][0]
+        if self.loca_long:
+            start, end = struct.unpack_from('>II', self.data, loca + 4 * glyph)
+        else:
+            start, end = (2 * v for v in struct.unpack_from('>HH', self.data, loca + 2 * glyph))
+        return self.tables['glyf'][0] + start, end - start
+
+    # Return contours as lists of (x, y, on_curve) in font units
+    def contours(self, glyph, depth=0):
+        pos, length = self._glyph_range(glyph)
+        if length == 0:
+            return []
+        num_contours = struct.unpack_from('>h', self.data, pos)[0]
+        if num_contours < 0:
+            return self._composite(pos + 10, depth)
+        end_points = struct.unpack_from('>%dH' % num_contours, self.data, pos + 10)
+        num_points = end_points[-1] + 1 if num_contours else 0
+        p = pos + 10 + 2 * num_contours
+        p += 2 + struct.unpack_from('>H', self.data, p)[0] # instructions
+        flags = []
+        while len(flags) < num_points:
+            flag = self.data[p]
+            p += 1
+            repeat = 0
+            if flag & 8:
+                repeat = self.data[p]
+                p += 1
+            flags.extend([flag] * (repeat + 1))
+        coords = []
+        for short_bit, same_bit in ((2, 16), (4, 32)):
+            values, v = [], 0
+            for flag in flags:
+                if flag & short_bit:
+                    d = self.data[p]
+                    p += 1
+                    v += d if flag & same_bit else -d
+                elif not flag & same_bit:
+                    v += struct.unpack_from('>h', self.data, p)[0]
+                    p += 2
+                values.append(v)
+            coords.append(values)
+        points = [(x, y, bool(f & 1)) for x, y, f in zip(coords[0], coords[1], flags)]
+        contours, start = [], 0
+        for end in end_points:
+            contours.append(points[start:end + 1])
+            start = end + 1
+        return contours
+
+    def _composite(self, p, depth):
+        contours = []
+        while depth < 8:
+            flags, glyph = struct.unpack_from('>HH', self.data, p)
+            p += 4
+            if flags & 1:
+                dx, dy = struct.unpack_from('>hh', self.data, p)
+                p += 4
+            else:
+                dx, dy = struct.unpack_from('>bb', self.data, p)
+                p += 2
+            scale = (1.0, 0.0, 0.0, 1.0)
+            if flags & 8:
+                s = struct.unpack_from('>h', self.data, p)[0] / 16384.0
+                scale = (s, 0.0, 0.0, s)
+                p += 2
+            elif flags & 0x40:
+                sx, sy = struct.unpack_from('>hh', self.data, p)
+                scale = (sx / 16384.0, 0.0, 0.0, sy / 16384.0)
+                p += 4
+            elif flags & 0x80:
+                scale = tuple(v / 16384.0 for v in struct.unpack_from('>hhhh', self.data, p))
+                p += 8
+            a, b, c, d = scale
+            for contour in self.contours(glyph, depth + 1):
+                contours.append([(a * x + c * y + dx, b * x + d * y + dy, on) for x, y, on in contour])
+            if not flags & 0x20:
+                break
+        return contours
+
+
+# Flatten quadratic contours into closed polygons
+def flatten(contour, steps=8):
+    if not contour:
+        return []
+    # Make sure the contour starts on an on-curve point
+    start = next((i for i, p in enumerate(contour) if p[2]), None)
+    if start is None:
+        a, b = contour[0], contour[1 % len(contour)]
+        contour = [((a[0] + b[0]) / 2, (a[1] + b[1]) / 2, True)] + contour
+        start = 0
+    pts = contour[start:] + contour[:start]
+    out = [(pts[0][0], pts[0][1])]
+    i, n = 1, len(pts)
+    while i <= n:
+        p = pts[i % n]
+        if p[2]:
+            out.append((p[0], p[1]))
+            i += 1
+            continue
+        nxt = pts[(i + 1) % n]
+        if nxt[2]:
+            end = (nxt[0], nxt[1])
+            i += 2
+        else:
+            end = ((p[0] + nxt[0]) / 2, (p[1] + nxt[1]) / 2)
+            i += 1
+        x0, y0 = out[-1]
+        for s in range(1, steps + 1):
+            t = s / steps
+            out.append(((1 - t) ** 2 * x0 + 2 * (1 - t) * t * p[0] + t * t * end[0],
+                        (1 - t) ** 2 * y0 + 2 * (1 - t) * t * p[1] + t * t * end[1]))
+    return out
+
+
+# Non-zero winding scanline fill, 4x4 samples per pixel, pixel set at >= 50 % coverage
+def rasterize(polygons, width, height, supersample=4):
+    edges = []
+    for poly in polygons:
+        for (x0, y0), (x1, y1) in zip(poly, poly[1:] + poly[:1]):
+            if y0 != y1:
+                edges.append((x0, y0, x1, y1, 1 if y1 > y0 else -1))
+    coverage = [[0] * width for _ in range(height)]
+    for sy in range(height * supersample):
+        y = (sy + 0.5) / supersample
+        crossings = []
+        for x0, y0, x1, y1, w in edges:
+            if (y0 <= y < y1) or (y1 <= y < y0):
+                crossings.append((x0 + (y - y0) * (x1 - x0) / (y1 - y0), w))
+        crossings.sort()
+        winding = 0
+        for (xa, w), (xb, _) in zip(crossings, crossings[1:] + [(None, 0)]):
+            winding += w
+            if winding == 0 or xb is None:
+                continue
+            for sx in range(max(0, int(xa * supersample)), min(width * supersample, int(xb * supersample + 0.5))):
+                if xa <= (sx + 0.5) / supersample < xb:
+                    coverage[sy // supersample][sx // supersample] += 1
+    limit = supersample * supersample // 2
+    return [[c >= limit for c in row] for row in coverage]
+
+
+def ttf_glyphs(path, pixel_height, chars):
+    font = TrueType(path)
+    scale = pixel_height / (font.ascent - font.descent)
+    ascent = int(round(font.ascent * scale))
+    glyphs = []
+    for ch in chars:
+        gid = font.cmap.get(ord(ch), 0)
+        advance = int(round(font.advance(gid) * scale))
+        polys = []
+        for contour in font.contours(gid):
+            poly = flatten(contour)
+            polys.append([(x * scale, ascent - y * scale) for x, y in poly])
+        if not polys:
+            glyphs.append((ch, 0, 0, 0, 0, advance, []))
+            continue
+        xs = [x for poly in polys for x, _ in poly]
+        ys = [y for poly in polys for _, y in poly]
+        x_off, y_off = math.floor(min(xs)), math.floor(min(ys))
+        width = math.ceil(max(xs)) - x_off
+        height = math.ceil(max(ys)) - y_off
+        polys = [[(x - x_off, y - y_off) for x, y in poly] for poly in polys]
+        bitmap = rasterize(polys, width, height)
+        glyphs.append(trim(ch, x_off, y_off, advance, bitmap))
+    return pixel_height, ascent, glyphs
+
+
+######################################################################
+# BDF
+######################################################################
+
+def bdf_glyphs(path, chars):
+    wanted = {ord(c) for c in chars}
+    found = {}
+    ascent = descent = 0
+    with open(path, 'r', encoding='latin-1') as f:
+        lines = iter(f.read().splitlines())
+    for line in lines:
+        if line.startswith('FONT_ASCENT'):
+            ascent = int(line.split()[1])
+        elif line.startswith('FONT_DESCENT'):
+            descent = int(line.split()[1])
+        elif line.startswith('STARTCHAR'):
+            code, advance, bbx, rows = -1, 0, (0, 0, 0, 0), []
+            for line in lines:
+                if line.startswith('ENCODING'):
+                    code = int(line.split()[1])
+                elif line.startswith('DWIDTH'):
+                    advance = int(line.split()[1])
+                elif line.startswith('BBX'):
+                    bbx = tuple(int(v) for v in line.split()[1:5])
+                elif line.startswith('BITMAP'):
+                    for line in lines:
+                        if line.startswith('ENDCHAR'):
+                            break
+                        rows.append(line.strip())
+                    break
+            if code in wanted:
+                w, h, xo, yo = bbx
+                bitmap = []
+                for row in rows[:h]:
+                    bits = int(row, 16) if row else 0
+                    total = len(row) * 4
+                    bitmap.append([bool(bits >> (total - 1 - x) & 1) for x in range(w)])
+                found[code] = trim(chr(code), xo, ascent - (yo + h), advance, bitmap)
+    missing = [c for c in chars if ord(c) not in found]
+    if missing:
+        raise ValueError('characters missing in %s: %r' % (path, ''.join(missing)))
+    return ascent + descent, ascent, [found[ord(c)] for c in chars]
+
+
+######################################################################
+# Encoding
+######################################################################
+
+# Drop empty border rows/columns
+def trim(ch, x_off, y_off, advance, bitmap):
+    rows = [i for i, row in enumerate(bitmap) if any(row)]
+    if not rows:
+        return (ch, 0, 0, 0, 0, advance, [])
+    cols = [i for i in range(len(bitmap[0])) if any(row[i] for row in bitmap)]
+    bitmap = [row[cols[0]:cols[-1] + 1] for row in bitmap[rows[0]:rows[-1] + 1]]
+    return (ch, len(bitmap[0]), len(bitmap), x_off + cols[0], y_off + rows[0], advance, bitmap)
+
+
+def encode_runs(bitmap):
+    runs = []
+    pixels = [p for row in bitmap for p in row]
+    i = 0
+    while i < len(pixels):
+        value, length = pixels[i], 1
+        while i + length < len(pixels) and pixels[i + length] == value and length < 127:
+            length += 1
+        runs.append((0x80 if value else 0) | length)
+        i += length
+    # Trailing background is implied by the glyph size
+    while runs and not runs[-1] & 0x80:
+        runs.pop()
+    return runs
+
+
+def c_ident(name):
+    return 'font_' + ''.join(c if c.isalnum() else '_' for c in name)
+
+
+def generate(fonts, out_c, out_h):
+    header = ['// Generated by scripts/font_gen.py, do not edit']
+    header += ['// %s: %s, %d px, %r' % (name, source, height, ''.join(g[0] for g in glyphs))
+               for name, source, height, _, glyphs in fonts]
+    header.append('')
+    h = header + ['#ifndef FONT_DATA_H_', '#define FONT_DATA_H_', '', '#include "font.h"', '']
+    c = header + ['#include "font_data.h"', '']
+    total = 0
+    for name, _, height, ascent, glyphs in fonts:
+        ident = c_ident(name)
+        runs, table = [], []
+        for ch, w, gh, xo, yo, adv, bitmap in glyphs:
+            encoded = encode_runs(bitmap) if bitmap else []
+            table.append('    {%d, %d, %d, %d, %d, %d, %d}, // %r' % (len(runs), len(encoded), w, gh, xo, yo, adv, ch))
+            runs.extend(encoded)
+        index = [0xff] * 96
+        for i, g in enumerate(glyphs):
+            index[ord(g[0]) - 32] = i
+        c.append('static const uint8_t %s_runs[%d] = {' % (ident, max(len(runs), 1)))
+        for i in range(0, len(runs), 16):
+            c.append('    ' + ' '.join('0x%02x,' % r for r in runs[i:i + 16]))
+        c.append('};')
+        c.append('')
+        c.append('static const font_glyph_t %s_glyphs[%d] = {' % (ident, len(glyphs)))
+        c.extend(table)
+        c.append('};')
+        c.append('')
+        c.append('const font_t %s = {' % ident)
+        c.append('    .height = %d,' % height)
+        c.append('    .ascent = %d,' % ascent)
+        c.append('    .glyph_count = %d,' % len(glyphs))
+        c.append('    .index = {')
+        for i in range(0, 96, 16):
+            c.append('        ' + ' '.join('0x%02x,' % v for v in index[i:i + 16]))
+        c.append('    },')
+        c.append('    .glyphs = %s_glyphs,' % ident)
+        c.append('    .runs = %s_runs,' % ident)
+        c.append('};')
+        c.append('')
+        h.append('extern const font_t %s; // %d px, %d glyphs, %d run bytes' % (ident, height, len(glyphs), len(runs)))
+        total += len(runs) + len(glyphs) * 10 + 96
+    h += ['', '#endif /* FONT_DATA_H_ */', '']
+    with open(out_c, 'w') as f:
+        f.write('\n'.join(c))
+    with open(out_h, 'w') as f:
+        f.write('\n'.join(h))
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--out-c', required=True)
+    parser.add_argument('--out-h', required=True)
+    parser.add_argument('--font', action='append', required=True, help='name:path:pixel_height:characters')
+    args = parser.parse_args()
+
+    fonts = []
+    for spec in args.font:
+        name, path, size, chars = spec.split(':', 3)
+        chars = ''.join(sorted(set(chars), key=chars.index))
+        if any(not 32 <= ord(ch) < 128 for ch in chars):
+            sys.exit('font_gen: only printable ascii is supported (%s)' % name)
+        if path.lower().endswith('.bdf'):
+            height, ascent, glyphs = bdf_glyphs(path, chars)
+        else:
+            height, ascent, glyphs = ttf_glyphs(path, int(size), chars)
+        fonts.append((name, os.path.basename(path), height, ascent, glyphs))
+
+    total = generate(fonts, args.out_c, args.out_h)
+    print('font_gen: %d fonts, %d bytes' % (len(fonts), total))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+# Decode the binary log output (LOG_BINARY=1) of port/debug/log.c
+#
+# Message formats are read from port/debug/log_messages.def, the id of a
+# message is its position in that file. Usage:
+#
+#   log_decode.py capture.bin
+#   cat /dev/ttyACM0 | log_decode.py
+#
+# Every record is LOG_SYNC followed by little endian 32 bit words:
+# header (id | argc << 12 | data length << 16), timestamp in us, the
+# arguments and the data bytes padded to whole words.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0xA5
+ID_MASK = 0x0FFF
+ARGS_SHIFT = 12
+ARGS_MASK = 0x7
+DATA_SHIFT = 16
+MAX_ARGS = 6
+MAX_DATA = 512
+
+LEVELS = {'LOG_LEVEL_ERROR': 'E', 'LOG_LEVEL_WARN': 'W', 'LOG_LEVEL_INFO': 'I',
+          'LOG_LEVEL_DEBUG': 'D', 'LOG_LEVEL_TRACE': 'T'}
+
+DEF_PATH = os.path.join(os.path.dirname(__file__), '..', 'port', 'debug', 'log_messages.def')
+
+
+######################################################################
+# Message table
+######################################################################
+
+MESSAGE_RE = re.compile(r'^\s*LOG_MESSAGE\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+CONVERSION_RE = re.compile(r'%([-+ #0]*)(\d*)(l*)([diuxXc%])')
+
+def load_messages(path):
+    messages = []
+    with open(path) as f:
+        for line in f:
+            m = MESSAGE_RE.match(line)
+            if m:
+                fmt = m.group(3).encode().decode('unicode_escape')
+                messages.append((m.group(1), LEVELS.get(m.group(2), '?'), fmt))
+    return messages
+
+# printf of 32 bit arguments, %d reinterprets them as signed
+def format_message(fmt, args):
+    args = list(args) + [0] * MAX_ARGS
+    index = 0
+    out = []
+    pos = 0
+    for m in CONVERSION_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        value = args[index]
+        index += 1
+        if conv in 'di' and value & 0x80000000:
+            value -= 1 << 32
+        if conv == 'c':
+            value = chr(value & 0xFF)
+        else:
+            conv = 'd' if conv in 'diu' else conv
+        out.append(('%' + flags + width + conv) % value)
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+######################################################################
+# Stream
+######################################################################
+
+def records(data):
+    pos = 0
+    while True:
+        pos = data.find(bytes([LOG_SYNC]), pos)
+        if pos < 0 or pos + 9 > len(data):
+            return
+        header, timestamp = struct.unpack_from('<II', data, pos + 1)
+        argc = (header >> ARGS_SHIFT) & ARGS_MASK
+        length = header >> DATA_SHIFT
+        words = 2 + argc + (length + 3) // 4
+        end = pos + 1 + words * 4
+        if argc > MAX_ARGS or length > MAX_DATA or end > len(data):
+            # Not a record start (sync byte inside data) or cut off, resync on the next byte
+            pos += 1
+            continue
+        args = struct.unpack_from('<%dI' % argc, data, pos + 9)
+        payload = data[pos + 9 + argc * 4:pos + 9 + argc * 4 + length]
+        yield header & ID_MASK, timestamp, args, payload
+        pos = end
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode binary logs of port/debug/log.c')
+    parser.add_argument('capture', nargs='?', help='binary capture, stdin if omitted')
+    parser.add_argument('--messages', default=DEF_PATH, help='log_messages.def of the firmware')
+    args = parser.parse_args()
+
+    messages = load_messages(args.messages)
+    if args.capture:
+        with open(args.capture, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    for msg_id, timestamp, values, payload in records(data):
+        prefix = '[%6d.%03d]' % (timestamp // 1000000, timestamp // 1000 % 1000)
+        if msg_id >= len(messages):
+            print('%s ? unknown message %d %s' % (prefix, msg_id, list(values)))
+            continue
+        name, level, fmt = messages[msg_id]
+        print('%s %s %s' % (prefix, level, format_message(fmt, values)))
+        if payload:
+            print(payload.decode('latin-1'))
+
+if __name__ == '__main__':
+    main()
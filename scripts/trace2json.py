@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# Convert trace dumps of port/debug/trace.c into Chrome trace JSON
+#
+# Event names are read from port/debug/trace_events.def, the id of an
+# event is its position in that file. Usage:
+#
+#   trace2json.py uart_capture.txt > trace.json
+#
+# Open the result in chrome://tracing or https://ui.perfetto.dev. Lines not
+# starting with "trace:" are ignored, so a complete serial log can be used.
+# Every core becomes a thread, all dumps of the capture end up in one file.
+
+import argparse
+import json
+import os
+import re
+import sys
+
+PHASES = {0: 'i', 1: 'B', 2: 'E'}
+
+DEF_PATH = os.path.join(os.path.dirname(__file__), '..', 'port', 'debug', 'trace_events.def')
+
+EVENT_RE = re.compile(r'^\s*TRACE_EVENT\(\s*(\w+)\s*\)')
+LINE_RE = re.compile(r'trace: (.*)$')
+
+def load_events(path):
+    events = []
+    with open(path) as f:
+        for line in f:
+            m = EVENT_RE.match(line)
+            if m:
+                events.append(m.group(1))
+    return events
+
+def convert(lines, names):
+    events = []
+    now = None
+    for line in lines:
+        m = LINE_RE.search(line)
+        if not m:
+            continue
+        fields = m.group(1).split()
+        if fields[0] == 'now':
+            now = int(fields[1])
+            continue
+        if fields[0] == 'end' or now is None or len(fields) != 5:
+            continue
+
+        core, timestamp, event, phase, arg = (int(f) for f in fields)
+        # Timestamps are the low 32 bits of the 64 bit timer, all events are from the last 71 minutes
+        ts = now - ((now - timestamp) & 0xFFFFFFFF)
+        event = {
+            'name': names[event] if event < len(names) else 'event_%d' % event,
+            'ph': PHASES.get(phase, 'i'),
+            'ts': ts,
+            'pid': 0,
+            'tid': core,
+            'args': {'arg': arg},
+        }
+        if event['ph'] == 'i':
+            event['s'] = 't'
+        events.append(event)
+
+    events.sort(key=lambda e: (e['tid'], e['ts']))
+    meta = [{'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': core, 'args': {'name': 'core%d' % core}}
+            for core in sorted(set(e['tid'] for e in events))]
+    return {'traceEvents': meta + events, 'displayTimeUnit': 'ns'}
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert trace dumps to Chrome trace JSON')
+    parser.add_argument('capture', nargs='?', help='text capture, stdin if omitted')
+    parser.add_argument('--events', default=DEF_PATH, help='trace_events.def of the firmware')
+    args = parser.parse_args()
+
+    names = load_events(args.events)
+    if args.capture:
+        with open(args.capture, errors='replace') as f:
+            trace = convert(f, names)
+    else:
+        trace = convert(sys.stdin, names)
+
+    json.dump(trace, sys.stdout)
+    sys.stdout.write('\n')
+
+if __name__ == '__main__':
+    main()
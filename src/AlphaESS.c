@@ -24,21 +24,21 @@ bool alphaESS_setup(){
     SNTP_init(SOCKET_SNTP, g_sntp_server_ip, TIMEZONE, g_sntp_buf);
 }
 
-bool alphaESS_run()
+static bool alphaESS_dhcp(void)
 {
-    /* Initialize */
     uint8_t retval = 0;
     uint8_t dhcp_retry = 0;
-    datetime time;
 
     /* Lease DHCP */
     while (1)
     {
+        TRACE_BEGIN(DHCP_RUN, 0);
         retval = DHCP_run();
+        TRACE_END(DHCP_RUN, retval);
 
         if (retval == DHCP_IP_LEASED)
         {
-            printf("DHCP success\n");
+            LOG(DHCP_SUCCESS);
 
             break;
         }
@@ -48,13 +48,13 @@ bool alphaESS_run()
 
             if (dhcp_retry <= DHCP_RETRY_COUNT)
             {
-                printf("DHCP timeout occurred and retry %d\n", dhcp_retry);
+                LOG(DHCP_RETRY, dhcp_retry);
             }
         }
 
         if (dhcp_retry > DHCP_RETRY_COUNT)
         {
-            printf("DHCP failed\n");
+            LOG(DHCP_FAILED);
 
             DHCP_stop();
 
@@ -64,28 +64,22 @@ bool alphaESS_run()
         sleep_ms(100);
     }
 
+    return true;
+}
 
-    /* Get network information */
-    print_network_information(g_net_info);
-
-    /* Get DNS */
-    if (DNS_run(g_net_info.dns, g_dns_target_domain, g_dns_target_ip) > 0)
-    {
-        printf("DNS success\n");
-        printf("Target domain : %s\n", g_dns_target_domain);
-        printf("IP of target domain : %d.%d.%d.%d\n", g_dns_target_ip[0], g_dns_target_ip[1], g_dns_target_ip[2], g_dns_target_ip[3]);
-    }
-    else
-    {
-        printf("DNS Failed");
-        while(1);
-    }
+// Unix time from the timeserver
+static bool alphaESS_sntp(tstamp * unix_time)
+{
+    uint8_t retval = 0;
+    datetime time;
 
     /* Get time */
     absolute_time_t start_time = get_absolute_time();
     do
     {
+        TRACE_BEGIN(SNTP_RUN, 0);
         retval = SNTP_run(&time);
+        TRACE_END(SNTP_RUN, retval);
 
         if (retval == 1)
         {
@@ -95,17 +89,53 @@ bool alphaESS_run()
 
     if (retval != 1)
     {
-        printf("SNTP failed : %d\n", retval);
+        LOG(SNTP_FAILED, retval);
 
         return false;
     }
 
-    printf("%d-%02d-%02d, %02d:%02d:%02d\n", time.yy, time.mo, time.dd, time.hh, time.mm, time.ss);
+    LOG(SNTP_TIME, time.yy, time.mo, time.dd, time.hh, time.mm, time.ss);
+    *unix_time = changedatetime_to_seconds() - 2208988800L; // Seconds since 1900 -> Seconds since 1970
+
+    return true;
+}
+
+bool alphaESS_time(uint32_t * unix_time)
+{
+    tstamp now;
 
+    if(!alphaESS_dhcp() || !alphaESS_sntp(&now)) return false;
+    *unix_time = (uint32_t)now;
+    return true;
+}
+
+bool alphaESS_run()
+{
+    tstamp timeStamp = 0;
+
+    if(!alphaESS_dhcp()) return false;
+
+    /* Get DNS */
+    TRACE_BEGIN(DNS_RUN, 0);
+    int8_t dns_result = DNS_run(g_net_info.dns, g_dns_target_domain, g_dns_target_ip);
+    TRACE_END(DNS_RUN, dns_result);
+    if (dns_result > 0)
+    {
+        LOG(DNS_SUCCESS, g_dns_target_ip[0], g_dns_target_ip[1], g_dns_target_ip[2], g_dns_target_ip[3]);
+    }
+    else
+    {
+        LOG(DNS_FAILED);
+        while(1);
+    }
+
+    if(!alphaESS_sntp(&timeStamp)) return false;
 
     httpc_init(SOCKET_HTTP, g_dns_target_ip, 80, g_http_s_buf, g_http_r_buf);
+    w5x00_socket_cache_reset_stats();
 
     bool send_success = false;
+    bool parse_success = false;
     while(1){
         httpc_connection_handler();
         if(httpc_isSockOpen){
@@ -117,20 +147,12 @@ bool alphaESS_run()
                 request.uri = (uint8_t *)g_http_target_uri;
                 request.host = (uint8_t *)g_dns_target_domain;
 
-                // unix timestamp
-                tstamp timeStamp = changedatetime_to_seconds() - 2208988800L; // Seconds since 1900 -> Seconds since 1970
                 uint8_t timeStamp_buf[32] = {0};
                 sprintf(timeStamp_buf, "%llu", timeStamp);
 
-                // sign = AppId+AppSecret+Timestamp with sha512 encoded as hex
                 uint8_t secrets[129] = {0};
-                uint8_t sha_out[64] = {0};
-                uint16_t len = sprintf(secrets, "%s%s%s", APP_ID, APP_SECRET, timeStamp_buf);
-                mbedtls_sha512_ret(secrets, len, sha_out, 0);
-                for(int i = 0; i < 64; i++){
-                    sprintf(secrets + 2*i, "%02x", sha_out[i]);
-                }
-                
+                alphaESS_sign(timeStamp_buf, secrets);
+
                 g_http_h_buf[0] = 0;
                 httpc_add_customHeader_field(g_http_h_buf, "appId", APP_ID);
                 httpc_add_customHeader_field(g_http_h_buf, "timeStamp", timeStamp_buf);
@@ -142,23 +164,46 @@ bool alphaESS_run()
             {
                 uint16_t len = httpc_recv(g_http_r_buf, httpc_isReceived);
 
-                printf(" >> HTTP Response - Received len: %d\r\n", len);
-                printf("======================================================\r\n");
-                for(uint16_t i = 0; i < len; i++) printf("%c", g_http_r_buf[i]);
-                printf("\r\n");
-                printf("======================================================\r\n");
+                LOG(HTTP_RESPONSE, len);
+                LOG_DATA(HTTP_RESPONSE_DATA, g_http_r_buf, len);
+
+                parse_success = power_data_parse(g_http_r_buf, len, &g_power_data);
+                if(parse_success) g_power_data.timestamp = timeStamp;
+                else LOG(HTTP_PARSE_FAILED, len);
                 break;
             }
         }
     }
 
-    return true;
+    const w5x00_socket_cache_stats_t * cache_stats = w5x00_socket_cache_get_stats();
+    LOG(SOCKET_CACHE, cache_stats->ticks, cache_stats->transactions,
+        (int32_t)(cache_stats->replaced - cache_stats->transactions));
+
+    return parse_success;
+}
+
+const power_data_t * alphaESS_power_data(void)
+{
+    return &g_power_data;
+}
+
+// sign = AppId+AppSecret+Timestamp with sha512 encoded as hex
+void alphaESS_sign(const uint8_t * timestamp, uint8_t * sign)
+{
+    uint8_t secrets[129] = {0};
+    uint8_t sha_out[64] = {0};
+    uint16_t len = snprintf(secrets, sizeof(secrets), "%s%s%s", APP_ID, APP_SECRET, timestamp);
+    if(len >= sizeof(secrets)) len = sizeof(secrets) - 1;
+    mbedtls_sha512_ret(secrets, len, sha_out, 0);
+    for(int i = 0; i < 64; i++){
+        sprintf(sign + 2*i, "%02x", sha_out[i]);
+    }
 }
 
 /* DHCP */
 static void wizchip_dhcp_init(void)
 {
-    printf("DHCP client running\n");
+    LOG(DHCP_RUNNING);
 
     DHCP_init(SOCKET_DHCP, g_ethernet_buf);
 
@@ -178,12 +223,12 @@ static void wizchip_dhcp_assign(void)
     network_initialize(g_net_info); // apply from DHCP
 
     print_network_information(g_net_info);
-    printf("DHCP leased time : %ld seconds\n", getDHCPLeasetime());
+    LOG(DHCP_LEASED, getDHCPLeasetime());
 }
 
 static void wizchip_dhcp_conflict(void)
 {
-    printf("Conflict IP from DHCP\n");
+    LOG(DHCP_CONFLICT);
 
     // halt or reset or any...
     while (1); // this example is halt.
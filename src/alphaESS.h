@@ -13,6 +13,10 @@
 #include "wizchip_conf.h"
 #include "w5x00_spi.h"
 #include "httpClient.h"
+#include "w5x00_socket_cache.h"
+#include "powerData.h"
+#include "log.h"
+#include "trace.h"
 
 #include "dhcp.h"
 #include "dns.h"
@@ -75,6 +79,9 @@ static uint8_t g_http_s_buf[ETHERNET_BUF_MAX_SIZE] = { 0, };
 // HTTP Custom header field buffer
 static uint8_t g_http_h_buf[ETHERNET_BUF_MAX_SIZE] = { 0, };
 
+/* Last successfully parsed api response */
+static power_data_t g_power_data = { 0, };
+
 /* Timer */
 static volatile uint16_t g_msec_cnt = 0;
 
@@ -86,6 +93,9 @@ static void wizchip_dhcp_conflict();
 /* Functions */
 bool alphaESS_run();
 bool alphaESS_setup();
+bool alphaESS_time(uint32_t * unix_time); // Unix time over SNTP without polling the api, false if unavailable
+const power_data_t * alphaESS_power_data(void);
+void alphaESS_sign(const uint8_t * timestamp, uint8_t * sign); // sign has to hold 129 bytes
 
 /* Timer */
 static bool repeating_timer_callback(struct repeating_timer *t);
\ No newline at end of file
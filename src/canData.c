@@ -0,0 +1,85 @@
+/**
+ * canData.c
+ * Jannis Lämmle
+ * Table driven decoding of CAN frames into power_data_t, see canData.h
+ */
+
+#include <string.h>
+
+#include "canData.h"
+
+static int32_t signal_value(const can_signal_t * signal, const uint8_t * data)
+{
+    uint64_t word = 0;
+
+    if(signal->flags & CAN_SIGNAL_BIG_ENDIAN)
+    {
+        for(uint32_t i = 0; i < 8; i++) word = (word << 8) | data[i];
+    }
+    else
+    {
+        for(uint32_t i = 8; i-- > 0;) word = (word << 8) | data[i];
+    }
+
+    uint32_t mask = signal->length >= 32 ? 0xffffffff : (1u << signal->length) - 1;
+    int64_t raw = (word >> signal->shift) & mask;
+    if((signal->flags & CAN_SIGNAL_SIGNED) && (raw & (1ll << (signal->length - 1)))) raw -= 1ll << signal->length;
+
+    return (int32_t)(raw * signal->num / signal->den + signal->offset);
+}
+
+void can_data_init(can_data_t * cd, const can_signal_table_t * table)
+{
+    memset(cd, 0, sizeof(*cd));
+    cd->table = table;
+}
+
+const can_message_t * can_data_message(const can_signal_table_t * table, uint32_t id)
+{
+    uint32_t low = 0, high = table->message_count;
+
+    while(low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+        if(table->messages[mid].id == id) return &table->messages[mid];
+        if(table->messages[mid].id < id) low = mid + 1;
+        else high = mid;
+    }
+    return NULL;
+}
+
+bool can_data_decode(can_data_t * cd, const struct can2040_msg * msg)
+{
+    const can_message_t * message = can_data_message(cd->table, msg->id);
+
+    if(message == NULL || msg->dlc < message->dlc)
+    {
+        cd->ignored++;
+        return false;
+    }
+
+    for(uint32_t i = 0; i < message->signal_count; i++)
+    {
+        const can_signal_t * signal = &cd->table->signals[message->signal_offset + i];
+        int32_t value = signal_value(signal, msg->data);
+
+        switch(signal->field)
+        {
+            case CAN_DATA_PPV: cd->data.ppv = value; break;
+            case CAN_DATA_PLOAD: cd->data.pload = value; break;
+            case CAN_DATA_PGRID: cd->data.pgrid = value; break;
+            case CAN_DATA_PBAT: cd->data.pbat = value; break;
+            case CAN_DATA_SOC: cd->data.soc = value < 0 ? 0 : (value > 1000 ? 1000 : value); break;
+            default: break;
+        }
+        cd->seen |= 1 << signal->field;
+    }
+    cd->updated = msg->timestamp;
+    cd->frames++;
+    return true;
+}
+
+bool can_data_complete(const can_data_t * cd)
+{
+    return (cd->seen & cd->table->fields) == cd->table->fields;
+}
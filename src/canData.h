@@ -0,0 +1,72 @@
+/**
+ * canData.h
+ * Jannis Lämmle
+ * Local data source: decodes CAN frames of the inverter and battery into the power_data_t sample of the cloud
+ * api, with decode tables generated at build time from a DBC file (scripts/dbc_gen.py)
+ */
+
+#ifndef CANDATA_H_
+#define CANDATA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "can.h"
+#include "powerData.h"
+
+// Fields of power_data_t a signal can fill, in the order of scripts/dbc_gen.py
+typedef enum can_data_field {
+    CAN_DATA_PPV,
+    CAN_DATA_PLOAD,
+    CAN_DATA_PGRID,
+    CAN_DATA_PBAT,
+    CAN_DATA_SOC,
+    CAN_DATA_FIELDS
+} can_data_field_t;
+
+#define CAN_SIGNAL_SIGNED 0x01
+#define CAN_SIGNAL_BIG_ENDIAN 0x02  // Motorola byte order
+
+// Field value = raw * num / den + offset, raw read from the frame data as one 64 bit number shifted down by shift
+typedef struct can_signal {
+    uint8_t shift;
+    uint8_t length;     // 1-32 bits
+    uint8_t flags;
+    uint8_t field;      // can_data_field_t
+    int32_t num;
+    int32_t den;
+    int32_t offset;
+} can_signal_t;
+
+typedef struct can_message {
+    uint32_t id;        // can2040 id, with CAN2040_ID_EFF for 29 bit ids
+    uint8_t dlc;        // shorter frames are ignored
+    uint16_t signal_offset;
+    uint8_t signal_count;
+} can_message_t;
+
+typedef struct can_signal_table {
+    uint8_t message_count;
+    uint8_t fields;     // bit per can_data_field_t filled by some signal
+    const can_message_t * messages; // sorted by id
+    const can_signal_t * signals;
+} can_signal_table_t;
+
+typedef struct can_data {
+    const can_signal_table_t * table;
+    power_data_t data;  // timestamp is left to the caller
+    uint8_t seen;       // fields received at least once
+    uint64_t updated;   // timestamp of the last decoded frame
+    uint32_t frames;    // decoded frames
+    uint32_t ignored;   // frames not in the table or too short
+} can_data_t;
+
+/*********************************************
+* CAN Data Functions
+*********************************************/
+void can_data_init(can_data_t * cd, const can_signal_table_t * table);
+bool can_data_decode(can_data_t * cd, const struct can2040_msg * msg); // Returns false if the frame is not in the table
+bool can_data_complete(const can_data_t * cd); // Every field of the table was received
+const can_message_t * can_data_message(const can_signal_table_t * table, uint32_t id); // NULL if not in the table
+
+#endif /* CANDATA_H_ */
@@ -0,0 +1,118 @@
+/**
+ * canReplay.c
+ * Jannis Lämmle
+ * Host program decoding recorded candump logs with the generated tables of the local data source
+ *
+ * Usage: AlphaESS_can_replay [candump.log ...]
+ * Reads stdin without files. Lines are in the format of candump -l, "(1700000000.123456) can0 355#3C00640000000000",
+ * 8 hex digits of id for 29 bit ids, "R" after '#' for remote frames. Once every field was received, the sample
+ * is printed each second of log time as "timestamp,ppv,pload,pgrid,pbat,soc", the input of AlphaESS_control_replay.
+ * The summary lines start with '#'.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "canData.h"
+#include "can_signals.h"
+
+static int hex_digit(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parses "(sec.usec) interface id#data", returns false for other lines
+static bool parse_line(const char * line, struct can2040_msg * msg)
+{
+    unsigned long sec, usec;
+    char frame[64];
+
+    if(sscanf(line, " (%lu.%lu) %*s %63s", &sec, &usec, frame) != 3) return false;
+
+    const char * hash = strchr(frame, '#');
+    if(hash == NULL || hash - frame > 8) return false;
+
+    memset(msg, 0, sizeof(*msg));
+    for(const char * p = frame; p < hash; p++)
+    {
+        int digit = hex_digit(*p);
+        if(digit < 0) return false;
+        msg->id = (msg->id << 4) | digit;
+    }
+    if(hash - frame == 8) msg->id = CAN2040_ID_EFF | (msg->id & 0x1fffffff);
+    else msg->id &= 0x7ff;
+
+    const char * p = hash + 1;
+    if(*p == 'R')
+    {
+        msg->id |= CAN2040_ID_RTR;
+        if(hex_digit(p[1]) >= 0) msg->dlc = hex_digit(p[1]);
+    }
+    else
+    {
+        while(msg->dlc < 8 && hex_digit(p[0]) >= 0 && hex_digit(p[1]) >= 0)
+        {
+            msg->data[msg->dlc++] = hex_digit(p[0]) << 4 | hex_digit(p[1]);
+            p += 2;
+        }
+    }
+
+    msg->timestamp = (uint64_t)sec * 1000000 + usec;
+    return true;
+}
+
+static void replay(FILE * file, can_data_t * cd, uint64_t * printed_s, uint32_t * lines)
+{
+    char line[160];
+    struct can2040_msg msg;
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        if(!parse_line(line, &msg)) continue;
+        (*lines)++;
+        if(!can_data_decode(cd, &msg) || !can_data_complete(cd)) continue;
+
+        uint64_t second = msg.timestamp / 1000000;
+        if(second == *printed_s) continue;
+        *printed_s = second;
+
+        printf("%lu,%ld,%ld,%ld,%ld,%u\n", (unsigned long)second, (long)cd->data.ppv, (long)cd->data.pload,
+               (long)cd->data.pgrid, (long)cd->data.pbat, (unsigned)cd->data.soc);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    can_data_t cd;
+    uint64_t printed_s = 0;
+    uint32_t lines = 0;
+
+    stdio_init_all();
+    can_data_init(&cd, &can_signals);
+
+    if(argc < 2)
+    {
+        replay(stdin, &cd, &printed_s, &lines);
+    }
+    for(int i = 1; i < argc; i++)
+    {
+        FILE * file = fopen(argv[i], "r");
+        if(file == NULL)
+        {
+            printf("can not open %s\n", argv[i]);
+            return 1;
+        }
+        replay(file, &cd, &printed_s, &lines);
+        fclose(file);
+    }
+
+    printf("# frames=%u decoded=%u ignored=%u complete=%s\n", (unsigned)lines, (unsigned)cd.frames,
+           (unsigned)cd.ignored, can_data_complete(&cd) ? "yes" : "no");
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * canSource.c
+ * Jannis Lämmle
+ * can2040 setup and decoding of the newest frame of each id into the local sample, see canSource.h
+ */
+
+#include "pico/stdlib.h"
+
+#include "can.h"
+#include "can_bus.h"
+#include "canData.h"
+#include "canSource.h"
+#include "can_signals.h"
+#include "log.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+// Messages of the decode tables with a mailbox, and mailbox slots per bus (4 per id keep the hash search short)
+#define CAN_SOURCE_MAILBOX_IDS 16
+#define CAN_SOURCE_MAILBOX_SLOTS 64
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static const can_bus_config_t g_bus_configs[CAN_SOURCE_BUSES] = {
+    { .gpio_rx = CAN_SOURCE_INVERTER_PIN_RX, .gpio_tx = CAN_SOURCE_INVERTER_PIN_TX, .bitrate = CAN_SOURCE_BITRATE },
+    { .gpio_rx = CAN_SOURCE_BMS_PIN_RX, .gpio_tx = CAN_SOURCE_BMS_PIN_TX, .bitrate = CAN_SOURCE_BITRATE },
+};
+static can_bus_t g_buses[CAN_SOURCE_BUSES];
+static uint32_t g_bus_count;
+static struct can2040_mailbox g_mailboxes[CAN_SOURCE_BUSES][CAN_SOURCE_MAILBOX_SLOTS];
+static uint32_t g_mailbox_ids[CAN_SOURCE_MAILBOX_IDS];
+static uint32_t g_mailbox_count;
+static uint32_t g_bus_mailboxes[CAN_SOURCE_BUSES];  // ids with a mailbox per bus, 0 if its table failed
+static uint64_t g_decoded[CAN_SOURCE_BUSES][CAN_SOURCE_MAILBOX_IDS];   // timestamp of the frame last decoded per id
+static can_data_t g_can_data;
+static power_data_t g_power_data;
+static uint64_t g_sample_us;    // time of the last complete sample, 0 for none
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void can_source_setup(void)
+{
+    can_data_init(&g_can_data, &can_signals);
+
+    g_bus_count = CAN_SOURCE_BUSES;
+    while(g_bus_count > 0)
+    {
+        int ret = can_bus_setup(g_buses, g_bus_configs, g_bus_count, 0);
+        if(ret == CAN_BUS_OK) break;
+        LOG(CAN_BUS_PLAN_FAILED, g_bus_count, ret);
+        g_bus_count--;
+    }
+
+    // Only the newest frame of each message of the decode tables is kept, the others are not even stored
+    g_mailbox_count = can_signals.message_count < CAN_SOURCE_MAILBOX_IDS ? can_signals.message_count : CAN_SOURCE_MAILBOX_IDS;
+    for(uint32_t i = 0; i < g_mailbox_count; i++) g_mailbox_ids[i] = can_signals.messages[i].id;
+    for(uint32_t b = 0; b < g_bus_count; b++)
+    {
+        struct can2040 * cd = &g_buses[b].cd;
+
+        for(uint32_t i = 0; i < g_mailbox_count; i++)
+        {
+            uint32_t id = g_mailbox_ids[i];
+            if(id & CAN2040_ID_EFF) can2040_filter_add_mask(cd, CAN2040_ID_EFF | CAN2040_ID_RTR | 0x1fffffff, id);
+            else can2040_filter_add_std(cd, id);
+        }
+        // A failed table only costs this bus its samples, the others keep theirs
+        g_bus_mailboxes[b] = g_mailbox_count;
+        if(can2040_mailbox_setup(cd, g_mailboxes[b], CAN_SOURCE_MAILBOX_SLOTS, g_mailbox_ids, g_mailbox_count) < 0)
+        {
+            LOG(CAN_SOURCE_MAILBOX_FAILED, b, g_mailbox_count, CAN_SOURCE_MAILBOX_SLOTS);
+            g_bus_mailboxes[b] = 0;
+        }
+    }
+
+    can_bus_start();
+}
+
+bool can_source_poll(uint32_t unix_time)
+{
+    struct can2040_msg msg;
+    bool updated = false;
+
+    // Each message of the tables comes from one of the buses, the other mailboxes stay empty
+    for(uint32_t b = 0; b < g_bus_count; b++)
+    {
+        for(uint32_t i = 0; i < g_bus_mailboxes[b]; i++)
+        {
+            if(can2040_mailbox_read(&g_buses[b].cd, g_mailbox_ids[i], &msg) <= 0 || msg.timestamp == g_decoded[b][i]) continue;
+            g_decoded[b][i] = msg.timestamp;
+            updated |= can_data_decode(&g_can_data, &msg);
+        }
+    }
+    if(!updated || !can_data_complete(&g_can_data)) return false;
+
+    g_power_data = g_can_data.data;
+    g_power_data.timestamp = unix_time;
+    g_sample_us = g_can_data.updated;
+    return true;
+}
+
+bool can_source_fresh(void)
+{
+    return g_sample_us != 0 && time_us_64() - g_sample_us < CAN_SOURCE_STALE_US;
+}
+
+const power_data_t * can_source_power_data(void)
+{
+    return &g_power_data;
+}
@@ -0,0 +1,39 @@
+/**
+ * canSource.h
+ * Jannis Lämmle
+ * Local data source on the board: can2040 receives the frames of the inverter and battery, canData.c turns
+ * them into the power_data_t sample of the cloud api within milliseconds of their arrival
+ *
+ * The inverter and the battery management system are on buses of their own. The PIO blocks are planned after
+ * alphaESS_setup(), so a W5x00 SPI program already sits in its block; if the blocks left do not suffice, only
+ * the inverter bus is received.
+ */
+
+#ifndef CANSOURCE_H_
+#define CANSOURCE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerData.h"
+
+/* Bus connections (CAN transceivers on gpio, each bus takes a whole PIO block, see can_bus.h) */
+#define CAN_SOURCE_BUSES 2
+#define CAN_SOURCE_INVERTER_PIN_RX 4
+#define CAN_SOURCE_INVERTER_PIN_TX 5
+#define CAN_SOURCE_BMS_PIN_RX 2
+#define CAN_SOURCE_BMS_PIN_TX 3
+#define CAN_SOURCE_BITRATE 500000
+
+// Without frames for this long the cloud api is the data source again
+#define CAN_SOURCE_STALE_US (5 * 1000 * 1000)
+
+/*********************************************
+* CAN Source Functions
+*********************************************/
+void can_source_setup(void);
+bool can_source_poll(uint32_t unix_time); // Decodes the received frames, returns true if a complete sample was updated
+bool can_source_fresh(void); // A complete sample arrived within CAN_SOURCE_STALE_US
+const power_data_t * can_source_power_data(void);
+
+#endif /* CANSOURCE_H_ */
@@ -0,0 +1,201 @@
+/**
+ * control.c
+ * Jannis Lämmle
+ * Rule engine switching the circulation pump relay from the power data samples
+ *
+ * The rules in controlRules.def are expanded into a const table at compile time. Every sample runs once
+ * over the table: each rule updates its hysteresis state and the first matching rule decides the output.
+ * The minimum on/off times are applied last, then the GPIO is set before returning.
+ */
+
+#include <string.h>
+
+#include "pico/time.h"
+#if PICO_ON_DEVICE
+#include "hardware/gpio.h"
+#endif
+
+#include "control.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef struct control_rule {
+    control_output_t output;
+    control_field_t field;
+    control_compare_t compare;
+    int32_t threshold;
+    int32_t hysteresis;
+    uint16_t from;          // minute of the day
+    uint16_t to;
+} control_rule_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+_Static_assert(CONTROL_RULE_COUNT <= 32, "rule states are kept in a 32 bit mask");
+
+#define CONTROL_RULE(name, output, field, compare, threshold, hysteresis, from, to) \
+    _Static_assert((from) < 24 * 60 && (to) < 24 * 60, "schedule of rule " #name " is not within a day"); \
+    _Static_assert((hysteresis) >= 0, "hysteresis of rule " #name " is negative");
+#include "controlRules.def"
+#undef CONTROL_RULE
+
+static const control_rule_t g_rules[CONTROL_RULE_COUNT] = {
+#define CONTROL_RULE(name, output, field, compare, threshold, hysteresis, from, to) \
+    [CONTROL_RULE_##name] = {output, field, compare, threshold, hysteresis, from, to},
+#include "controlRules.def"
+#undef CONTROL_RULE
+};
+
+static const char * const g_rule_names[CONTROL_RULE_COUNT + 1] = {
+#define CONTROL_RULE(name, output, field, compare, threshold, hysteresis, from, to) [CONTROL_RULE_##name] = #name,
+#include "controlRules.def"
+#undef CONTROL_RULE
+    [CONTROL_RULE_DEFAULT] = "default",
+};
+
+static uint32_t g_rule_active;  // bit per rule, threshold was crossed and the hysteresis applies
+static control_output_t g_output;
+static bool g_started;
+static uint32_t g_switch_time;  // timestamp of the last switch
+static uint32_t g_last_time;    // timestamp of the last sample
+
+static control_stats_t g_stats;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Rules
+ * ----------------------------------------------------------------------------------------------------
+ */
+static int32_t control_field(const power_data_t * data, control_field_t field)
+{
+    switch(field)
+    {
+        case CONTROL_FIELD_PPV: return data->ppv;
+        case CONTROL_FIELD_PLOAD: return data->pload;
+        case CONTROL_FIELD_PGRID: return data->pgrid;
+        case CONTROL_FIELD_PBAT: return data->pbat;
+        case CONTROL_FIELD_SOC: return data->soc;
+        default: return 0;
+    }
+}
+
+// minute < 0 if the time is unknown, rules with a schedule never match then
+static bool rule_matches(const control_rule_t * rule, bool active, const power_data_t * data, int16_t minute)
+{
+    if(rule->from != rule->to)
+    {
+        if(minute < 0) return false;
+
+        bool inside = rule->from < rule->to ? (minute >= rule->from && minute < rule->to)
+                                            : (minute >= rule->from || minute < rule->to);
+        if(!inside) return false;
+    }
+
+    if(rule->field == CONTROL_FIELD_NONE) return true;
+
+    // An active rule only releases once the value is back past the threshold by the hysteresis
+    int32_t value = control_field(data, rule->field);
+    int32_t hysteresis = active ? rule->hysteresis : 0;
+
+    if(rule->compare == CONTROL_ABOVE) return value > rule->threshold - hysteresis;
+    return value < rule->threshold + hysteresis;
+}
+
+static void control_set_output(control_output_t output)
+{
+    g_output = output;
+#if PICO_ON_DEVICE
+    gpio_put(CONTROL_PIN_PUMP, output == CONTROL_ON);
+#endif
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void control_init(void)
+{
+#if PICO_ON_DEVICE
+    gpio_init(CONTROL_PIN_PUMP);
+    gpio_set_dir(CONTROL_PIN_PUMP, GPIO_OUT);
+#endif
+    control_set_output(CONTROL_OFF);
+
+    g_rule_active = 0;
+    g_started = false;
+    g_switch_time = 0;
+    g_last_time = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+control_decision_t control_sample(const power_data_t * data)
+{
+    uint32_t start = time_us_32();
+    control_decision_t decision = {g_output, CONTROL_RULE_DEFAULT, CONTROL_REASON_RULE, false};
+    int16_t minute = -1;
+
+    if(data->timestamp != 0) minute = (data->timestamp / 60 + 24 * 60 + CONTROL_UTC_OFFSET_MIN) % (24 * 60);
+
+    // All rules are evaluated so their hysteresis state stays current, the first match wins
+    for(uint8_t i = 0; i < CONTROL_RULE_COUNT; i++)
+    {
+        bool match = rule_matches(&g_rules[i], g_rule_active & (1u << i), data, minute);
+
+        if(match) g_rule_active |= 1u << i;
+        else g_rule_active &= ~(1u << i);
+
+        if(match && decision.rule == CONTROL_RULE_DEFAULT) decision.rule = i;
+    }
+
+    control_output_t wanted = decision.rule == CONTROL_RULE_DEFAULT ? CONTROL_DEFAULT_OUTPUT : g_rules[decision.rule].output;
+
+    if(g_started && g_output == CONTROL_ON && data->timestamp > g_last_time) g_stats.on_s += data->timestamp - g_last_time;
+
+    if(wanted != g_output)
+    {
+        uint32_t min_time = g_output == CONTROL_ON ? CONTROL_MIN_ON_S : CONTROL_MIN_OFF_S;
+
+        // Without a time the minimum on/off times can not be checked, the hysteresis still applies
+        if(g_started && data->timestamp != 0 && data->timestamp - g_switch_time < min_time)
+        {
+            decision.reason = g_output == CONTROL_ON ? CONTROL_REASON_MIN_ON : CONTROL_REASON_MIN_OFF;
+            g_stats.held++;
+        }
+        else
+        {
+            control_set_output(wanted);
+            decision.output = wanted;
+            decision.switched = true;
+            g_switch_time = data->timestamp;
+            g_stats.switches++;
+        }
+    }
+
+    uint32_t duration = time_us_32() - start;
+    if(duration > g_stats.eval_us_max) g_stats.eval_us_max = duration;
+
+    if(!g_started) g_switch_time = data->timestamp;
+    g_started = true;
+    g_last_time = data->timestamp;
+    g_stats.samples++;
+
+    return decision;
+}
+
+const char * control_rule_name(control_rule_id_t rule)
+{
+    if(rule > CONTROL_RULE_DEFAULT) return "?";
+    return g_rule_names[rule];
+}
+
+void control_get_stats(control_stats_t * stats)
+{
+    memcpy(stats, &g_stats, sizeof(*stats));
+}
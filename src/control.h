@@ -0,0 +1,88 @@
+/**
+ * control.h
+ * Jannis Lämmle
+ * Rule engine switching the circulation pump relay from the power data samples
+ */
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerData.h"
+
+/* Relay */
+#define CONTROL_PIN_PUMP 6
+#define CONTROL_DEFAULT_OUTPUT CONTROL_OFF
+
+/* Timing */
+// Minimum time the relay stays in a state before it may switch again
+#define CONTROL_MIN_ON_S (15 * 60)
+#define CONTROL_MIN_OFF_S (10 * 60)
+// Offset of the local time used by the rule schedules to UTC, no daylight saving
+#define CONTROL_UTC_OFFSET_MIN 60
+
+// Minute of the day for rule schedules
+#define CONTROL_TIME(hour, minute) ((hour) * 60 + (minute))
+
+typedef enum {
+    CONTROL_OFF,
+    CONTROL_ON,
+} control_output_t;
+
+typedef enum {
+    CONTROL_FIELD_NONE,
+    CONTROL_FIELD_PPV,
+    CONTROL_FIELD_PLOAD,
+    CONTROL_FIELD_PGRID,
+    CONTROL_FIELD_PBAT,
+    CONTROL_FIELD_SOC,
+} control_field_t;
+
+typedef enum {
+    CONTROL_ABOVE,
+    CONTROL_BELOW,
+} control_compare_t;
+
+// Rule indices, in the order of controlRules.def
+typedef enum {
+#define CONTROL_RULE(name, output, field, compare, threshold, hysteresis, from, to) CONTROL_RULE_##name,
+#include "controlRules.def"
+#undef CONTROL_RULE
+    CONTROL_RULE_COUNT,
+    CONTROL_RULE_DEFAULT = CONTROL_RULE_COUNT, // no rule matched
+} control_rule_id_t;
+
+typedef enum {
+    CONTROL_REASON_RULE,    // output follows the rule
+    CONTROL_REASON_MIN_ON,  // rule wants off, held on by CONTROL_MIN_ON_S
+    CONTROL_REASON_MIN_OFF, // rule wants on, held off by CONTROL_MIN_OFF_S
+} control_reason_t;
+
+typedef struct control_decision {
+    control_output_t output;
+    control_rule_id_t rule;
+    control_reason_t reason;
+    bool switched;          // the relay changed with this sample
+} control_decision_t;
+
+typedef struct control_stats {
+    uint32_t samples;
+    uint32_t switches;
+    uint32_t held;          // samples where a minimum on/off time delayed a switch
+    uint32_t on_s;          // time spent on, from the sample timestamps
+    uint32_t eval_us_max;   // longest time from control_sample() being called to the GPIO being set
+} control_stats_t;
+
+/*********************************************
+* Control Functions
+*********************************************/
+void control_init(void); // Relay off (CONTROL_DEFAULT_OUTPUT on the first sample), all rules inactive
+// Evaluate all rules for a new sample and drive the relay. Runs in O(CONTROL_RULE_COUNT) without any
+// data dependent loops, so the time until the GPIO changes is bounded.
+control_decision_t control_sample(const power_data_t * data);
+const char * control_rule_name(control_rule_id_t rule);
+void control_get_stats(control_stats_t * stats);
+
+#endif /* CONTROL_H_ */
@@ -0,0 +1,114 @@
+/**
+ * controlReplay.c
+ * Jannis Lämmle
+ * Host program replaying recorded samples through the pump control rules
+ *
+ * Usage: AlphaESS_control_replay [file.csv ...]
+ * Reads stdin without files. Lines are "timestamp,ppv,pload,pgrid,pbat,soc" with the unix time, powers in W
+ * and soc in 0.1 %, lines starting with '#' are skipped. Every decision that differs from the previous one
+ * is printed, followed by the relay switches and on time per local day and in total.
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "control.h"
+
+typedef struct replay_day {
+    uint32_t day;           // local days since 1970
+    uint32_t samples;
+} replay_day_t;
+
+static uint32_t local_day(uint32_t timestamp)
+{
+    return (timestamp + CONTROL_UTC_OFFSET_MIN * 60) / (24 * 60 * 60);
+}
+
+static void print_day(const replay_day_t * day, const control_stats_t * stats, const control_stats_t * start)
+{
+    if(day->samples == 0) return;
+
+    printf("day=%u samples=%u switches=%u held=%u on_min=%u\n", (unsigned)day->day, (unsigned)day->samples,
+           (unsigned)(stats->switches - start->switches), (unsigned)(stats->held - start->held),
+           (unsigned)((stats->on_s - start->on_s) / 60));
+}
+
+static void replay(FILE * file, replay_day_t * day, control_stats_t * day_start)
+{
+    static control_decision_t last = {CONTROL_OFF, (control_rule_id_t)(CONTROL_RULE_DEFAULT + 1), CONTROL_REASON_RULE, false};
+    char line[160];
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        power_data_t data = {0};
+        unsigned long timestamp;
+        long ppv, pload, pgrid, pbat, soc;
+        control_stats_t stats;
+
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%lu,%ld,%ld,%ld,%ld,%ld", &timestamp, &ppv, &pload, &pgrid, &pbat, &soc) != 6) continue;
+
+        data.timestamp = timestamp;
+        data.ppv = ppv;
+        data.pload = pload;
+        data.pgrid = pgrid;
+        data.pbat = pbat;
+        data.soc = soc;
+
+        if(local_day(data.timestamp) != day->day)
+        {
+            control_get_stats(&stats);
+            print_day(day, &stats, day_start);
+            *day_start = stats;
+            day->day = local_day(data.timestamp);
+            day->samples = 0;
+        }
+
+        control_decision_t decision = control_sample(&data);
+        day->samples++;
+
+        if(decision.output != last.output || decision.rule != last.rule || decision.reason != last.reason)
+        {
+            static const char * const reasons[] = {"rule", "min_on", "min_off"};
+            uint32_t minute = (data.timestamp / 60 + 24 * 60 + CONTROL_UTC_OFFSET_MIN) % (24 * 60);
+
+            printf("time=%lu local=%02u:%02u output=%s rule=%s reason=%s%s\n", timestamp, (unsigned)(minute / 60),
+                   (unsigned)(minute % 60), decision.output == CONTROL_ON ? "on" : "off",
+                   control_rule_name(decision.rule), reasons[decision.reason], decision.switched ? " switched" : "");
+        }
+        last = decision;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    replay_day_t day = {0};
+    control_stats_t day_start = {0}, stats;
+
+    stdio_init_all();
+    control_init();
+
+    if(argc < 2)
+    {
+        replay(stdin, &day, &day_start);
+    }
+    for(int i = 1; i < argc; i++)
+    {
+        FILE * file = fopen(argv[i], "r");
+        if(file == NULL)
+        {
+            printf("can not open %s\n", argv[i]);
+            return 1;
+        }
+        replay(file, &day, &day_start);
+        fclose(file);
+    }
+
+    control_get_stats(&stats);
+    print_day(&day, &stats, &day_start);
+    printf("total samples=%u switches=%u held=%u on_min=%u eval_us_max=%u\n", (unsigned)stats.samples,
+           (unsigned)stats.switches, (unsigned)stats.held, (unsigned)(stats.on_s / 60), (unsigned)stats.eval_us_max);
+
+    return 0;
+}
@@ -0,0 +1,468 @@
+/**
+ * display.c
+ * Jannis Lämmle
+ * Tile based renderer for the light switch display
+ *
+ * Nothing is kept as a full framebuffer. Changed areas are collected as dirty rectangles and rendered
+ * in tiles into one of two tile buffers. While the backend sends one tile (DMA on device) the next one
+ * is rendered into the other buffer.
+ *
+ * Below the widgets a graph shows the PV and load history. It is drawn from the per-column min/max of
+ * the decimators in history.c, so a redraw costs O(graph width) no matter how many samples it covers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/time.h"
+
+#include "display.h"
+#include "font.h"
+#include "font_data.h"
+#include "history.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* Layout */
+#define WIDGET_COUNT 4
+#define WIDGET_HEIGHT 56
+#define WIDGET_MARKER_WIDTH 8
+
+/* Text */
+#define LABEL_LEFT (WIDGET_MARKER_WIDTH + 8)
+#define LABEL_TOP 2
+#define UNIT_RIGHT (DISPLAY_WIDTH - 12)
+#define VALUE_RIGHT (UNIT_RIGHT - 18)
+#define VALUE_LEFT (LABEL_LEFT + 16)
+#define VALUE_TOP 14
+
+/* Battery bar */
+#define BAR_LEFT (WIDGET_MARKER_WIDTH + 8)
+#define BAR_WIDTH (DISPLAY_WIDTH - BAR_LEFT - 12)
+#define BAR_TOP 51
+#define BAR_HEIGHT 4
+
+/* History graph */
+#define GRAPH_TOP (WIDGET_COUNT * WIDGET_HEIGHT)
+#define GRAPH_HEIGHT (DISPLAY_HEIGHT - GRAPH_TOP)
+#define GRAPH_PLOT_TOP (GRAPH_TOP + 4)
+#define GRAPH_PLOT_HEIGHT (GRAPH_HEIGHT - 8)
+// 32 samples per column at one sample per 10 s puts about 21 hours on the graph
+#define GRAPH_SAMPLES_PER_COLUMN 32
+// The scale is rounded up to this step so it does not change on every sample
+#define GRAPH_SCALE_STEP 500
+
+#define TILE_PIXELS (DISPLAY_WIDTH * DISPLAY_TILE_LINES)
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Types
+ * ----------------------------------------------------------------------------------------------------
+ */
+typedef enum {
+    WIDGET_POWER,
+    WIDGET_GRID,
+    WIDGET_SOC,
+} widget_kind_t;
+
+typedef struct graph_series {
+    history_t history;
+    decimator_t decimator;
+    uint16_t color;
+} graph_series_t;
+
+typedef struct widget {
+    widget_kind_t kind;
+    display_rect_t rect;
+    const char * label;
+    const char * unit;
+    uint16_t color;
+    int32_t value; // watts, or 0.1 % for WIDGET_SOC
+} widget_t;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static const display_backend_t * g_backend;
+
+static widget_t g_widgets[WIDGET_COUNT] = {
+    {WIDGET_POWER, {0, 0 * WIDGET_HEIGHT, DISPLAY_WIDTH, WIDGET_HEIGHT}, "PV", "W", DISPLAY_YELLOW, 0},
+    {WIDGET_POWER, {0, 1 * WIDGET_HEIGHT, DISPLAY_WIDTH, WIDGET_HEIGHT}, "Load", "W", DISPLAY_BLUE, 0},
+    {WIDGET_GRID,  {0, 2 * WIDGET_HEIGHT, DISPLAY_WIDTH, WIDGET_HEIGHT}, "Grid", "W", DISPLAY_RED, 0},
+    {WIDGET_SOC,   {0, 3 * WIDGET_HEIGHT, DISPLAY_WIDTH, WIDGET_HEIGHT}, "Battery", "%", DISPLAY_GREEN, 0},
+};
+
+static graph_series_t g_graph_series[] = {
+    {.color = DISPLAY_YELLOW}, // PV
+    {.color = DISPLAY_BLUE},   // Load
+};
+static const display_rect_t g_graph_rect = {0, GRAPH_TOP, DISPLAY_WIDTH, GRAPH_HEIGHT};
+static int16_t g_graph_scale = GRAPH_SCALE_STEP; // watts at the top of the plot
+
+static display_rect_t g_dirty[DISPLAY_MAX_DIRTY];
+static uint8_t g_dirty_count = 0;
+
+static uint16_t g_tile_buf[2][TILE_PIXELS];
+
+static display_stats_t g_stats;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Rectangles
+ * ----------------------------------------------------------------------------------------------------
+ */
+static bool rect_intersect(const display_rect_t * a, const display_rect_t * b, display_rect_t * out)
+{
+    int16_t x0 = a->x > b->x ? a->x : b->x;
+    int16_t y0 = a->y > b->y ? a->y : b->y;
+    int16_t x1 = (a->x + a->w) < (b->x + b->w) ? (a->x + a->w) : (b->x + b->w);
+    int16_t y1 = (a->y + a->h) < (b->y + b->h) ? (a->y + a->h) : (b->y + b->h);
+
+    if(x1 <= x0 || y1 <= y0) return false;
+
+    out->x = x0;
+    out->y = y0;
+    out->w = x1 - x0;
+    out->h = y1 - y0;
+    return true;
+}
+
+static void rect_union(display_rect_t * a, const display_rect_t * b)
+{
+    int16_t x0 = a->x < b->x ? a->x : b->x;
+    int16_t y0 = a->y < b->y ? a->y : b->y;
+    int16_t x1 = (a->x + a->w) > (b->x + b->w) ? (a->x + a->w) : (b->x + b->w);
+    int16_t y1 = (a->y + a->h) > (b->y + b->h) ? (a->y + a->h) : (b->y + b->h);
+
+    a->x = x0;
+    a->y = y0;
+    a->w = x1 - x0;
+    a->h = y1 - y0;
+}
+
+// Touching or overlapping rectangles are merged, sending them separately would not save anything
+static bool rect_touches(const display_rect_t * a, const display_rect_t * b)
+{
+    return a->x <= b->x + b->w && b->x <= a->x + a->w && a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Drawing
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void tile_fill(display_tile_t * tile, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    display_rect_t area = {x, y, w, h}, clip;
+
+    if(!rect_intersect(&area, &tile->rect, &clip)) return;
+
+    // Panel expects big endian pixels
+    uint16_t pixel = (color >> 8) | (color << 8);
+    for(int16_t row = 0; row < clip.h; row++)
+    {
+        uint16_t * dst = &tile->pixels[(clip.y - tile->rect.y + row) * tile->rect.w + (clip.x - tile->rect.x)];
+        for(int16_t col = 0; col < clip.w; col++) dst[col] = pixel;
+    }
+}
+
+// Right aligned number ending at x_right
+static void draw_number(display_tile_t * tile, int16_t x_right, int16_t y, int32_t value, uint16_t color)
+{
+    char text[12];
+
+    snprintf(text, sizeof(text), "%ld", (long)value);
+    font_draw_string(tile, &font_value, x_right - font_text_width(&font_value, text), y, text, color);
+}
+
+static uint16_t widget_color(const widget_t * widget)
+{
+    // Feed-in is shown green, import in the widget color
+    if(widget->kind == WIDGET_GRID && widget->value < 0) return DISPLAY_GREEN;
+    return widget->color;
+}
+
+static void widget_value_rect(const widget_t * widget, display_rect_t * rect)
+{
+    rect->x = VALUE_LEFT;
+    rect->y = widget->rect.y + VALUE_TOP;
+    rect->w = VALUE_RIGHT - VALUE_LEFT;
+    rect->h = font_value.height;
+    if(rect->h > widget->rect.h - VALUE_TOP) rect->h = widget->rect.h - VALUE_TOP;
+}
+
+static void widget_draw(display_tile_t * tile, const widget_t * widget)
+{
+    uint16_t color = widget_color(widget);
+
+    tile_fill(tile, widget->rect.x, widget->rect.y + 4, WIDGET_MARKER_WIDTH, widget->rect.h - 8, color);
+    font_draw_string(tile, &font_label, LABEL_LEFT, widget->rect.y + LABEL_TOP, widget->label, DISPLAY_WHITE);
+    font_draw_string(tile, &font_label, UNIT_RIGHT - font_text_width(&font_label, widget->unit),
+                     widget->rect.y + VALUE_TOP + font_value.ascent - font_label.ascent, widget->unit, DISPLAY_WHITE);
+
+    if(widget->kind == WIDGET_SOC)
+    {
+        int16_t filled = (int32_t)BAR_WIDTH * widget->value / 1000;
+
+        draw_number(tile, VALUE_RIGHT, widget->rect.y + VALUE_TOP, (widget->value + 5) / 10, color);
+        tile_fill(tile, BAR_LEFT, widget->rect.y + BAR_TOP, filled, BAR_HEIGHT, color);
+        tile_fill(tile, BAR_LEFT + filled, widget->rect.y + BAR_TOP, BAR_WIDTH - filled, BAR_HEIGHT, DISPLAY_GREY);
+    }
+    else
+    {
+        draw_number(tile, VALUE_RIGHT, widget->rect.y + VALUE_TOP, widget->value, color);
+    }
+}
+
+static int16_t graph_y(int16_t value)
+{
+    if(value < 0) value = 0;
+    if(value > g_graph_scale) value = g_graph_scale;
+    return GRAPH_PLOT_TOP + GRAPH_PLOT_HEIGHT - 1 - (int32_t)value * (GRAPH_PLOT_HEIGHT - 1) / g_graph_scale;
+}
+
+// One vertical line per column from min to max, extended to the last sample of the column before so
+// the graph stays connected. Only the columns inside the tile are visited.
+static void graph_draw_series(display_tile_t * tile, const graph_series_t * series, const display_rect_t * clip)
+{
+    const decimator_t * decimator = &series->decimator;
+    // Columns are right aligned, the newest sample is at the right edge
+    int16_t offset = DISPLAY_WIDTH - decimator->used;
+
+    for(int16_t x = clip->x; x < clip->x + clip->w; x++)
+    {
+        if(x < offset) continue;
+        const decimator_column_t * column = decimator_column(decimator, x - offset);
+        if(column == NULL) continue;
+
+        int16_t low = column->min, high = column->max;
+        const decimator_column_t * previous = decimator_column(decimator, x - offset - 1);
+        if(x > offset && previous != NULL)
+        {
+            if(previous->last < low) low = previous->last;
+            if(previous->last > high) high = previous->last;
+        }
+
+        int16_t top = graph_y(high);
+        tile_fill(tile, x, top, 1, graph_y(low) - top + 1, series->color);
+    }
+}
+
+static void graph_draw(display_tile_t * tile, const display_rect_t * clip)
+{
+    char text[12];
+
+    tile_fill(tile, g_graph_rect.x, g_graph_rect.y, g_graph_rect.w, 1, DISPLAY_GREY);
+    for(uint8_t i = 0; i < count_of(g_graph_series); i++) graph_draw_series(tile, &g_graph_series[i], clip);
+
+    snprintf(text, sizeof(text), "%dW", g_graph_scale);
+    font_draw_string(tile, &font_label, LABEL_LEFT, GRAPH_PLOT_TOP, text, DISPLAY_WHITE);
+}
+
+static void tile_render(display_tile_t * tile)
+{
+    display_rect_t clip;
+
+    tile_fill(tile, tile->rect.x, tile->rect.y, tile->rect.w, tile->rect.h, DISPLAY_BLACK);
+
+    for(uint8_t i = 0; i < WIDGET_COUNT; i++)
+    {
+        if(rect_intersect(&g_widgets[i].rect, &tile->rect, &clip)) widget_draw(tile, &g_widgets[i]);
+    }
+
+    if(rect_intersect(&g_graph_rect, &tile->rect, &clip)) graph_draw(tile, &clip);
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+void display_init(const display_backend_t * backend)
+{
+    g_backend = backend;
+    g_backend->init();
+
+    for(uint8_t i = 0; i < count_of(g_graph_series); i++)
+    {
+        history_init(&g_graph_series[i].history);
+        decimator_init(&g_graph_series[i].decimator, &g_graph_series[i].history, DISPLAY_WIDTH,
+                       GRAPH_SAMPLES_PER_COLUMN);
+    }
+
+    memset(&g_stats, 0, sizeof(g_stats));
+    display_invalidate(NULL);
+}
+
+void display_invalidate(const display_rect_t * rect)
+{
+    static const display_rect_t screen = {0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT};
+    display_rect_t area;
+
+    if(rect == NULL) rect = &screen;
+    if(!rect_intersect(rect, &screen, &area)) return;
+
+    for(uint8_t i = 0; i < g_dirty_count; i++)
+    {
+        if(rect_touches(&g_dirty[i], &area))
+        {
+            rect_union(&g_dirty[i], &area);
+            return;
+        }
+    }
+
+    if(g_dirty_count < DISPLAY_MAX_DIRTY)
+    {
+        g_dirty[g_dirty_count++] = area;
+    }
+    else
+    {
+        // Out of slots, collapse everything into one bounding box
+        for(uint8_t i = 1; i < g_dirty_count; i++) rect_union(&g_dirty[0], &g_dirty[i]);
+        rect_union(&g_dirty[0], &area);
+        g_dirty_count = 1;
+    }
+}
+
+static void widget_set_value(widget_t * widget, int32_t value)
+{
+    if(widget->value == value) return;
+
+    bool color_changed = widget->kind == WIDGET_GRID && ((widget->value < 0) != (value < 0));
+    widget->value = value;
+
+    if(color_changed || widget->kind == WIDGET_SOC)
+    {
+        display_invalidate(&widget->rect);
+    }
+    else
+    {
+        display_rect_t rect;
+        widget_value_rect(widget, &rect);
+        display_invalidate(&rect);
+    }
+}
+
+static int16_t graph_clamp(int32_t value)
+{
+    if(value < 0) return 0;
+    if(value > INT16_MAX) return INT16_MAX;
+    return value;
+}
+
+// Add a sample to each series. The decimators only fold the new sample into their newest column, so
+// unless a new column scrolls in or the scale changes only the rightmost column has to be redrawn.
+static void graph_add_sample(const power_data_t * data)
+{
+    bool scrolled = false, changed = false;
+    int16_t max = 0;
+
+    history_push(&g_graph_series[0].history, graph_clamp(data->ppv));
+    history_push(&g_graph_series[1].history, graph_clamp(data->pload));
+
+    for(uint8_t i = 0; i < count_of(g_graph_series); i++)
+    {
+        decimator_t * decimator = &g_graph_series[i].decimator;
+        decimator_column_t newest = {0};
+        int16_t series_min, series_max;
+
+        if(decimator->used > 0) newest = *decimator_column(decimator, decimator->used - 1);
+        uint16_t used = decimator->used, head = decimator->head;
+
+        decimator_update(decimator);
+
+        if(decimator->used != used || decimator->head != head) scrolled = true;
+        else if(memcmp(&newest, decimator_column(decimator, decimator->used - 1), sizeof(newest)) != 0) changed = true;
+
+        if(decimator_range(decimator, &series_min, &series_max) && series_max > max) max = series_max;
+    }
+
+    int32_t scale = ((int32_t)max + GRAPH_SCALE_STEP - 1) / GRAPH_SCALE_STEP * GRAPH_SCALE_STEP;
+    if(scale == 0) scale = GRAPH_SCALE_STEP;
+    if(scale > INT16_MAX) scale = INT16_MAX;
+
+    if(scrolled || scale != g_graph_scale)
+    {
+        g_graph_scale = scale;
+        display_invalidate(&g_graph_rect);
+    }
+    else if(changed)
+    {
+        display_rect_t column = {DISPLAY_WIDTH - 1, GRAPH_PLOT_TOP, 1, GRAPH_PLOT_HEIGHT};
+        display_invalidate(&column);
+    }
+}
+
+void display_set_values(const power_data_t * data)
+{
+    widget_set_value(&g_widgets[0], data->ppv);
+    widget_set_value(&g_widgets[1], data->pload);
+    widget_set_value(&g_widgets[2], data->pgrid);
+    widget_set_value(&g_widgets[3], data->soc);
+}
+
+void display_set_power_data(const power_data_t * data)
+{
+    display_set_values(data);
+    graph_add_sample(data);
+}
+
+bool display_update(void)
+{
+    if(g_dirty_count == 0) return false;
+
+    uint64_t start = to_us_since_boot(get_absolute_time());
+    uint32_t bytes = 0;
+    uint16_t tiles = 0;
+    uint8_t buf = 0;
+
+    g_backend->frame_start();
+
+    for(uint8_t i = 0; i < g_dirty_count; i++)
+    {
+        const display_rect_t * dirty = &g_dirty[i];
+
+        // Narrow rectangles get taller tiles so every tile fills the buffer
+        int16_t lines = TILE_PIXELS / dirty->w;
+        if(lines > dirty->h) lines = dirty->h;
+
+        for(int16_t y = dirty->y; y < dirty->y + dirty->h; y += lines)
+        {
+            display_tile_t tile = {{dirty->x, y, dirty->w, lines}, g_tile_buf[buf]};
+            if(y + lines > dirty->y + dirty->h) tile.rect.h = dirty->y + dirty->h - y;
+
+            // Rendered while the previous tile is still being sent from the other buffer
+            tile_render(&tile);
+            bytes += g_backend->tile_write(&tile.rect, tile.pixels);
+            tiles++;
+            buf ^= 1;
+        }
+    }
+
+    g_backend->tile_wait();
+    g_backend->frame_end();
+
+    uint32_t duration = to_us_since_boot(get_absolute_time()) - start;
+
+    g_stats.updates++;
+    g_stats.update_us = duration;
+    if(duration > g_stats.update_us_max) g_stats.update_us_max = duration;
+    g_stats.bytes = bytes;
+    g_stats.bytes_total += bytes;
+    g_stats.rects = g_dirty_count;
+    g_stats.tiles = tiles;
+
+    g_dirty_count = 0;
+    return true;
+}
+
+void display_get_stats(display_stats_t * stats)
+{
+    memcpy(stats, &g_stats, sizeof(*stats));
+}
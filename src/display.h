@@ -0,0 +1,99 @@
+/**
+ * display.h
+ * Jannis Lämmle
+ * Tile based renderer for the light switch display, only changed areas are redrawn and sent
+ */
+
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerData.h"
+
+/* Panel */
+#define DISPLAY_WIDTH 240
+#define DISPLAY_HEIGHT 320
+
+/* Panel connection (ST7789 on spi1), set to the port and SCK/MOSI pins of w5x00_spi.h to share spi0 */
+#define DISPLAY_SPI_PORT spi1
+#define DISPLAY_SPI_BAUD (40 * 1000 * 1000)
+
+#define DISPLAY_PIN_SCK 10
+#define DISPLAY_PIN_MOSI 11
+#define DISPLAY_PIN_DC 12
+#define DISPLAY_PIN_CS 13
+#define DISPLAY_PIN_RST 14
+#define DISPLAY_PIN_BL 15
+
+/* Rendering */
+// Lines per tile, two tiles of DISPLAY_WIDTH * DISPLAY_TILE_LINES pixels are kept in RAM
+#define DISPLAY_TILE_LINES 16
+// Dirty rectangles tracked per update, more are merged into their bounding box
+#define DISPLAY_MAX_DIRTY 8
+
+/* Colors (RGB565) */
+#define DISPLAY_RGB(r, g, b) ((uint16_t)((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3)))
+#define DISPLAY_BLACK DISPLAY_RGB(0, 0, 0)
+#define DISPLAY_WHITE DISPLAY_RGB(255, 255, 255)
+#define DISPLAY_GREY DISPLAY_RGB(64, 64, 64)
+#define DISPLAY_YELLOW DISPLAY_RGB(255, 200, 0)
+#define DISPLAY_BLUE DISPLAY_RGB(40, 140, 255)
+#define DISPLAY_RED DISPLAY_RGB(255, 60, 40)
+#define DISPLAY_GREEN DISPLAY_RGB(40, 220, 80)
+
+typedef struct display_rect {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+} display_rect_t;
+
+// Area being rendered, pixels are rect.w * rect.h
+typedef struct display_tile {
+    display_rect_t rect;
+    uint16_t * pixels;
+} display_tile_t;
+
+// Panel backend, pixels are RGB565 stored in the byte order of the panel (big endian)
+typedef struct display_backend {
+    void (*init)(void);
+    void (*frame_start)(void);
+    // Start sending a tile, may return before the transfer has finished. Returns the bytes sent to the panel
+    uint32_t (*tile_write)(const display_rect_t * rect, const uint16_t * pixels);
+    // Block until the last tile_write has finished and its buffer may be reused
+    void (*tile_wait)(void);
+    void (*frame_end)(void);
+} display_backend_t;
+
+typedef struct display_stats {
+    uint32_t updates;
+    uint32_t update_us;     // duration of the last update
+    uint32_t update_us_max;
+    uint32_t bytes;         // bytes sent to the panel in the last update
+    uint64_t bytes_total;
+    uint16_t rects;         // dirty rectangles drawn in the last update
+    uint16_t tiles;         // tiles sent in the last update
+} display_stats_t;
+
+/*********************************************
+* Display Functions
+*********************************************/
+void display_init(const display_backend_t * backend); // Initialize the panel and draw everything on the next update
+void display_set_power_data(const power_data_t * data); // Update the widgets, only changed widgets are marked dirty, and add a graph sample
+void display_set_values(const power_data_t * data); // Update the widgets only, for samples between two graph samples (10 s apart)
+void display_invalidate(const display_rect_t * rect); // Force a redraw of an area, NULL for the whole screen
+bool display_update(void); // Render and send all dirty areas, returns false if nothing was dirty
+void display_get_stats(display_stats_t * stats);
+
+/*********************************************
+* Backends
+*********************************************/
+#if PICO_ON_DEVICE
+const display_backend_t * display_st7789_backend(void); // ST7789 via DISPLAY_SPI_PORT and DMA
+#else
+const display_backend_t * display_ppm_backend(const char * path_prefix); // Writes <path_prefix>_<n>.ppm per update
+#endif
+
+#endif /* DISPLAY_H_ */
@@ -0,0 +1,92 @@
+/**
+ * displayPpm.c
+ * Jannis Lämmle
+ * Host backend for the display, tiles are collected in a framebuffer and every update is written as a ppm image
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "display.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static const char * g_path_prefix;
+static uint32_t g_frame = 0;
+static uint16_t g_framebuffer[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void ppm_init(void)
+{
+    g_frame = 0;
+    memset(g_framebuffer, 0, sizeof(g_framebuffer));
+}
+
+static void ppm_frame_start(void)
+{
+}
+
+static uint32_t ppm_tile_write(const display_rect_t * rect, const uint16_t * pixels)
+{
+    for(int16_t row = 0; row < rect->h; row++)
+    {
+        memcpy(&g_framebuffer[rect->y + row][rect->x], &pixels[row * rect->w], rect->w * sizeof(uint16_t));
+    }
+
+    // Same accounting as the panel: pixels plus the window commands
+    return (uint32_t)rect->w * rect->h * 2 + 11;
+}
+
+static void ppm_tile_wait(void)
+{
+}
+
+static void ppm_frame_end(void)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s_%04u.ppm", g_path_prefix, (unsigned)g_frame++);
+
+    FILE * file = fopen(path, "wb");
+    if(file == NULL)
+    {
+        printf(" Display: can not write %s\n", path);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    for(int16_t y = 0; y < DISPLAY_HEIGHT; y++)
+    {
+        for(int16_t x = 0; x < DISPLAY_WIDTH; x++)
+        {
+            // Stored big endian like on the panel
+            uint16_t pixel = (g_framebuffer[y][x] >> 8) | (g_framebuffer[y][x] << 8);
+            uint8_t rgb[3] = {
+                ((pixel >> 11) & 0x1F) << 3,
+                ((pixel >> 5) & 0x3F) << 2,
+                (pixel & 0x1F) << 3,
+            };
+            fwrite(rgb, 1, sizeof(rgb), file);
+        }
+    }
+    fclose(file);
+}
+
+const display_backend_t * display_ppm_backend(const char * path_prefix)
+{
+    static const display_backend_t backend = {
+        .init = ppm_init,
+        .frame_start = ppm_frame_start,
+        .tile_write = ppm_tile_write,
+        .tile_wait = ppm_tile_wait,
+        .frame_end = ppm_frame_end,
+    };
+    g_path_prefix = path_prefix;
+    return &backend;
+}
@@ -0,0 +1,103 @@
+/**
+ * displayPreview.c
+ * Jannis Lämmle
+ * Host program rendering a few updates of the display into ppm files and reporting their cost,
+ * followed by a day of synthetic samples for the history graph and the glyph throughput of the text renderer
+ *
+ * Usage: AlphaESS_display_preview [path_prefix]
+ */
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "display.h"
+#include "font.h"
+#include "font_data.h"
+
+#define GLYPH_BENCH_US 500000
+// One day at one sample per 10 s
+#define HISTORY_SAMPLES 8640
+
+// ppv, pload, pgrid, pbat, soc
+static const power_data_t g_samples[] = {
+    {0, 412, 412, 0, 153, 0},
+    {1250, 430, -820, 0, 153, 0},
+    {1320, 455, -865, 0, 154, 0},
+    {3480, 1980, -120, -1380, 171, 0},
+    {3480, 1980, -120, -1380, 171, 0}, // unchanged, nothing is sent
+    {210, 2650, 1440, 1000, 655, 0},
+};
+
+// Feed a day of PV and load with short load peaks, the graph has to keep every peak visible
+static void bench_history(void)
+{
+    power_data_t data = {0};
+    uint64_t start = to_us_since_boot(get_absolute_time());
+
+    for(uint32_t i = 0; i < HISTORY_SAMPLES; i++)
+    {
+        int32_t t = i % 8640; // 10 s steps since midnight
+        int32_t sun = t > 2160 && t < 6480 ? (t - 2160) * (6480 - t) / 1166 : 0; // parabola peaking at 4000 W
+
+        data.ppv = sun;
+        data.pload = 300 + (i % 97 == 0 ? 2800 : 0) + (i * 37 % 120);
+        data.pgrid = data.pload - data.ppv;
+        display_set_power_data(&data);
+    }
+
+    uint64_t fed = to_us_since_boot(get_absolute_time());
+    display_stats_t stats;
+    bool sent = display_update();
+    display_get_stats(&stats);
+
+    printf("samples=%u us_per_sample=%.2f sent=%d update_us=%u bytes=%u\n", (unsigned)HISTORY_SAMPLES,
+           (double)(fed - start) / HISTORY_SAMPLES, sent, (unsigned)stats.update_us, (unsigned)stats.bytes);
+}
+
+// Blit the value font into a tile until GLYPH_BENCH_US have passed
+static void bench_glyphs(void)
+{
+    static uint16_t pixels[DISPLAY_WIDTH * 64];
+    display_tile_t tile = {{0, 0, DISPLAY_WIDTH, 64}, pixels};
+    uint64_t start = to_us_since_boot(get_absolute_time()), now;
+    uint32_t glyphs = 0;
+
+    do
+    {
+        for(uint8_t i = 0; i < 100; i++)
+        {
+            font_draw_string(&tile, &font_value, 0, 0, "-1234567", DISPLAY_WHITE);
+            glyphs += 8;
+        }
+        now = to_us_since_boot(get_absolute_time());
+    } while(now - start < GLYPH_BENCH_US);
+
+    printf("glyphs=%u us=%u glyphs_per_s=%u\n", (unsigned)glyphs, (unsigned)(now - start),
+           (unsigned)((uint64_t)glyphs * 1000000 / (now - start)));
+}
+
+int main(int argc, char ** argv)
+{
+    stdio_init_all();
+
+    display_init(display_ppm_backend(argc > 1 ? argv[1] : "display"));
+
+    for(uint32_t i = 0; i < count_of(g_samples); i++)
+    {
+        display_stats_t stats;
+
+        display_set_power_data(&g_samples[i]);
+        bool sent = display_update();
+        display_get_stats(&stats);
+
+        printf("update=%u sent=%d us=%u bytes=%u rects=%u tiles=%u\n",
+               (unsigned)i, sent, (unsigned)(sent ? stats.update_us : 0), (unsigned)(sent ? stats.bytes : 0),
+               sent ? stats.rects : 0, sent ? stats.tiles : 0);
+    }
+
+    bench_history();
+    bench_glyphs();
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * displaySt7789.c
+ * Jannis Lämmle
+ * ST7789 panel backend, tiles are sent by DMA so the next tile can be rendered meanwhile. Each tile is a
+ * transaction on the SPI bus, so a device sharing the controller (W5x00) gets the bus between two tiles
+ */
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/spi.h"
+
+#include "display.h"
+#include "spi_bus.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Macros
+ * ----------------------------------------------------------------------------------------------------
+ */
+/* ST7789 commands */
+#define ST7789_SWRESET 0x01
+#define ST7789_SLPOUT 0x11
+#define ST7789_NORON 0x13
+#define ST7789_INVON 0x21
+#define ST7789_DISPON 0x29
+#define ST7789_CASET 0x2A
+#define ST7789_RASET 0x2B
+#define ST7789_RAMWR 0x2C
+#define ST7789_MADCTL 0x36
+#define ST7789_COLMOD 0x3A
+
+// CASET, RASET and RAMWR with their parameters
+#define WINDOW_BYTES 11
+
+// Served after the W5x00 on a shared bus
+#define DISPLAY_SPI_PRIORITY 1
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Variables
+ * ----------------------------------------------------------------------------------------------------
+ */
+static spi_bus_device_t g_display_spi;
+static bool g_transfer_active = false;
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void st7789_command(uint8_t cmd, const uint8_t * params, size_t len)
+{
+    gpio_put(DISPLAY_PIN_DC, 0);
+    spi_bus_write(&g_display_spi, &cmd, 1);
+
+    if(len)
+    {
+        gpio_put(DISPLAY_PIN_DC, 1);
+        spi_bus_write(&g_display_spi, params, len);
+    }
+}
+
+static void st7789_wait(void)
+{
+    if(!g_transfer_active) return;
+
+    // Waits for the DMA and hands the bus on
+    spi_bus_release(&g_display_spi);
+    g_transfer_active = false;
+}
+
+static void st7789_init(void)
+{
+    static const spi_bus_device_config_t config = {
+        .cs_pin = DISPLAY_PIN_CS,
+        .baudrate = DISPLAY_SPI_BAUD,
+        .cpol = SPI_CPOL_1,
+        .cpha = SPI_CPHA_1,
+        .priority = DISPLAY_SPI_PRIORITY,
+    };
+    // Write only, on a bus shared with the W5x00 its MISO is already set up
+    spi_bus_t * bus = spi_bus_init(DISPLAY_SPI_PORT, DISPLAY_PIN_SCK, DISPLAY_PIN_MOSI, -1);
+    spi_bus_add_device(bus, &g_display_spi, &config);
+    bi_decl(bi_2pins_with_func(DISPLAY_PIN_MOSI, DISPLAY_PIN_SCK, GPIO_FUNC_SPI));
+
+    gpio_init(DISPLAY_PIN_DC);
+    gpio_set_dir(DISPLAY_PIN_DC, GPIO_OUT);
+
+    gpio_init(DISPLAY_PIN_RST);
+    gpio_set_dir(DISPLAY_PIN_RST, GPIO_OUT);
+
+    gpio_init(DISPLAY_PIN_BL);
+    gpio_set_dir(DISPLAY_PIN_BL, GPIO_OUT);
+
+    bi_decl(bi_1pin_with_name(DISPLAY_PIN_CS, "Display CHIP SELECT"));
+    bi_decl(bi_1pin_with_name(DISPLAY_PIN_DC, "Display DATA/COMMAND"));
+    bi_decl(bi_1pin_with_name(DISPLAY_PIN_RST, "Display RESET"));
+    bi_decl(bi_1pin_with_name(DISPLAY_PIN_BL, "Display BACKLIGHT"));
+
+    gpio_put(DISPLAY_PIN_RST, 0);
+    sleep_ms(10);
+    gpio_put(DISPLAY_PIN_RST, 1);
+    sleep_ms(120);
+
+    static const uint8_t colmod = 0x55; // 16 bit RGB565
+    static const uint8_t madctl = 0x00; // portrait, RGB order
+
+    spi_bus_acquire(&g_display_spi);
+    st7789_command(ST7789_SWRESET, NULL, 0);
+    sleep_ms(150);
+    st7789_command(ST7789_SLPOUT, NULL, 0);
+    sleep_ms(10);
+    st7789_command(ST7789_COLMOD, &colmod, 1);
+    st7789_command(ST7789_MADCTL, &madctl, 1);
+    st7789_command(ST7789_INVON, NULL, 0);
+    st7789_command(ST7789_NORON, NULL, 0);
+    st7789_command(ST7789_DISPON, NULL, 0);
+    spi_bus_release(&g_display_spi);
+
+    gpio_put(DISPLAY_PIN_BL, 1);
+}
+
+static void st7789_frame_start(void)
+{
+    // The bus is acquired per tile
+}
+
+static uint32_t st7789_tile_write(const display_rect_t * rect, const uint16_t * pixels)
+{
+    uint16_t x1 = rect->x + rect->w - 1;
+    uint16_t y1 = rect->y + rect->h - 1;
+    uint8_t caset[4] = {rect->x >> 8, rect->x & 0xFF, x1 >> 8, x1 & 0xFF};
+    uint8_t raset[4] = {rect->y >> 8, rect->y & 0xFF, y1 >> 8, y1 & 0xFF};
+    uint32_t len = (uint32_t)rect->w * rect->h * 2;
+
+    // Release the bus after the previous tile, so a waiting device gets it before the next one
+    st7789_wait();
+    spi_bus_acquire(&g_display_spi);
+
+    st7789_command(ST7789_CASET, caset, sizeof(caset));
+    st7789_command(ST7789_RASET, raset, sizeof(raset));
+    st7789_command(ST7789_RAMWR, NULL, 0);
+
+    gpio_put(DISPLAY_PIN_DC, 1);
+    spi_bus_write_start(&g_display_spi, (const uint8_t *)pixels, len);
+    g_transfer_active = true;
+
+    return len + WINDOW_BYTES;
+}
+
+static void st7789_frame_end(void)
+{
+    // spi_bus_wait() drops whatever the panel clocked back in while we only transmitted
+    st7789_wait();
+}
+
+const display_backend_t * display_st7789_backend(void)
+{
+    static const display_backend_t backend = {
+        .init = st7789_init,
+        .frame_start = st7789_frame_start,
+        .tile_write = st7789_tile_write,
+        .tile_wait = st7789_wait,
+        .frame_end = st7789_frame_end,
+    };
+    return &backend;
+}
@@ -0,0 +1,120 @@
+/**
+ * font.c
+ * Jannis Lämmle
+ * Blits run length encoded glyphs straight into a display tile, background runs are skipped
+ */
+
+#include <stddef.h>
+
+#include "font.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Functions
+ * ----------------------------------------------------------------------------------------------------
+ */
+static const font_glyph_t * font_glyph(const font_t * font, char c)
+{
+    uint8_t i = (uint8_t)c - 32;
+
+    if(i >= 96 || font->index[i] == 0xFF) return NULL;
+    return &font->glyphs[font->index[i]];
+}
+
+static void glyph_blit(display_tile_t * tile, const font_t * font, const font_glyph_t * glyph, int16_t x, int16_t y, uint16_t pixel)
+{
+    const int16_t tx0 = tile->rect.x, ty0 = tile->rect.y;
+    const int16_t tx1 = tx0 + tile->rect.w, ty1 = ty0 + tile->rect.h;
+
+    x += glyph->x_offset;
+    y += glyph->y_offset;
+
+    if(x >= tx1 || y >= ty1 || x + glyph->width <= tx0 || y + glyph->height <= ty0) return;
+
+    const uint8_t * run = &font->runs[glyph->run_offset];
+    const uint8_t * end = run + glyph->run_count;
+    int16_t col = 0, row = y;
+
+    // Most glyphs are completely inside the tile, only rows have to be checked then
+    const bool clip_x = x < tx0 || x + glyph->width > tx1;
+
+    while(run < end)
+    {
+        uint8_t len = *run & 0x7F;
+
+        if(!(*run++ & 0x80))
+        {
+            col += len;
+            while(col >= glyph->width)
+            {
+                col -= glyph->width;
+                row++;
+            }
+            continue;
+        }
+
+        while(len)
+        {
+            uint8_t span = glyph->width - col;
+            if(span > len) span = len;
+
+            if(row >= ty1) return;
+            if(row >= ty0)
+            {
+                int16_t x0 = x + col, x1 = x0 + span;
+                if(clip_x)
+                {
+                    if(x0 < tx0) x0 = tx0;
+                    if(x1 > tx1) x1 = tx1;
+                }
+
+                uint16_t * dst = &tile->pixels[(row - ty0) * tile->rect.w + (x0 - tx0)];
+                for(int16_t i = 0; i < x1 - x0; i++) dst[i] = pixel;
+            }
+
+            len -= span;
+            col += span;
+            if(col == glyph->width)
+            {
+                col = 0;
+                row++;
+            }
+        }
+    }
+}
+
+int16_t font_text_width(const font_t * font, const char * str)
+{
+    int16_t width = 0;
+
+    for(; *str; str++)
+    {
+        const font_glyph_t * glyph = font_glyph(font, *str);
+        if(glyph) width += glyph->advance;
+    }
+
+    return width;
+}
+
+int16_t font_draw_string(display_tile_t * tile, const font_t * font, int16_t x, int16_t y, const char * str, uint16_t color)
+{
+    // Panel expects big endian pixels
+    uint16_t pixel = (color >> 8) | (color << 8);
+
+    // Skip strings outside of the tile without looking at the glyphs
+    if(y >= tile->rect.y + tile->rect.h || y + font->height <= tile->rect.y)
+    {
+        return x + font_text_width(font, str);
+    }
+
+    for(; *str; str++)
+    {
+        const font_glyph_t * glyph = font_glyph(font, *str);
+        if(glyph == NULL) continue;
+
+        glyph_blit(tile, font, glyph, x, y, pixel);
+        x += glyph->advance;
+    }
+
+    return x;
+}
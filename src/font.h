@@ -0,0 +1,40 @@
+/**
+ * font.h
+ * Jannis Lämmle
+ * Text rendering from glyph tables generated at build time (scripts/font_gen.py)
+ */
+
+#ifndef FONT_H_
+#define FONT_H_
+
+#include <stdint.h>
+
+#include "display.h"
+
+// Glyph bitmap stored as runs, bit 7 set for foreground, bits 0-6 the run length
+typedef struct font_glyph {
+    uint16_t run_offset;
+    uint16_t run_count;
+    uint8_t width;
+    uint8_t height;
+    int8_t x_offset;    // from the pen position
+    int8_t y_offset;    // from the top of the line
+    uint8_t advance;
+} font_glyph_t;
+
+typedef struct font {
+    uint8_t height;
+    uint8_t ascent;
+    uint8_t glyph_count;
+    uint8_t index[96];  // ascii 32-127 to glyph, 0xFF if not generated
+    const font_glyph_t * glyphs;
+    const uint8_t * runs;
+} font_t;
+
+/*********************************************
+* Font Functions
+*********************************************/
+int16_t font_text_width(const font_t * font, const char * str); // Width of str in pixels
+int16_t font_draw_string(display_tile_t * tile, const font_t * font, int16_t x, int16_t y, const char * str, uint16_t color); // Draw str with its top left at x/y (clipped to the tile), returns the x after the last glyph
+
+#endif /* FONT_H_ */
@@ -0,0 +1,143 @@
+/**
+ * history.c
+ * Jannis Lämmle
+ * Sample history and min/max preserving decimation of it for graphs
+ *
+ * The decimator keeps first, last, min and max (M4) of every column. Drawing a vertical line from min to
+ * max per column, joined to the previous column's last sample, gives the same pixels as drawing every
+ * sample, so peaks are never lost. New samples only touch the newest column, older ones are not revisited.
+ */
+
+#include <string.h>
+
+#include "history.h"
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * History
+ * ----------------------------------------------------------------------------------------------------
+ */
+void history_init(history_t * history)
+{
+    memset(history, 0, sizeof(*history));
+}
+
+void history_push(history_t * history, int16_t value)
+{
+    history->samples[history->count & (HISTORY_LENGTH - 1)] = value;
+    history->count++;
+}
+
+uint32_t history_first(const history_t * history)
+{
+    return history->count > HISTORY_LENGTH ? history->count - HISTORY_LENGTH : 0;
+}
+
+int16_t history_get(const history_t * history, uint32_t index)
+{
+    return history->samples[index & (HISTORY_LENGTH - 1)];
+}
+
+/**
+ * ----------------------------------------------------------------------------------------------------
+ * Decimator
+ * ----------------------------------------------------------------------------------------------------
+ */
+static void decimator_reset(decimator_t * decimator, uint32_t next)
+{
+    decimator->head = 0;
+    decimator->used = 0;
+    decimator->fill = 0;
+    decimator->next = next;
+}
+
+static void decimator_push(decimator_t * decimator, int16_t value)
+{
+    decimator_column_t * column;
+
+    if(decimator->used == 0 || decimator->fill == decimator->samples_per_column)
+    {
+        // Start a new column, dropping the oldest one when the graph is full
+        if(decimator->used == decimator->width)
+        {
+            decimator->head = (decimator->head + 1) % decimator->width;
+            decimator->used--;
+        }
+
+        column = &decimator->columns[(decimator->head + decimator->used) % decimator->width];
+        column->min = value;
+        column->max = value;
+        column->first = value;
+        decimator->used++;
+        decimator->fill = 0;
+    }
+    else
+    {
+        column = &decimator->columns[(decimator->head + decimator->used - 1) % decimator->width];
+        if(value < column->min) column->min = value;
+        if(value > column->max) column->max = value;
+    }
+
+    column->last = value;
+    decimator->fill++;
+}
+
+void decimator_init(decimator_t * decimator, const history_t * history, uint16_t width, uint16_t samples_per_column)
+{
+    if(width > DECIMATOR_MAX_COLUMNS) width = DECIMATOR_MAX_COLUMNS;
+    if(samples_per_column == 0) samples_per_column = 1;
+
+    decimator->history = history;
+    decimator->width = width;
+    decimator->samples_per_column = samples_per_column;
+    // Consume whatever the history already holds on the first update
+    decimator_reset(decimator, 0);
+}
+
+bool decimator_update(decimator_t * decimator)
+{
+    const history_t * history = decimator->history;
+    uint32_t window = (uint32_t)decimator->width * decimator->samples_per_column;
+    uint32_t first = history_first(history);
+
+    if(decimator->next == history->count) return false;
+
+    if(decimator->next < first || history->count - decimator->next > window)
+    {
+        // Fell behind by more than the graph shows, rebuild from the newest window. Columns start on a
+        // multiple of samples_per_column so they cover the same samples as when built incrementally.
+        uint32_t start = history->count > window ? history->count - window : 0;
+        if(start < first) start = first;
+        start = (start + decimator->samples_per_column - 1) / decimator->samples_per_column * decimator->samples_per_column;
+        decimator_reset(decimator, start);
+    }
+
+    while(decimator->next != history->count)
+    {
+        decimator_push(decimator, history_get(history, decimator->next));
+        decimator->next++;
+    }
+
+    return true;
+}
+
+const decimator_column_t * decimator_column(const decimator_t * decimator, uint16_t x)
+{
+    if(x >= decimator->used) return NULL;
+    return &decimator->columns[(decimator->head + x) % decimator->width];
+}
+
+bool decimator_range(const decimator_t * decimator, int16_t * min, int16_t * max)
+{
+    if(decimator->used == 0) return false;
+
+    *min = INT16_MAX;
+    *max = INT16_MIN;
+    for(uint16_t x = 0; x < decimator->used; x++)
+    {
+        const decimator_column_t * column = &decimator->columns[(decimator->head + x) % decimator->width];
+        if(column->min < *min) *min = column->min;
+        if(column->max > *max) *max = column->max;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+/**
+ * history.h
+ * Jannis Lämmle
+ * Sample history and min/max preserving decimation of it for graphs
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Samples kept per series, has to be a power of two
+#define HISTORY_LENGTH 8192
+// Columns a decimator can produce (display width)
+#define DECIMATOR_MAX_COLUMNS 240
+
+// Ring of the newest HISTORY_LENGTH samples
+typedef struct history {
+    int16_t samples[HISTORY_LENGTH];
+    uint32_t count; // samples pushed in total, the newest one is count - 1
+} history_t;
+
+// M4 aggregate of the samples falling into one column
+typedef struct decimator_column {
+    int16_t min;
+    int16_t max;
+    int16_t first;
+    int16_t last;
+} decimator_column_t;
+
+// Incremental M4 decimation of the newest width * samples_per_column samples of a history.
+// Columns are kept as a ring so a new column scrolls the graph without touching the others.
+typedef struct decimator {
+    const history_t * history;
+    uint16_t width;
+    uint16_t samples_per_column;
+    uint16_t head;          // ring position of the oldest column
+    uint16_t used;          // columns holding samples
+    uint16_t fill;          // samples in the newest column
+    uint32_t next;          // next history sample to consume
+    decimator_column_t columns[DECIMATOR_MAX_COLUMNS];
+} decimator_t;
+
+/*********************************************
+* History Functions
+*********************************************/
+void history_init(history_t * history);
+void history_push(history_t * history, int16_t value);
+uint32_t history_first(const history_t * history); // Oldest sample still available
+int16_t history_get(const history_t * history, uint32_t index); // index between history_first() and count - 1
+
+/*********************************************
+* Decimator Functions
+*********************************************/
+void decimator_init(decimator_t * decimator, const history_t * history, uint16_t width, uint16_t samples_per_column);
+bool decimator_update(decimator_t * decimator); // Consume new history samples in O(new samples), returns true if any column changed
+const decimator_column_t * decimator_column(const decimator_t * decimator, uint16_t x); // x = 0 is the oldest column, NULL if empty
+bool decimator_range(const decimator_t * decimator, int16_t * min, int16_t * max); // Min/max over all columns in O(width)
+
+#endif /* HISTORY_H_ */
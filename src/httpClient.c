@@ -13,6 +13,9 @@
 #include "wizchip_conf.h"
 #include "socket.h"
 #include "httpClient.h"
+#include "w5x00_socket_cache.h"
+#include "log.h"
+#include "trace.h"
 
 /* Private define ------------------------------------------------------------*/
 
@@ -71,12 +74,10 @@ uint8_t httpc_connection_handler()
 
 	uint16_t source_port;
 
-#ifdef _HTTPCLIENT_DEBUG_
-	uint8_t destip[4] = {0, };
-	uint16_t destport = 0;
-#endif
-
-	uint8_t state = getSn_SR(httpsock);
+	TRACE_BEGIN(HTTPC_HANDLER, 0);
+	// One snapshot of the socket registers serves this pass and the following httpc_connect()
+	w5x00_socket_cache_tick();
+	uint8_t state = w5x00_socket_cache_sr(httpsock);
 	switch(state)
 	{
 		case SOCK_INIT:
@@ -85,25 +86,28 @@ uint8_t httpc_connection_handler()
 			break;
 
 		case SOCK_ESTABLISHED:
-			if(getSn_IR(httpsock) & Sn_IR_CON)
+			if(w5x00_socket_cache_ir(httpsock) & Sn_IR_CON)
 			{
-#ifdef _HTTPCLIENT_DEBUG_
-				// Serial debug message printout
-				getsockopt(httpsock, SO_DESTIP, &destip);
-				getsockopt(httpsock, SO_DESTPORT, &destport);
-				printf(" > HTTP CLIENT: CONNECTED TO - %d.%d.%d.%d : %d\r\n",destip[0], destip[1], destip[2], destip[3], destport);
-#endif
+				if(LOG_ENABLED(HTTPC_CONNECTED))
+				{
+					uint8_t destip[4] = {0, };
+					uint16_t destport = 0;
+
+					w5x00_socket_cache_dest(httpsock, destip, &destport);
+					LOG(HTTPC_CONNECTED, destip[0], destip[1], destip[2], destip[3], destport);
+				}
 				httpc_isConnected = HTTPC_TRUE;
 
-				setSn_IR(httpsock, Sn_IR_CON);
+				w5x00_socket_cache_clear_ir(httpsock, Sn_IR_CON);
 			}
 
-			httpc_isReceived = getSn_RX_RSR(httpsock);
+			httpc_isReceived = w5x00_socket_cache_rx_rsr(httpsock);
 			ret = HTTPC_CONNECTED;
 			break;
 
 		case SOCK_CLOSE_WAIT:
 			disconnect(httpsock);
+			w5x00_socket_cache_invalidate(httpsock);
 			break;
 
 		case SOCK_FIN_WAIT:
@@ -112,17 +116,14 @@ uint8_t httpc_connection_handler()
 			httpc_isConnected = HTTPC_FALSE;
 
 			source_port = get_httpc_any_port();
-#ifdef _HTTPCLIENT_DEBUG_
-			printf(" > HTTP CLIENT: source_port = %d\r\n", source_port);
-#endif
+			LOG(HTTPC_SOURCE_PORT, source_port);
 
 			if(socket(httpsock, Sn_MR_TCP, source_port, Sn_MR_ND) == httpsock)
 			{
+				w5x00_socket_cache_invalidate(httpsock);
 				if(httpc_isSockOpen == HTTPC_FALSE)
 				{
-#ifdef _HTTPCLIENT_DEBUG_
-					printf(" > HTTP CLIENT: SOCKOPEN\r\n");
-#endif
+					LOG(HTTPC_SOCKOPEN);
 					httpc_isSockOpen = HTTPC_TRUE;
 				}
 			}
@@ -134,6 +135,7 @@ uint8_t httpc_connection_handler()
 			break;
 	}
 
+	TRACE_END(HTTPC_HANDLER, state);
 	return ret;
 }
 
@@ -147,9 +149,18 @@ uint8_t httpc_connect()
 	{
 		if(httpc_isSockOpen == HTTPC_TRUE)
 		{
-			// TCP connect
-			ret = connect(httpsock, dest_ip, dest_port);
-			if(ret == SOCK_OK) ret = HTTPC_TRUE;
+			// connect() reads Sn_MR and Sn_SR and fails unless the socket is in SOCK_INIT, skip it otherwise
+			if(w5x00_socket_cache_sr(httpsock) == SOCK_INIT)
+			{
+				// TCP connect
+				ret = connect(httpsock, dest_ip, dest_port);
+				w5x00_socket_cache_invalidate(httpsock);
+				if(ret == SOCK_OK) ret = HTTPC_TRUE;
+			}
+			else
+			{
+				w5x00_socket_cache_count_skipped(1); // Sn_MR, Sn_SR was counted by the cached read
+			}
 		}
 	}
 
@@ -215,10 +226,8 @@ uint16_t httpc_send_header(HttpRequest * req, uint8_t * buf, uint8_t * customHea
 
 		len += sprintf((char *)buf+len, "\r\n");
 
-#ifdef _HTTPCLIENT_DEBUG_
-		printf(" >> HTTP Request header - Method: %s, URI: %s, Content-Length: %d\r\n", req->method, req->uri, content_len);
-		printf("%s", buf);
-#endif
+		LOG(HTTPC_HEADER, content_len);
+		LOG_DATA(HTTPC_HEADER_DATA, buf, len);
 		send(httpsock, buf, len);
 	}
 	else
@@ -235,24 +244,13 @@ uint16_t httpc_send_body(uint8_t * buf, uint16_t len)
 {
 	uint16_t sentlen = 0;
 
-#ifdef _HTTPCLIENT_DEBUG_
-	uint16_t i;
-#endif
-
 	if(httpc_isConnected == HTTPC_TRUE)
 	{
 		do{
 			sentlen += send(httpsock, buf, len);
 		} while(sentlen < len);
 
-#ifdef _HTTPCLIENT_DEBUG_
-		if(sentlen > 0)
-		{
-			printf(" >> HTTP Request Body\r\n");
-			for(i = 0; i < sentlen; i++) printf("%c", buf[i]);
-			printf("\r\n");
-		}
-#endif
+		if(sentlen > 0) LOG_DATA(HTTPC_BODY_DATA, buf, sentlen);
 	}
 	else
 	{
@@ -314,11 +312,8 @@ uint16_t httpc_send(HttpRequest * req, uint8_t * buf, uint8_t * body, uint16_t c
 			buf[len++] = body[i];
 		}
 
-//#ifdef _HTTPCLIENT_DEBUG_
-		printf(" >> HTTP Request - Method: %s, URI: %s, Content-Length: %d\r\n", req->method, req->uri, content_len);
-		for(i = 0; i < len; i++) printf("%c", buf[i]);
-		printf("\r\n");
-//#endif
+		LOG(HTTPC_REQUEST, content_len);
+		LOG_DATA(HTTPC_REQUEST_DATA, buf, len);
 		send(httpsock, buf, len);
 	}
 	else
@@ -356,16 +351,12 @@ uint8_t httpc_disconnect(void)
 
 	if(httpc_isConnected == HTTPC_TRUE)
 	{
-#ifdef _HTTPCLIENT_DEBUG_
-		printf(" > HTTP CLIENT: Try to disconnect\r\n");
-#endif
+		LOG(HTTPC_DISCONNECT);
 		ret = disconnect(httpsock);
 		if(ret == SOCK_OK)
 		{
 			ret = HTTPC_TRUE;
-#ifdef _HTTPCLIENT_DEBUG_
-			printf(" > HTTP CLIENT: Disconnected\r\n");
-#endif
+			LOG(HTTPC_DISCONNECTED);
 		}
 	}
 
@@ -11,8 +11,7 @@
 #include <stdint.h>
 
 
-// HTTP client debug message enable
-#define _HTTPCLIENT_DEBUG_
+// HTTP client debug messages are logged through port/debug/log.h, see log_messages.def for their levels
 
 // Data buffer size
 #ifndef DATA_BUF_SIZE
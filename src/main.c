@@ -1,10 +1,88 @@
 #include "alphaESS.h"
+#include "display.h"
+#include "control.h"
+#include "canSource.h"
+#include "spi_bus.h"
+#include "can_bus.h"
+
+// Polls between two reports of the SPI bus contention and the CAN bus loads
+#define SPI_BUS_REPORT_POLLS 60
+
+// Cloud api poll interval, local samples over CAN are checked in between
+#define CLOUD_POLL_MS 10000
+#define LOCAL_POLL_MS 50
+
+// The history graph takes one sample per 10 s (GRAPH_SAMPLES_PER_COLUMN of display.c), faster local samples
+// only update the values
+#define GRAPH_SAMPLE_US (10 * 1000 * 1000)
+
+// Wall clock over SNTP while the cloud api is not polled, retried every CLOUD_POLL_MS until it is known
+#define TIME_SYNC_US (60 * 60 * 1000000ull)
+
+static void update_display(void){
+    TRACE_BEGIN(DISPLAY_UPDATE, 0);
+    display_update();
+    TRACE_END(DISPLAY_UPDATE, 0);
+}
 
 int main(){
     stdio_init_all();
+    log_init();
     alphaESS_setup();
+    control_init();
+    display_init(display_st7789_backend());
+    can_source_setup();
+    uint32_t polls = 0;
+    uint32_t unix_offset = 0; // unix time at boot, known after the first cloud sample or time sync
+    uint64_t time_synced = 0;
+    uint64_t graph_slot = UINT64_MAX;
     while(true){
-        alphaESS_run();
-        sleep_ms(10000);
+        // The cloud api only while the local source is silent
+        if(!can_source_fresh()){
+            TRACE_BEGIN(POLL, 0);
+            bool success = alphaESS_run();
+            TRACE_END(POLL, success);
+            if(success){
+                unix_offset = alphaESS_power_data()->timestamp - (uint32_t)(time_us_64() / 1000000);
+                time_synced = time_us_64();
+                control_sample(alphaESS_power_data());
+                display_set_power_data(alphaESS_power_data());
+                graph_slot = time_us_64() / GRAPH_SAMPLE_US;
+            }
+            update_display();
+        }
+        else if(!unix_offset || time_us_64() - time_synced >= TIME_SYNC_US){
+            uint32_t unix_time;
+            if(alphaESS_time(&unix_time)){
+                unix_offset = unix_time - (uint32_t)(time_us_64() / 1000000);
+                time_synced = time_us_64();
+            }
+        }
+        if(++polls % SPI_BUS_REPORT_POLLS == 0){
+            spi_bus_report();
+            spi_bus_reset_stats();
+            can_bus_report();
+        }
+        absolute_time_t next_poll = make_timeout_time_ms(CLOUD_POLL_MS);
+        while(!time_reached(next_poll)){
+            uint32_t unix_time = unix_offset ? unix_offset + (uint32_t)(time_us_64() / 1000000) : 0;
+            if(can_source_poll(unix_time)){
+                // The minimum on/off times and time windows of the rules need the wall clock
+                if(unix_time) control_sample(can_source_power_data());
+                uint64_t slot = time_us_64() / GRAPH_SAMPLE_US;
+                if(slot != graph_slot){
+                    display_set_power_data(can_source_power_data());
+                    graph_slot = slot;
+                }
+                else display_set_values(can_source_power_data());
+                update_display();
+            }
+#if TRACE_ENABLED
+            // Send 't' over stdio to dump the trace, see scripts/trace2json.py
+            if(getchar_timeout_us(LOCAL_POLL_MS * 1000) == 't') trace_dump();
+#else
+            sleep_ms(LOCAL_POLL_MS);
+#endif
+        }
     }
-}
\ No newline at end of file
+}
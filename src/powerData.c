@@ -0,0 +1,67 @@
+/**
+ * powerData.c
+ * Jannis Lämmle
+ * Minimal extraction of the getLastPowerData fields, avoids pulling in a json library
+ */
+
+#include <string.h>
+
+#include "powerData.h"
+
+// Find "key": in buf and parse the following number in tenths (e.g. 55.27 -> 553)
+static bool json_get_tenths(const uint8_t * buf, uint16_t len, const char * key, int32_t * out)
+{
+    uint16_t key_len = strlen(key);
+
+    for(uint16_t i = 0; i + key_len + 3 <= len; i++)
+    {
+        if(buf[i] != '"' || buf[i + key_len + 1] != '"' || memcmp(&buf[i + 1], key, key_len) != 0) continue;
+
+        uint16_t p = i + key_len + 2;
+        while(p < len && (buf[p] == ' ' || buf[p] == ':')) p++;
+
+        bool negative = false;
+        if(p < len && buf[p] == '-')
+        {
+            negative = true;
+            p++;
+        }
+        if(p >= len || buf[p] < '0' || buf[p] > '9') return false;
+
+        int32_t value = 0;
+        while(p < len && buf[p] >= '0' && buf[p] <= '9') value = value * 10 + (buf[p++] - '0');
+        value *= 10;
+
+        // First decimal plus rounding from the second one
+        if(p < len && buf[p] == '.')
+        {
+            p++;
+            if(p < len && buf[p] >= '0' && buf[p] <= '9') value += buf[p++] - '0';
+            if(p < len && buf[p] >= '5' && buf[p] <= '9') value++;
+        }
+
+        *out = negative ? -value : value;
+        return true;
+    }
+
+    return false;
+}
+
+bool power_data_parse(const uint8_t * buf, uint16_t len, power_data_t * out)
+{
+    int32_t ppv, pload, pgrid, pbat, soc;
+
+    if(!json_get_tenths(buf, len, "ppv", &ppv)) return false;
+    if(!json_get_tenths(buf, len, "pload", &pload)) return false;
+    if(!json_get_tenths(buf, len, "pgrid", &pgrid)) return false;
+    if(!json_get_tenths(buf, len, "pbat", &pbat)) return false;
+    if(!json_get_tenths(buf, len, "soc", &soc)) return false;
+
+    out->ppv = (ppv + (ppv < 0 ? -5 : 5)) / 10;
+    out->pload = (pload + (pload < 0 ? -5 : 5)) / 10;
+    out->pgrid = (pgrid + (pgrid < 0 ? -5 : 5)) / 10;
+    out->pbat = (pbat + (pbat < 0 ? -5 : 5)) / 10;
+    out->soc = soc < 0 ? 0 : (soc > 1000 ? 1000 : soc);
+
+    return true;
+}
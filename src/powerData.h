@@ -0,0 +1,26 @@
+/**
+ * powerData.h
+ * Jannis Lämmle
+ * Power/SoC sample shared by the data sources (cloud api) and its consumers (display)
+ */
+
+#ifndef POWERDATA_H_
+#define POWERDATA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// One reading of the system, powers in watts, soc in 0.1 %
+typedef struct power_data {
+    int32_t ppv;        // photovoltaic generation
+    int32_t pload;      // house consumption
+    int32_t pgrid;      // > 0 import from grid, < 0 feed-in
+    int32_t pbat;       // > 0 discharging, < 0 charging
+    uint16_t soc;       // battery state of charge
+    uint32_t timestamp; // unix time the sample was taken
+} power_data_t;
+
+// Fill 'out' from a getLastPowerData response (header and body), returns false if a field is missing
+bool power_data_parse(const uint8_t * buf, uint16_t len, power_data_t * out);
+
+#endif /* POWERDATA_H_ */